@@ -0,0 +1,63 @@
+#pragma once
+
+#if !defined(__Y__DYSTRUCT_ARENA_H__)
+#define      __Y__DYSTRUCT_ARENA_H__
+
+//======================================================================
+
+#include "DyStruct.h"
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+/// A bump allocator over big cache-line aligned chunks. Nothing is freed on
+/// its own; reset() and the destructor free everything at once. Used for the
+/// elements of VectorTypes, with one arena per container of instances. Not
+/// thread-safe.
+class Arena
+{
+public:
+	static size_t const DefaultChunkSize = 64 * 1024;
+
+public:
+	explicit Arena (size_t chunk_size = DefaultChunkSize);
+	~Arena ();
+
+	Arena (Arena && that);
+	Arena & operator = (Arena && that);
+
+	Arena (Arena const &) = delete;
+	Arena & operator = (Arena const &) = delete;
+
+	// align must be a power of two, no more than a cache line. nullptr if out of memory.
+	void * allocate (size_t size, size_t align);
+
+	// Forgets every allocation; keeps the first chunk around for reuse.
+	void reset ();
+
+	size_t bytesAllocated () const {return m_allocated;}	// Since the last reset
+	size_t bytesReserved () const {return m_reserved;}		// In chunks
+
+private:
+	void release ();
+
+private:
+	size_t m_chunk_size;
+	std::vector<Byte *> m_chunks;
+	std::vector<size_t> m_chunk_sizes;
+	Byte * m_bump;
+	Byte * m_bump_end;
+	size_t m_allocated;
+	size_t m_reserved;
+};
+
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================
+
+#endif	// __Y__DYSTRUCT_ARENA_H__
@@ -0,0 +1,194 @@
+#pragma once
+
+#if !defined(__Y__DYSTRUCT_COLUMN_TABLE_H__)
+#define      __Y__DYSTRUCT_COLUMN_TABLE_H__
+
+//======================================================================
+
+#include "DyStruct.h"
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+class ColumnTable;
+
+//----------------------------------------------------------------------
+
+/// The columnar counterpart of Accessor: it names a column of Basic values,
+/// and is applied to a table and a row. Not bound to any particular table,
+/// just to tables of the same CompiledType.
+template <Basic basic_type>
+class ColumnAccessor
+{
+	typedef typename details::BasicTypeMap<basic_type>::type MyT;
+	typedef typename details::BasicTypeMap<basic_type>::type const MyCT;
+
+public:
+	explicit ColumnAccessor (SizeType column)
+		: m_column {column}
+	{}
+
+public:
+	~ColumnAccessor () = default;
+
+	inline MyT & operator () (ColumnTable & table, size_t row) const;
+	inline MyCT & operator () (ColumnTable const & table, size_t row) const;
+
+	SizeType column () const {return m_column;}
+
+private:
+	SizeType m_column;
+};
+
+//----------------------------------------------------------------------
+
+/// Stores each field of a DyStruct in its own contiguous, cache-line aligned
+/// column (structure-of-arrays.) A pass that only looks at a couple of fields
+/// only drags those fields' columns through the cache.
+/// Growing the table moves the columns and invalidates raw column pointers.
+/// Rows move in and out of the table as plain bytes, so every field has to be
+/// trivially copyable: no Vectors, Sets or Maps, whose headers point into the
+/// instance's Arena.
+class ColumnTable
+{
+public:
+	static SizeType const InvalidColumn = ~SizeType(0);
+
+	/// A single row, readable field by field.
+	class RowView
+	{
+		friend class ColumnTable;
+
+	private:
+		RowView (ColumnTable * table, size_t row) : m_table (table), m_row (row) {}
+
+	public:
+		size_t index () const {return m_row;}
+		Byte * field (SizeType column) const {return m_table->columnData(column) + m_row * m_table->columnElemSize(column);}
+
+		template <Basic basic_type>
+		typename details::BasicTypeMap<basic_type>::type & get (ColumnAccessor<basic_type> accessor) const {return accessor(*m_table, m_row);}
+
+		void readInto (InstancePtr dst) const {m_table->readRow (m_row, dst);}
+		void writeFrom (InstancePtr src) const {m_table->writeRow (m_row, src);}
+
+	private:
+		ColumnTable * m_table;
+		size_t m_row;
+	};
+
+public:
+	explicit ColumnTable (CompiledType const * ctype);	// ctype must be a DyStruct; check isValid() to see if it worked
+	~ColumnTable ();
+
+	ColumnTable (ColumnTable && that);
+	ColumnTable & operator = (ColumnTable && that);
+
+	ColumnTable (ColumnTable const &) = delete;
+	ColumnTable & operator = (ColumnTable const &) = delete;
+
+	bool isValid () const {return m_valid;}	// False if a field isn't trivially copyable; the table stays empty
+	CompiledType const & type () const {return *m_ctype;}
+	CompiledType const * typePtr () const {return m_ctype;}
+	size_t size () const {return m_size;}
+	size_t capacity () const {return m_capacity;}
+	bool empty () const {return 0 == m_size;}
+
+	SizeType columnCount () const {return SizeType(m_columns.size());}
+	// Columns are in field order, and found through the CompiledType's FieldIndex;
+	// InvalidColumn if there's no such field.
+	SizeType columnIndex (std::string const & field_name) const {return columnIndex (field_name, FieldIndex::Hash(field_name));}
+	SizeType columnIndex (std::string const & field_name, FieldIndex::HashType hash) const;
+	DyStructType::Field const & columnField (SizeType column) const {return m_ctype->rawType()->asDyStruct()->getField(column);}
+	SizeType columnElemSize (SizeType column) const {return m_columns[column].elem_size;}
+	Byte * columnData (SizeType column) {return m_columns[column].data;}
+	Byte const * columnData (SizeType column) const {return m_columns[column].data;}
+
+	template <Basic basic_type>
+	ColumnAccessor<basic_type> accessorColumn (std::string const & field_name) const
+	{
+		auto column = columnIndex (field_name);
+
+		assert (InvalidColumn != column);
+		assert (columnField(column).type->isBasic());
+		assert (columnField(column).type->asBasic()->getType() == basic_type);
+
+		return ColumnAccessor<basic_type>{column};
+	}
+
+	// The whole column as a plain array of size() elements.
+	template <Basic basic_type>
+	typename details::BasicTypeMap<basic_type>::type * columnData (ColumnAccessor<basic_type> accessor)
+	{
+		return reinterpret_cast<typename details::BasicTypeMap<basic_type>::type *>(m_columns[accessor.column()].data);
+	}
+
+	template <Basic basic_type>
+	typename details::BasicTypeMap<basic_type>::type const * columnData (ColumnAccessor<basic_type> accessor) const
+	{
+		return reinterpret_cast<typename details::BasicTypeMap<basic_type>::type const *>(m_columns[accessor.column()].data);
+	}
+
+	// Converts a whole column of Basic values into size() values of dst_type at out (see
+	// Kernels::Convert.) Returns false if the column's type isn't a Basic.
+	bool convertColumn (SizeType column, Basic dst_type, void * out, bool saturate = false) const;
+
+	RowView row (size_t index) {assert (index < m_size); return RowView (this, index);}
+
+	bool reserve (size_t count);
+	bool resize (size_t count);				// New rows are constructed, removed ones are destructed
+	bool appendRow (InstancePtr src);		// Copies an instance of type() into a new row
+	void clear ();							// Keeps the memory around
+
+	// Gather a row into / scatter a row from an (already constructed) instance of type().
+	void readRow (size_t row, InstancePtr dst) const;
+	void writeRow (size_t row, InstancePtr src);
+
+private:
+	struct Column
+	{
+		Type const * type;
+		OffsetType offset;		// Of the field, within an instance
+		SizeType elem_size;
+		Byte * data;
+	};
+
+	bool reallocate (size_t new_capacity);
+	bool constructRows (size_t first, size_t last);
+	void destructRows (size_t first, size_t last);
+	void releaseColumns ();
+
+private:
+	CompiledType const * m_ctype;
+	std::vector<Column> m_columns;
+	size_t m_size;
+	size_t m_capacity;
+	bool m_valid;
+};
+
+//======================================================================
+
+template <Basic basic_type>
+inline typename ColumnAccessor<basic_type>::MyT & ColumnAccessor<basic_type>::operator () (ColumnTable & table, size_t row) const
+{
+	return table.columnData(*this)[row];
+}
+
+//----------------------------------------------------------------------
+
+template <Basic basic_type>
+inline typename ColumnAccessor<basic_type>::MyCT & ColumnAccessor<basic_type>::operator () (ColumnTable const & table, size_t row) const
+{
+	return table.columnData(*this)[row];
+}
+
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================
+
+#endif	// __Y__DYSTRUCT_COLUMN_TABLE_H__
@@ -5,10 +5,14 @@
 	
 //======================================================================
 
+#include <atomic>
 #include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <type_traits>
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
@@ -19,36 +23,55 @@ namespace DyStruct {
 
 //======================================================================
 
-// The current implementation is based on (actually, it /is/) Bob Jenkins' "one-at-a-time" hash.
+// A streaming, word-at-a-time hash in the spirit of wyhash: input is gathered
+// into 64-bit little-endian words, and each word is folded into the state
+// with a 64x64->128-bit multiply. Feeding the same bytes in any chunking
+// gives the same result.
 class Hasher
 {
 public:
 	inline Hasher ();
 	
 	inline void reset ();
-	inline void update (void const * data, unsigned len);
+	inline void update (void const * data, size_t len);
 	inline void updateString (void const * str);
-	inline void updateUnsigned (uint32_t val);	// Converts val to string and hashes it
+	inline void updateUnsigned (uint32_t val);	// Hashes the 4 bytes of val (little-endian)
+	inline void updateUnsigned64 (uint64_t val);	// Hashes the 8 bytes of val (little-endian)
 	inline uint32_t finalizeAndReset ();
+	inline uint64_t finalize64AndReset ();
 	inline void hashByte (unsigned char byte);
 
 private:
-	inline void setup (uint32_t init);
-	inline void finalMix ();
+	inline void setup (uint64_t init);
+	inline void updateWordBytes (uint64_t val, unsigned count);	// The low count (1 to 8) bytes of val; the rest must be zero
+	inline void mixWord (uint64_t word);
+	inline uint64_t finalMix () const;
 	
 private:
-	uint32_t m_hash;
+	uint64_t m_hash;
+	uint64_t m_buffer;		// Bytes that don't make up a whole word yet
+	unsigned m_buffered;
+	uint64_t m_length;
 };
 
 //======================================================================
 
-typedef uint32_t ID;
+// Type IDs are 32 bits by default; define DYSTRUCT_64BIT_ID to make them 64
+// bits, if you have enough types for collisions to become a concern.
+#if defined(DYSTRUCT_64BIT_ID)
+	typedef uint64_t ID;
+#else
+	typedef uint32_t ID;
+#endif
+
 typedef unsigned char Byte;
 
 typedef uint32_t SizeType;
 typedef uint32_t CountType;
 typedef SizeType OffsetType;	// 16 or 32?
 
+OffsetType const InvalidOffset = ~OffsetType(0);	// Held by accessors that didn't resolve
+
 typedef std::string Name;
 
 //----------------------------------------------------------------------
@@ -117,6 +140,7 @@ namespace details {
 		Basic const basic_type;
 		char const * const name;
 		uint32_t const size;
+		uint32_t const alignment;
 		bool const is_numeric;
 		bool const is_integer;
 		bool const is_signed;
@@ -146,6 +170,22 @@ namespace details {
 	template <> struct BasicTypeMap<Basic::Byte> {typedef uint8_t type;};
 	template <> struct BasicTypeMap<Basic::Char> {typedef char type;};
 	template <> struct BasicTypeMap<Basic::WChar>{typedef wchar_t type;};
+
+	// Rounds v up to a multiple of align (which must be a power of two.)
+	inline SizeType AlignUp (SizeType v, SizeType align) {return (v + align - 1) & ~(align - 1);}
+
+	SizeType const gc_CacheLineSize = 64;
+
+	// align must be a power of two. Memory from AlignedAlloc must be freed with AlignedFree.
+	void * AlignedAlloc (size_t size, size_t align);
+	void AlignedFree (void * mem);
+
+	struct PoolNode;
+
+	// Copy count elements of elem_size bytes each between a strided layout and a dense array.
+	// These live with the kernels, and use SIMD gathers when they can.
+	void GatherStrided (void const * src, size_t src_stride, size_t count, size_t elem_size, void * dst);
+	void ScatterStrided (void const * src, size_t count, size_t elem_size, void * dst, size_t dst_stride);
 }
 
 //----------------------------------------------------------------------
@@ -153,12 +193,66 @@ namespace details {
 //======================================================================
 
 class InstancePtr;
+class Type;
 class TypeManager;
 
 class BasicType;
 class EnumType;
 class ArrayType;
 class DyStructType;
+class StringType;
+class VectorType;
+class HashTableType;
+class SetType;
+class MapType;
+
+class StringPool;
+class StringAccessor;
+class Arena;
+template <Basic basic_type> class VectorAccessor;
+template <typename K> class SetAccessor;
+template <typename K, typename V> class MapAccessor;
+
+namespace details {
+	template <typename K> struct TableKey;	// See HashTable.h
+}
+
+//----------------------------------------------------------------------
+
+/// One run of leaf values in a compiled layout: count values of the same
+/// Basic type, size bytes each, stride bytes apart, starting at offset from
+/// the start of the instance. Enums show up as their unsigned underlying type,
+/// and interned strings as their U32 ids. Other strings have family String
+/// (and basic Byte); each value is a whole StringType slot. Vectors have
+/// family Vector, and type points at the VectorType; Sets and Maps likewise.
+struct LayoutLeaf
+{
+	OffsetType offset;
+	SizeType size;
+	CountType count;
+	SizeType stride;
+	Basic basic;
+	Family family;
+	Type const * type;
+
+	bool operator == (LayoutLeaf const & that) const
+	{
+		return offset == that.offset && size == that.size && count == that.count && stride == that.stride
+			&& basic == that.basic && family == that.family && type == that.type;
+	}
+	bool operator != (LayoutLeaf const & that) const {return !(*this == that);}
+};
+
+typedef std::vector<LayoutLeaf> LayoutContainer;
+
+namespace details {
+	// Flattens a type into leaves; what CompiledType::layout() is made of.
+	LayoutContainer FlattenLayout (Type const * type);
+
+	// True if values of this layout can be hashed and compared as size plain bytes:
+	// only non-float Basics, and no padding.
+	bool IsBytewise (LayoutContainer const & layout, SizeType size);
+}
 
 //----------------------------------------------------------------------
 
@@ -176,12 +270,16 @@ public:
 	virtual CountType getElemCount () const = 0;
 	virtual SizeType getElemSize () const = 0;
 	virtual SizeType getSizeOf () const = 0;
+	virtual SizeType getAlignment () const = 0;	// Natural alignment; always a power of two
 	virtual SizeType getFootprint () const = 0;
 	virtual bool isFixedFootprint () const = 0;
 	
 	virtual void updateHash (Hasher & hasher) const = 0;
 	virtual bool construct (void * mem, SizeType sz) const = 0;
 	virtual bool destruct (void * mem, SizeType sz) const = 0;
+	virtual bool isTriviallyConstructible () const = 0;	// construct() does nothing, so it can be skipped
+	virtual bool isTriviallyDestructible () const = 0;	// Same for destruct()
+	virtual bool isTriviallyCopyable () const = 0;		// A byte copy of an instance is a valid instance
 	
 	Family getFamily () const {return m_family;}
 	char const * getFamilyName () const {return familyTraits().name;}
@@ -202,19 +300,30 @@ public:
 	bool isAssociative () const {return familyTraits().associative;}
 	bool isFixedCount () const {return familyTraits().fixed_count;}
 
-	// Type conversion convenience functions; the use of dynamic_cast is irritating but probably sound.
-	template <typename T> T const * as () const {return dynamic_cast<T const *>(this);}
-	template <typename T> T * as () {return dynamic_cast<T *>(this);}
+	// Type conversion convenience functions; nullptr if this isn't a T. Every
+	// Type class has a StaticFamily, and each family has exactly one class.
+	template <typename T> T const * as () const {return T::StaticFamily == m_family ? static_cast<T const *>(this) : nullptr;}
+	template <typename T> T * as () {return T::StaticFamily == m_family ? static_cast<T *>(this) : nullptr;}
 	
 	BasicType const * asBasic () const {return as<BasicType>();}
 	EnumType const * asEnum () const {return as<EnumType>();}
 	ArrayType const * asArray () const {return as<ArrayType>();}
 	DyStructType const * asDyStruct () const {return as<DyStructType>();}
+	StringType const * asString () const {return as<StringType>();}
+	VectorType const * asVector () const {return as<VectorType>();}
+	SetType const * asSet () const {return as<SetType>();}
+	MapType const * asMap () const {return as<MapType>();}
+	inline HashTableType const * asHashTable () const;	// Sets and Maps
 
 	BasicType * asBasic () {return as<BasicType>();}
 	EnumType * asEnum () {return as<EnumType>();}
 	ArrayType * asArray () {return as<ArrayType>();}
 	DyStructType * asDyStruct () {return as<DyStructType>();}
+	StringType * asString () {return as<StringType>();}
+	VectorType * asVector () {return as<VectorType>();}
+	SetType * asSet () {return as<SetType>();}
+	MapType * asMap () {return as<MapType>();}
+	inline HashTableType * asHashTable ();
 
 protected:
 	details::FamilyTraits const & familyTraits () const {return details::gc_FamilyTraits[int(m_family)];}
@@ -237,6 +346,9 @@ class BasicType
 {
 	friend class TypeManager;
 
+public:
+	static constexpr Family StaticFamily = Family::Basic;
+
 protected:
 	BasicType (Basic basic_type)
 		: Type {Family::Basic}
@@ -251,12 +363,16 @@ public:
 	virtual CountType getElemCount () const override {return 1;}
 	virtual SizeType getElemSize () const override {return basicTraits().size;}
 	virtual SizeType getSizeOf () const override {return 1 * basicTraits().size;}
+	virtual SizeType getAlignment () const override {return basicTraits().alignment;}
 	virtual SizeType getFootprint () const override {return 1 * basicTraits().size;}
 	virtual bool isFixedFootprint () const override {return true;}
 
 	virtual inline void updateHash (Hasher & hasher) const override;
 	virtual bool construct (void * /*mem*/, SizeType /*sz*/) const override {return true;}
 	virtual bool destruct (void * /*mem*/, SizeType /*sz*/) const override {return true;}
+	virtual bool isTriviallyConstructible () const override {return true;}
+	virtual bool isTriviallyDestructible () const override {return true;}
+	virtual bool isTriviallyCopyable () const override {return true;}
 
 	Basic getType () const {return m_basic_type;}
 	char const * getTypeName () const {return basicTraits().name;}
@@ -281,6 +397,8 @@ class EnumType
 	friend class TypeManager;
 
 public:
+	static constexpr Family StaticFamily = Family::Enum;
+
 	typedef std::vector<std::pair<std::string, uint32_t>> NameValuePairContainer;
 	
 protected:
@@ -296,18 +414,23 @@ public:
 	virtual CountType getElemCount () const override {return 1;}
 	virtual SizeType getElemSize () const override {return underlyingTraits().size;}
 	virtual SizeType getSizeOf () const override {return 1 * underlyingTraits().size;}
+	virtual SizeType getAlignment () const override {return underlyingTraits().alignment;}
 	virtual SizeType getFootprint () const override {return 1 * underlyingTraits().size;}
 	virtual bool isFixedFootprint () const override {return true;}
 
 	virtual inline void updateHash (Hasher & hasher) const override;
 	virtual bool construct (void * /*mem*/, SizeType /*sz*/) const override {return true;}
 	virtual bool destruct (void * /*mem*/, SizeType /*sz*/) const override {return true;}
+	virtual bool isTriviallyConstructible () const override {return true;}
+	virtual bool isTriviallyDestructible () const override {return true;}
+	virtual bool isTriviallyCopyable () const override {return true;}
 
 	bool addEntry (std::string name, uint32_t value);	// Will fail if either already is in the Enum
 	bool addEntry (std::string name);					// Auto value, 1 more than previous max
     NameValuePairContainer const & getNameValues () const {return m_name_values;}
     size_t getEntriesCount () const {return m_name_values.size();}
 	int64_t getMaxValue () const {return m_max_value;}
+	Basic getUnderlyingType () const {return m_underlying_type;}	// Always unsigned
 	
 protected:
 	Basic underlyingType () const {return (m_max_value < 256) ? Basic::U8 : ((m_max_value < 65536) ? Basic::U16 : Basic::U32);}
@@ -326,6 +449,9 @@ class ArrayType
 	: public Type
 {
 	friend class TypeManager;
+
+public:
+	static constexpr Family StaticFamily = Family::Array;
 	
 protected:
 	// Type must already exist in TypeManager
@@ -341,14 +467,18 @@ protected:
 
 public:
 	virtual CountType getElemCount () const override {return m_count;}
-	virtual SizeType getElemSize () const override {return m_element_type->getElemSize();}
-	virtual SizeType getSizeOf () const override {return m_count * m_element_type->getElemSize();}
-	virtual SizeType getFootprint () const override {return m_count * m_element_type->getElemSize();}
+	virtual SizeType getElemSize () const override {return m_element_type->getSizeOf();}
+	virtual SizeType getSizeOf () const override {return m_count * m_element_type->getSizeOf();}
+	virtual SizeType getAlignment () const override {return m_element_type->getAlignment();}
+	virtual SizeType getFootprint () const override {return m_count * m_element_type->getFootprint();}
 	virtual bool isFixedFootprint () const override {return m_element_type->isFixedFootprint();}
 
 	virtual inline void updateHash (Hasher & hasher) const override;
-	virtual bool construct (void * /*mem*/, SizeType /*sz*/) const override {return true;}
-	virtual bool destruct (void * /*mem*/, SizeType /*sz*/) const override {return true;}
+	virtual inline bool construct (void * mem, SizeType sz) const override;
+	virtual inline bool destruct (void * mem, SizeType sz) const override;
+	virtual bool isTriviallyConstructible () const override {return m_element_type->isTriviallyConstructible();}
+	virtual bool isTriviallyDestructible () const override {return m_element_type->isTriviallyDestructible();}
+	virtual bool isTriviallyCopyable () const override {return m_element_type->isTriviallyCopyable();}
 	
 	Type const * getElemType () const {return m_element_type;}
 
@@ -363,8 +493,10 @@ class DyStructType
 	: public Type
 {
 	friend class TypeManager;
-	
+
 public:
+	static constexpr Family StaticFamily = Family::DyStruct;
+	
 	struct Field
 	{
 		SizeType offset;
@@ -380,7 +512,7 @@ public:
 	typedef std::vector<Field> FieldContainer;
 
 protected:
-	DyStructType () : Type {Family::DyStruct}, m_cur_size {0}, m_fields {} {}
+	DyStructType () : Type {Family::DyStruct}, m_cur_size {0}, m_cur_end {0}, m_cur_align {1}, m_fields {}, m_field_map {} {}
 	
 	virtual Type * clone () const {return new DyStructType {*this};}
 
@@ -388,12 +520,16 @@ public:
 	virtual CountType getElemCount () const override {return 1;}
 	virtual SizeType getElemSize () const override {return m_cur_size;}
 	virtual SizeType getSizeOf () const override {return 1 * m_cur_size;}
+	virtual SizeType getAlignment () const override {return m_cur_align;}
 	virtual SizeType getFootprint () const override {return calculateFootprint();}
 	virtual bool isFixedFootprint () const override {return allElementsFixedFootprint();}
 
 	virtual inline void updateHash (Hasher & hasher) const override;
 	virtual inline bool construct (void * mem, SizeType sz) const override;
 	virtual inline bool destruct (void * mem, SizeType sz) const override;
+	virtual inline bool isTriviallyConstructible () const override;
+	virtual inline bool isTriviallyDestructible () const override;
+	virtual inline bool isTriviallyCopyable () const override;
 	
 	bool addField (Field field);
 	bool hasField (std::string const & name) const;
@@ -401,13 +537,383 @@ public:
 	Field const & getField (size_t index) const {return m_fields[index];}
 	Field const * findField (std::string const & name) const;
 
+	// Stable-sorts the fields by decreasing alignment and lays them out again,
+	// which leaves no padding between fields. Returns the number of bytes saved.
+	// Only this level is reordered; nested DyStructs are left alone. Don't do
+	// this to a type that's already been compiled or used as a field somewhere.
+	SizeType reorderFields ();
+
 protected:
 	SizeType calculateFootprint () const;
 	bool allElementsFixedFootprint () const;
+	void layoutField (Field & field);
+	void rebuildFieldMap ();
 
 private:
-	SizeType m_cur_size;
+	SizeType m_cur_size;	// Includes the tail padding
+	SizeType m_cur_end;		// End of the last field
+	SizeType m_cur_align;
 	FieldContainer m_fields;
+	std::unordered_map<std::string, SizeType> m_field_map;	// Name to index into m_fields
+};
+
+//======================================================================
+
+/// Chars and a length, not owned and not zero-terminated.
+struct StringRef
+{
+	char const * data;
+	size_t size;
+
+	StringRef () : data {""}, size {0} {}
+	StringRef (char const * str, size_t length) : data {str}, size {length} {}
+	StringRef (char const * str) : data {str}, size {std::strlen (str)} {}
+	StringRef (std::string const & str) : data {str.data()}, size {str.size()} {}
+
+	std::string str () const {return std::string {data, size};}
+	bool operator == (StringRef const & that) const {return size == that.size && 0 == std::memcmp (data, that.data, size);}
+	bool operator != (StringRef const & that) const {return !(*this == that);}
+};
+
+//----------------------------------------------------------------------
+
+/// A string stored in a fixed-size slot inside the instance. Strings of up
+/// to getInlineCapacity() chars live right in the slot; longer ones are
+/// copied into the StringPool of the TypeManager, and the slot points there.
+/// The last byte of the slot says which: the inline length, or LongTag.
+/// Pooled chars are only freed with the pool, so a slot can be copied with
+/// memcpy, and destroying one does nothing; but re-assigning long strings
+/// over and over grows the pool.
+///
+/// An interned StringType instead keeps a 4-byte id from the pool, which
+/// gives every distinct string one id; comparing and hashing those is O(1).
+/// Ids only mean something within one TypeManager.
+///
+/// All-zero bytes are the empty string, in both modes.
+class StringType
+	: public Type
+{
+	friend class TypeManager;
+
+public:
+	static constexpr Family StaticFamily = Family::String;
+	static SizeType const DefaultInlineCapacity = 15;	// Makes a 16-byte slot
+	static SizeType const MaxInlineCapacity = 254;
+	static Byte const LongTag = 0xFF;
+
+protected:
+	// The pool must outlive the type.
+	StringType (StringPool & pool, SizeType inline_capacity = DefaultInlineCapacity, bool interned = false);
+
+	virtual Type * clone () const override {return new StringType {*this};}
+
+public:
+	virtual CountType getElemCount () const override {return 1;}
+	virtual SizeType getElemSize () const override {return m_slot_size;}
+	virtual SizeType getSizeOf () const override {return 1 * m_slot_size;}
+	virtual SizeType getAlignment () const override {return m_interned ? SizeType(alignof(uint32_t)) : SizeType(alignof(char const *));}
+	virtual SizeType getFootprint () const override {return 1 * m_slot_size;}
+	virtual bool isFixedFootprint () const override {return false;}	// The chars might be elsewhere
+
+	virtual inline void updateHash (Hasher & hasher) const override;
+	virtual bool construct (void * mem, SizeType sz) const override {assert (sz == m_slot_size); std::memset (mem, 0, sz); return true;}
+	virtual bool destruct (void * /*mem*/, SizeType /*sz*/) const override {return true;}
+	virtual bool isTriviallyConstructible () const override {return false;}
+	virtual bool isTriviallyDestructible () const override {return true;}
+	virtual bool isTriviallyCopyable () const override {return true;}
+
+	SizeType getInlineCapacity () const {return m_inline_capacity;}
+	bool isInterned () const {return m_interned;}
+	StringPool & getPool () const {return *m_pool;}
+
+	// Read and write the string in a slot (i.e. at this type's offset in an instance.)
+	StringRef read (Byte const * slot) const;
+	bool write (Byte * slot, char const * str, size_t length) const;
+
+	// Reads a non-interned slot of slot_size bytes; all the layout needs is the size.
+	static inline StringRef ReadSlot (Byte const * slot, SizeType slot_size);
+
+private:
+	StringPool * m_pool;
+	SizeType m_inline_capacity;
+	SizeType m_slot_size;
+	bool m_interned;
+};
+
+//======================================================================
+
+/// A variable-length list of elements of one type. The instance only holds
+/// a small header; the elements are packed together in an Arena that the
+/// caller provides when the vector grows, typically the one that belongs to
+/// the InstanceArray the instance lives in. Arenas free all their memory at
+/// once, so a vector never frees anything; growing one moves it to a bigger
+/// block and leaves the old one to the arena.
+///
+/// Elements must be trivially copyable and destructible (Basics, Enums,
+/// Strings, and Arrays and DyStructs of those.) Vectors themselves are not
+/// trivially copyable: a byte copy would share the elements. All-zero bytes
+/// are an empty vector.
+class VectorType
+	: public Type
+{
+	friend class TypeManager;
+
+public:
+	static constexpr Family StaticFamily = Family::Vector;
+
+	struct Header
+	{
+		Byte * data;
+		uint32_t size;
+		uint32_t capacity;
+	};
+
+protected:
+	// Type must already exist in TypeManager. It may still be getting its
+	// fields; compile() checks that it's trivially copyable and destructible.
+	VectorType (Type * element_type);
+
+	virtual Type * clone () const override {return new VectorType {*this};}
+
+public:
+	virtual CountType getElemCount () const override {return 0;}	// Not fixed
+	virtual SizeType getElemSize () const override {return m_element_type->getSizeOf();}
+	virtual SizeType getSizeOf () const override {return 1 * SizeType(sizeof(Header));}
+	virtual SizeType getAlignment () const override {return SizeType(alignof(Header));}
+	virtual SizeType getFootprint () const override {return 1 * SizeType(sizeof(Header));}
+	virtual bool isFixedFootprint () const override {return false;}
+
+	virtual inline void updateHash (Hasher & hasher) const override;
+	virtual bool construct (void * mem, SizeType sz) const override {assert (sz == sizeof(Header)); std::memset (mem, 0, sz); return true;}
+	virtual bool destruct (void * /*mem*/, SizeType /*sz*/) const override {return true;}
+	virtual bool isTriviallyConstructible () const override {return false;}
+	virtual bool isTriviallyDestructible () const override {return true;}
+	virtual bool isTriviallyCopyable () const override {return false;}
+
+	Type const * getElemType () const {return m_element_type;}
+	LayoutContainer const & getElemLayout () const {return m_elem_layout;}
+	bool isElemBytewise () const {return m_elem_bytewise;}	// Elements hash and compare as plain bytes
+
+	// The header in a slot (i.e. at this type's offset in an instance.)
+	static Header * HeaderOf (Byte * slot) {return reinterpret_cast<Header *>(slot);}
+	static Header const * HeaderOf (Byte const * slot) {return reinterpret_cast<Header const *>(slot);}
+
+	// Both fail (and leave the vector alone) if the arena is out of memory.
+	// New elements are zeroed and constructed.
+	bool reserve (Byte * slot, size_t capacity, Arena & arena) const;
+	bool resize (Byte * slot, size_t count, Arena & arena) const;
+
+private:
+	// Lays out the element type as it is now; false if it can't be an element.
+	bool refreshLayout ();
+
+private:
+	Type * m_element_type;
+	LayoutContainer m_elem_layout;
+	bool m_elem_bytewise;
+};
+
+//======================================================================
+
+/// What SetType and MapType have in common: a flat, open-addressing hash
+/// table in the style of Swiss tables. As with VectorType, the instance only
+/// holds a small header, and the table is one block in an Arena: a control
+/// byte per entry (empty, deleted, or 7 bits of the key's hash), followed by
+/// the entries, each a key and then (for maps) a value. Lookups check the
+/// control bytes of GroupWidth entries at once, and only compare the keys
+/// whose 7 bits match, so there is no per-entry allocation and a probe
+/// rarely touches more than a cache line or two. Entries stay put until the
+/// table grows; growing leaves the old block to the arena.
+///
+/// Keys are Basics, Enums or Strings. Values must be trivially copyable and
+/// destructible, like Vector elements. Float keys compare the way hashing
+/// does: -0 equals 0, and all NaNs are equal. All-zero bytes are an empty
+/// table.
+///
+/// The key arguments below point to the key's value, as a Basic or Enum
+/// stores it, or to a StringRef for String keys. Entry pointers are good
+/// until the next insert.
+class HashTableType
+	: public Type
+{
+	friend class TypeManager;
+
+public:
+	struct Header
+	{
+		Byte * ctrl;			// capacity control bytes, then the entries
+		uint32_t size;
+		uint32_t capacity;		// 0, or a power of two no less than GroupWidth
+		uint32_t growth_left;	// Empty entries left before the table has to grow
+	};
+
+	static uint32_t const GroupWidth = 16;
+	static Byte const CtrlEmpty = 0x80;
+	static Byte const CtrlDeleted = 0xFE;	// Full entries are 0 to 0x7F
+
+protected:
+	// Both types must already exist in TypeManager. The value type may still
+	// be getting its fields; compile() checks it, like a Vector's elements.
+	HashTableType (Family family, Type * key_type, Type * value_type);
+
+public:
+	virtual CountType getElemCount () const override {return 0;}	// Not fixed
+	virtual SizeType getElemSize () const override {return m_entry_size;}
+	virtual SizeType getSizeOf () const override {return 1 * SizeType(sizeof(Header));}
+	virtual SizeType getAlignment () const override {return SizeType(alignof(Header));}
+	virtual SizeType getFootprint () const override {return 1 * SizeType(sizeof(Header));}
+	virtual bool isFixedFootprint () const override {return false;}
+
+	virtual bool construct (void * mem, SizeType sz) const override {assert (sz == sizeof(Header)); std::memset (mem, 0, sz); return true;}
+	virtual bool destruct (void * /*mem*/, SizeType /*sz*/) const override {return true;}
+	virtual bool isTriviallyConstructible () const override {return false;}
+	virtual bool isTriviallyDestructible () const override {return true;}
+	virtual bool isTriviallyCopyable () const override {return false;}
+
+	Type const * getKeyType () const {return m_key_type;}
+	Type const * getValueType () const {return m_value_type;}	// nullptr for sets
+	SizeType getEntrySize () const {return m_entry_size;}
+	SizeType getValueOffset () const {return m_value_offset;}	// Within an entry
+	LayoutContainer const & getValueLayout () const {return m_value_layout;}
+	bool isValueBytewise () const {return m_value_bytewise;}
+
+	// The header in a slot (i.e. at this type's offset in an instance.)
+	static Header * HeaderOf (Byte * slot) {return reinterpret_cast<Header *>(slot);}
+	static Header const * HeaderOf (Byte const * slot) {return reinterpret_cast<Header const *>(slot);}
+
+	// The entry with this key, or nullptr.
+	Byte * find (Byte * slot, void const * key) const {return const_cast<Byte *>(find (const_cast<Byte const *>(slot), key));}
+	Byte const * find (Byte const * slot, void const * key) const;
+
+	// The entry with this key, adding it (with a zeroed and constructed value)
+	// if there isn't one. nullptr if the arena (or the string pool) is out of
+	// memory, in which case nothing is added.
+	Byte * insert (Byte * slot, void const * key, Arena & arena, bool * inserted = nullptr) const;
+
+	// False if there was no such key.
+	bool erase (Byte * slot, void const * key) const;
+
+	// Makes room for count entries in all; false if out of memory.
+	bool reserve (Byte * slot, size_t count, Arena & arena) const;
+
+	// Removes everything, but keeps the block.
+	void clear (Byte * slot) const;
+
+	// Calls f (entry) for every entry, in no particular order.
+	template <typename F> void forEach (Byte * slot, F && f) const;
+	template <typename F> void forEach (Byte const * slot, F && f) const;
+
+	StringRef readStringKey (Byte const * entry) const;	// Only for String keys
+	uint64_t hashEntry (Byte const * entry) const;		// The hash of an entry's key
+
+private:
+	enum class KeyKind : uint8_t {Bits, F32, F64, String, InternedString};
+
+	inline uint64_t keyBits (void const * key) const;
+	inline uint64_t hashKey (void const * key) const;
+	inline bool keyEquals (Byte const * entry, void const * key) const;
+	Byte const * findIn (Header const * h, void const * key, uint64_t hash) const;
+	bool rehash (Header * h, uint32_t capacity, Arena & arena) const;
+	Byte * claim (Header * h, uint64_t hash) const;	// Marks a free entry full; the table must have room
+
+	// Lays out the entries for the key and value types as they are now; false
+	// if the value type can't be a value.
+	bool refreshLayout ();
+
+	static Byte * EntriesOf (Byte * ctrl, uint32_t capacity, SizeType entry_align) {return ctrl + details::AlignUp (capacity, entry_align);}
+
+private:
+	Type * m_key_type;
+	Type * m_value_type;
+	SizeType m_key_size;
+	SizeType m_value_offset;
+	SizeType m_entry_size;
+	SizeType m_entry_align;
+	KeyKind m_key_kind;
+	LayoutContainer m_value_layout;
+	bool m_value_bytewise;
+};
+
+//----------------------------------------------------------------------
+
+/// A set of keys; see HashTableType.
+class SetType
+	: public HashTableType
+{
+	friend class TypeManager;
+
+public:
+	static constexpr Family StaticFamily = Family::Set;
+
+protected:
+	SetType (Type * key_type) : HashTableType {Family::Set, key_type, nullptr} {}
+
+	virtual Type * clone () const override {return new SetType {*this};}
+
+public:
+	virtual inline void updateHash (Hasher & hasher) const override;
+};
+
+//----------------------------------------------------------------------
+
+/// Keys and their values; see HashTableType.
+class MapType
+	: public HashTableType
+{
+	friend class TypeManager;
+
+public:
+	static constexpr Family StaticFamily = Family::Map;
+
+protected:
+	MapType (Type * key_type, Type * value_type) : HashTableType {Family::Map, key_type, value_type} {}
+
+	virtual Type * clone () const override {return new MapType {*this};}
+
+public:
+	virtual inline void updateHash (Hasher & hasher) const override;
+};
+
+//======================================================================
+
+/// A minimal perfect hash over the field names of a DyStructType (hash and
+/// displace: the name's hash picks a bucket, and the bucket's seed scatters
+/// its names into distinct slots.) CompiledType builds one at compile time.
+/// Lookups cost one hash (which you can precompute with Hash()) and one
+/// string compare, no matter how many fields there are.
+class FieldIndex
+{
+	friend class TypeManager;
+
+public:
+	typedef uint32_t HashType;
+
+	static HashType Hash (char const * name, size_t len);
+	static HashType Hash (std::string const & name) {return Hash (name.data(), name.size());}
+
+public:
+	FieldIndex () : m_type {nullptr}, m_seeds {}, m_slots {}, m_fallback {false} {}
+	explicit FieldIndex (DyStructType const * type);
+
+	// nullptr if there's no such field
+	DyStructType::Field const * find (std::string const & name) const {return find (name, Hash(name));}
+	DyStructType::Field const * find (std::string const & name, HashType hash) const;
+
+	bool isPerfect () const {return !m_fallback;}	// False only if two names' hashes collide
+
+private:
+	// For reloading a saved registry; no hashing or searching for seeds
+	FieldIndex (DyStructType const * type, std::vector<uint32_t> seeds, std::vector<SizeType> slots, bool fallback)
+		: m_type {type}, m_seeds (std::move(seeds)), m_slots (std::move(slots)), m_fallback {fallback}
+	{}
+
+	bool build (std::vector<HashType> const & hashes, uint32_t bucket_count);
+
+private:
+	DyStructType const * m_type;
+	std::vector<uint32_t> m_seeds;		// Per bucket
+	std::vector<SizeType> m_slots;		// Per slot; index into the DyStructType's fields
+	bool m_fallback;					// Couldn't build the hash; go through DyStructType::findField
 };
 
 //======================================================================
@@ -421,52 +927,183 @@ namespace details {
 	template <> struct family_type_map<Family::Array> {typedef ArrayType type;};
 	//template <> struct family_type_map<Family::Struct> {typedef StructType type;};
 	template <> struct family_type_map<Family::DyStruct> {typedef DyStructType type;};
-	//template <> struct family_type_map<Family::String> {typedef StringType type;};
-	//template <> struct family_type_map<Family::Vector> {typedef VectorType type;};
-	//template <> struct family_type_map<Family::Set> {typedef SetType type;};
-	//template <> struct family_type_map<Family::Map> {typedef MapType type;};
+	template <> struct family_type_map<Family::String> {typedef StringType type;};
+	template <> struct family_type_map<Family::Vector> {typedef VectorType type;};
+	template <> struct family_type_map<Family::Set> {typedef SetType type;};
+	template <> struct family_type_map<Family::Map> {typedef MapType type;};
 }
 
 //======================================================================
 
 class CompiledType;
+class MorphPlan;
+
+//----------------------------------------------------------------------
+
+struct CompileOptions
+{
+	bool reorder_fields = false;	// Compile a copy of the DyStructType, with DyStructType::reorderFields() called on it; the Type itself is left alone
+	bool pool_cache_line_slots = false;	// Give each pooled instance its own cache line(s), to avoid false sharing
+	bool pool_thread_cache = false;		// Put a small per-thread cache of free instances in front of the pool
+	bool share_interned = false;		// Share the CompiledType of an interned type; see TypeManager::compile()
+};
 
 //----------------------------------------------------------------------
 
+namespace details {
+	struct ReaderShard;
+}
+
+//----------------------------------------------------------------------
+
+/// Owns Types and CompiledTypes, and finds CompiledTypes by name.
+///
+/// Safe to use from many threads. getCompiledType() and getType() don't
+/// lock: they look the name up in an immutable snapshot of the name table,
+/// announcing themselves on a per-thread counter so that a writer knows when
+/// nobody can still be looking at an old snapshot. Everything that changes
+/// the manager takes one writer lock, publishes a new snapshot, and waits
+/// that grace period out before freeing the old snapshot, so a lookup never
+/// sees freed memory. The grace period ends with the lookup, though, and the
+/// CompiledType it returns may be used for much longer, so a destroyed
+/// CompiledType only loses its names; it's freed by clear() or when the
+/// manager goes, and until then a pointer to it stays good. Writes copy the name
+/// table, so they cost O(types); this is meant for the usual case of types
+/// being set up once and looked up all the time. Types themselves are not
+/// locked: don't change a Type while other threads are using it.
 class TypeManager
 {
 public:
 	TypeManager ();
 	~TypeManager ();
 
+	TypeManager (TypeManager const &) = delete;
+	TypeManager & operator = (TypeManager const &) = delete;
+
 	void clear ();
 
 	template <Family Family, typename... Args>
 	auto createType (Args&&... args) -> typename details::family_type_map<Family>::type *
 	{
 		auto ret = new typename details::family_type_map<Family>::type {std::forward<Args>(args)...};
+		std::lock_guard<std::mutex> guard {m_lock};
 		m_raw_types.insert (ret);
 		return ret;
 	}
 	
+	// Same as createType(), but interned; see intern(). Best for the families
+	// that the constructor fully describes (Basic, Array, String, Vector, Set
+	// and Map); intern DyStructs and Enums once their fields are in.
+	template <Family Family, typename... Args>
+	auto createInterned (Args&&... args) -> typename details::family_type_map<Family>::type *
+	{
+		auto fresh = createType<Family> (std::forward<Args>(args)...);
+		auto ret = intern (fresh);
+		if (ret != fresh)
+			destroyType (fresh);	// Nobody has seen it yet
+		return static_cast<typename details::family_type_map<Family>::type *>(ret);
+	}
+
 	// Make sure you've destroyed all CompiledType and Type instances that depend on this first
 	bool destroyType (Type * type);
 	bool hasType (Type * type) const;
 
-	CompiledType * compile (Type * type, Name const & name);
+	// Structural interning (hash-consing.) Returns the interned Type that has
+	// the same structure as type (see SameStructure()); if there isn't one yet,
+	// type becomes it. A duplicate type is left as it is, still owned by the
+	// manager, so whatever already points at it keeps working; destroy it
+	// once nothing does. Don't change a type after interning it. Interning
+	// leaves first (with createInterned()) makes every level of an interned
+	// type shared, and equal interned types have equal pointers.
+	Type * intern (Type * type);
+	bool isInterned (Type const * type) const;
+
+	// Same family and parameters, same field names at the same offsets, and
+	// element, key, value and field types that are the same all the way down.
+	// Interned strings must also share a pool. Types can be from any manager.
+	static bool SameStructure (Type const * a, Type const * b);
+
+	// With options.share_interned, if type is interned and has already been
+	// compiled with share_interned and the same pool options, name becomes
+	// another name of that CompiledType, which is returned. compile() doesn't
+	// intern anything itself; pass it what intern() returned. Destroying a
+	// CompiledType drops all of its names. With options.reorder_fields, the
+	// CompiledType's rawType() is a reordered copy of type, which is left as
+	// it was. nullptr if the name is taken, or if a Vector's elements or a
+	// Map's values aren't trivially copyable and destructible.
+	CompiledType * compile (Type * type, Name const & name, CompileOptions const & options = CompileOptions{});
+
+	// Describes and compiles an existing C++ struct S, bound with the macros in
+	// StaticStruct.h. nullptr if the name is taken, or if the bound fields don't
+	// lay out exactly like S does.
+	template <typename S>
+	CompiledType * compileStatic (Name const & name, CompileOptions options = CompileOptions{});
+	// Drops the names of cmptype, which then can't be found any more. It stays
+	// alive (as do its instances' pool) until clear() or the manager's end, in
+	// case another thread just looked it up.
 	bool destroyCompiledType (CompiledType * cmptype);
 	bool hasCompiledType (CompiledType * cmptype) const;
 	
 	CompiledType * getCompiledType (Name const & name) const;
 	Type const * getType (Name const & name) const;
 
+	// Dumps every Type and CompiledType (layouts, names, IDs and field indices) into a
+	// binary blob, which loadRegistry() turns back into the same types, without laying
+	// anything out or searching for field index seeds again. Fails if any type is of a
+	// family that can't be saved. The blob is only good for the same kind of machine.
+	bool saveRegistry (std::vector<Byte> & out) const;
+	bool saveRegistry (std::string const & path) const;
+
+	// Adds the types of a saved registry to this TypeManager; all or nothing. Fails if
+	// any of the names is already compiled here. With verify_ids, every CompiledType is
+	// hashed again and must have the stored id(). Extra names of shared CompiledTypes
+	// (see compile()) come back too, but the loaded types are not interned. Enum
+	// sizes and the bytewise flags must match what the types work out to, and a
+	// field index that doesn't find every field is built again.
+	bool loadRegistry (Byte const * data, size_t size, bool verify_ids = true);
+	bool loadRegistry (std::string const & path, bool verify_ids = true);
+
+	// A plan for morphing instances of src into instances of dst; see Morph.h.
+	// With saturate, narrowing integer conversions clamp instead of wrapping around.
+	MorphPlan buildMorph (CompiledType const & src, CompiledType const & dst, bool saturate = false) const;
+
+	// Where long and interned strings of this manager's StringTypes go.
+	StringPool & stringPool () const {return *m_string_pool;}
+
+	StringType * createString (SizeType inline_capacity = StringType::DefaultInlineCapacity, bool interned = false)
+	{
+		return createType<Family::String> (*m_string_pool, inline_capacity, interned);
+	}
+
 private:
+	typedef std::unordered_map<Name, CompiledType *> NameContainer;
+	class ReadSection;
+
+	// With m_lock held; publishes m_names and waits for readers of the old
+	// snapshot to leave. Then the old snapshot and doomed are deleted.
+	void publishNames (std::vector<CompiledType *> const & doomed = {});
+
+	// With m_lock held
+	std::unordered_multimap<uint64_t, Type *>::const_iterator findInterned (Type const * type) const;
+
+	// Lays out the Vectors, Sets and Maps in type again, since their element
+	// types may have changed since they were created. False if one of them
+	// has elements (or values) that aren't trivially copyable and destructible.
+	static bool PrepareContainers (Type * type);
 
 private:
+	mutable std::mutex m_lock;		// For writers; readers go through m_snapshot
 	std::unordered_set<Type *> m_raw_types;
 	std::unordered_set<CompiledType *> m_compiled_types;
+	std::vector<CompiledType *> m_retired;		// Destroyed, but maybe still in use; see destroyCompiledType()
+	std::unordered_multimap<uint64_t, Type *> m_interned;				// By structural hash
+	std::unordered_map<Type const *, CompiledType *> m_interned_compiled;	// Compiled with share_interned
 	
-	std::unordered_map<Name, CompiledType *> m_names;
+	NameContainer m_names;		// A CompiledType can have several names
+	std::atomic<NameContainer const *> m_snapshot;		// A copy of m_names, for readers
+	std::atomic<unsigned> m_epoch;						// Which of its two counters a reader bumps
+	details::ReaderShard * m_readers;
+	std::unique_ptr<StringPool> m_string_pool;
 };
 
 //======================================================================
@@ -474,6 +1111,8 @@ private:
 class InstancePtr
 {
 	friend class CompiledType;
+	friend class InstanceArray;
+	friend class InstanceFile;
 	
 private:
 	explicit InstancePtr (CompiledType const * ctype_ptr)
@@ -555,6 +1194,8 @@ public:
 	MyT & operator () (InstancePtr inst) {return *reinterpret_cast<MyT *>(inst.data() + m_offset);}
 	MyCT & operator () (InstancePtr inst) const {return *reinterpret_cast<MyCT *>(inst.data() + m_offset);}
 
+	bool isValid () const {return InvalidOffset != m_offset;}	// False if it came from a path that didn't resolve
+
 private:
 	OffsetType m_offset;	/// This is always a byte offset.
 };
@@ -628,6 +1269,9 @@ private:
 //----------------------------------------------------------------------
 
 /// When the final field you want to access is an array of Basic fields with a *stride*.
+/// The typical use is one field of a run of packed instances (e.g. an InstanceArray,)
+/// where the offset is the field's offset and the stride is the instance size; the
+/// InstancePtr you pass in is then the first instance of the run.
 template <Basic basic_type>
 class AccessorStriden
 {
@@ -645,12 +1289,28 @@ public:
 public:
 	~AccessorStriden () = default;
 
-	// TODO: Actually implement this whenever you wrote ctors for Accessor
-	//Accessor<BasicType> operator [] (size_t index) {return {m_offset + index * m_stride};}
+	// The index-th element, relative to whatever instance you apply it to.
+	Accessor<basic_type> operator [] (size_t index) const {return Accessor<basic_type>{OffsetType(m_offset + index * m_stride)};}
 
-	// Probably should not implement any of these:
-	//MyT & operator () (InstancePtr inst, size_t index) {return reinterpret_cast<MyT *>(inst.data() + m_offset + index * m_stride);}
-	//MyCT & operator () (InstancePtr inst, size_t index) const {return reinterpret_cast<MyCT *>(inst.data() + m_offset + index * m_stride);}
+	MyT & operator () (InstancePtr inst, size_t index) {return *reinterpret_cast<MyT *>(inst.data() + m_offset + index * m_stride);}
+	MyCT & operator () (InstancePtr inst, size_t index) const {return *reinterpret_cast<MyCT *>(inst.data() + m_offset + index * m_stride);}
+
+	// fn (MyT & value, size_t index) is called for elements [0, count) of inst.
+	template <typename F>
+	void forEach (InstancePtr inst, size_t count, F fn) const
+	{
+		Byte * p = inst.data() + m_offset;
+		for (size_t i = 0; i < count; ++i, p += m_stride)
+			fn (*reinterpret_cast<MyT *>(p), i);
+	}
+
+	// Gather elements [0, count) into a dense array, or scatter them back from one.
+	void copyOut (InstancePtr inst, size_t count, MyT * out) const {details::GatherStrided (inst.data() + m_offset, m_stride, count, sizeof(MyT), out);}
+	void copyIn (InstancePtr inst, size_t count, MyCT * in) const {details::ScatterStrided (in, count, sizeof(MyT), inst.data() + m_offset, m_stride);}
+
+	OffsetType offset () const {return m_offset;}
+	OffsetType stride () const {return m_stride;}
+	bool isValid () const {return InvalidOffset != m_offset;}	// False if it came from a path that didn't resolve
 
 private:
 	OffsetType m_offset;
@@ -658,11 +1318,68 @@ private:
 };
 
 
+//----------------------------------------------------------------------
+//======================================================================
+// InstancePool:
+//======================================================================
+
+/// Fixed-size slab allocator for the instances of a single CompiledType.
+/// Slabs are cache-line aligned and are carved lazily. Freed slots go on an
+/// intrusive free list. All of the memory is released when the pool dies,
+/// regardless of whether the instances were destroyed or not.
+class InstancePool
+{
+public:
+	InstancePool (SizeType instance_size, SizeType alignment, bool cache_line_slots, bool thread_cache);
+	~InstancePool ();
+
+	InstancePool (InstancePool const &) = delete;
+	InstancePool & operator = (InstancePool const &) = delete;
+
+	Byte * allocate ();				// Returns nullptr if out of memory
+	void deallocate (Byte * mem);	// mem must have come from this pool
+
+	SizeType slotSize () const {return m_slot_size;}
+	size_t slabSize () const {return m_slab_size;}
+	size_t slabCount () const;
+	bool hasThreadCache () const {return m_thread_cache;}
+
+	// Used by the thread caches; they move whole chains of free slots around.
+	details::PoolNode * takeChain (CountType max_count, CountType & count);
+	void returnChain (details::PoolNode * head, details::PoolNode * tail);
+
+private:
+	details::PoolNode * allocateLocked ();
+
+private:
+	SizeType const m_slot_size;
+	size_t const m_slab_size;
+	bool const m_thread_cache;
+	uint64_t const m_serial;		// Never reused, unlike the pool's address
+
+	mutable std::mutex m_lock;
+	details::PoolNode * m_free;
+	Byte * m_bump;					// Uncarved part of the newest slab
+	Byte * m_bump_end;
+	std::vector<Byte *> m_slabs;
+};
+
 //----------------------------------------------------------------------
 //======================================================================
 // CompiledType:
 //======================================================================
 
+/// Where a path into a CompiledType leads; see CompiledType::resolvePath().
+struct ResolvedPath
+{
+	Type const * type = nullptr;	// Of what the path names; nullptr if it didn't resolve
+	OffsetType offset = 0;			// From the start of the instance, with [*] taken as [0]
+	OffsetType stride = 0;			// Element size of the [*] array; 0 if there's no [*]
+	CountType count = 1;			// Element count of the [*] array
+};
+
+//----------------------------------------------------------------------
+
 class CompiledType
 {
 	//friend class TypeCompiler;
@@ -673,16 +1390,46 @@ private:
 	{
 		Hasher h;
 		type->updateHash (h);
-		return h.finalizeAndReset ();
+		return (sizeof(ID) > 4) ? ID(h.finalize64AndReset ()) : ID(h.finalizeAndReset ());
 	}
 	
 private:
-	CompiledType (Type const * type, Name name)
+	CompiledType (Type const * type, Name name, SizeType reorder_savings, CompileOptions const & options)
 		: m_type (type)
 		, m_size (type->getSizeOf())
+		, m_layout (details::FlattenLayout(type))
+		, m_fixed_footprint (type->isFixedFootprint())
 		, m_id (CalculateID(type))
 		, m_name (std::move(name))
+		, m_reorder_savings (reorder_savings)
+		, m_pool (new InstancePool {m_size, type->getAlignment(), options.pool_cache_line_slots, options.pool_thread_cache})
+		, m_field_index (type->isDyStruct() ? FieldIndex {type->asDyStruct()} : FieldIndex {})
+		, m_bytewise (CalculateBytewise())
+		, m_options (options)
+		, m_trivial_construct (type->isTriviallyConstructible())
+		, m_trivial_destruct (type->isTriviallyDestructible())
+		, m_trivial_copy (type->isTriviallyCopyable() && type->isTriviallyDestructible())
 	{}
+
+	// For reloading a saved registry; the ID and field index are handed in
+	CompiledType (Type const * type, Name name, ID id, SizeType reorder_savings, CompileOptions const & options, FieldIndex && field_index)
+		: m_type (type)
+		, m_size (type->getSizeOf())
+		, m_layout (details::FlattenLayout(type))
+		, m_fixed_footprint (type->isFixedFootprint())
+		, m_id (id)
+		, m_name (std::move(name))
+		, m_reorder_savings (reorder_savings)
+		, m_pool (new InstancePool {m_size, type->getAlignment(), options.pool_cache_line_slots, options.pool_thread_cache})
+		, m_field_index (std::move(field_index))
+		, m_bytewise (CalculateBytewise())
+		, m_options (options)
+		, m_trivial_construct (type->isTriviallyConstructible())
+		, m_trivial_destruct (type->isTriviallyDestructible())
+		, m_trivial_copy (type->isTriviallyCopyable() && type->isTriviallyDestructible())
+	{}
+
+	bool CalculateBytewise () const;
 	
 	~CompiledType ()
 	{
@@ -692,35 +1439,110 @@ private:
 public:
 	CompiledType & operator = (CompiledType const &) = delete;
 
+	// Instances come from this type's InstancePool; don't use them after the CompiledType is gone.
 	InstancePtr createInstance () const
 	{
-		Byte * mem = new Byte [sizeOf()];
+		Byte * mem = m_pool->allocate ();
+		if (nullptr == mem)
+			return InstancePtr (this);
 
-		if (false == rawType()->construct (mem, sizeOf()))
+		if (!m_trivial_construct && false == rawType()->construct (mem, sizeOf()))
 		{
-			delete[] mem;
+			m_pool->deallocate (mem);
 			return InstancePtr (this);
 		}
 
 		return InstancePtr (mem, this);
 	}
+
+	// Same, with the bytes zeroed before the instance is constructed.
+	InstancePtr createInstanceZeroed () const
+	{
+		Byte * mem = m_pool->allocate ();
+		if (nullptr == mem)
+			return InstancePtr (this);
+
+		std::memset (mem, 0, sizeOf());
+		if (!m_trivial_construct && false == rawType()->construct (mem, sizeOf()))
+		{
+			m_pool->deallocate (mem);
+			return InstancePtr (this);
+		}
+
+		return InstancePtr (mem, this);
+	}
+
+	// A byte copy of prototype; only for trivially copyable types.
+	InstancePtr createInstanceCopy (InstancePtr prototype) const
+	{
+		assert (prototype.typePtr() == this && !prototype.isNull());
+		assert (isTriviallyCopyable());
+		if (!isTriviallyCopyable())
+			return InstancePtr (this);
+
+		Byte * mem = m_pool->allocate ();
+		if (nullptr == mem)
+			return InstancePtr (this);
+
+		std::memcpy (mem, prototype.data(), sizeOf());
+		return InstancePtr (mem, this);
+	}
 	
+	// An InstancePtr over memory this type doesn't own, e.g. a C++ struct that
+	// was bound with compileStatic(). Don't destroy it; the memory stays the
+	// caller's, and must be laid out as this type says.
+	InstancePtr wrapInstance (void * mem) const
+	{
+		assert (nullptr != mem);
+		assert (0 == (reinterpret_cast<uintptr_t>(mem) & (alignment() - 1)));
+		return InstancePtr (static_cast<Byte *>(mem), this);
+	}
+
 	void destroyInstance (InstancePtr & instance) const
 	{
 		assert (instance.typePtr() == this);
 		
 		if (!instance.isNull())
 		{
-			rawType()->destruct (instance.data(), sizeOf());
-			delete[] instance.data();
+			if (!m_trivial_destruct)
+				rawType()->destruct (instance.data(), sizeOf());
+			m_pool->deallocate (instance.data());
 			instance.m_data = nullptr;
 		}	
 	}
 	
 	Type const * rawType () const {return m_type;}
 	SizeType sizeOf() const {return m_size;}
+	bool isFixedFootprint () const {return m_fixed_footprint;}
 	ID id () const {return m_id;}
 	Name const & name () const {return m_name;}
+	SizeType alignment () const {return m_type->getAlignment();}
+	SizeType reorderSavings () const {return m_reorder_savings;}	// Bytes saved by CompileOptions::reorder_fields
+	InstancePool const & pool () const {return *m_pool;}
+	CompileOptions const & options () const {return m_options;}
+
+	// Content hash and equality of two instances of this type, e.g. for using
+	// instances as hash map keys. Padding is ignored. Floats compare by value,
+	// except that all NaNs are equal to each other (and -0 equals +0, as usual.)
+	// Types with no padding and no floats just hash and compare the raw bytes.
+	uint64_t hashInstance (InstancePtr inst) const;
+	bool equals (InstancePtr a, InstancePtr b) const;
+	bool isBytewiseComparable () const {return m_bytewise;}
+
+	// Computed once, at compile time. Instances of trivially copyable types
+	// can be copied with plain memcpy, and thrown away without a walk.
+	bool isTriviallyConstructible () const {return m_trivial_construct;}
+	bool isTriviallyDestructible () const {return m_trivial_destruct;}
+	bool isTriviallyCopyable () const {return m_trivial_copy;}
+
+	// Every leaf value of an instance, flattened out of the type tree in offset
+	// order, with neighbouring runs of the same Basic merged. Padding is not in
+	// here. Walk this instead of recursing through the (virtual) Type tree.
+	LayoutContainer const & layout () const {return m_layout;}
+
+	// For DyStructs; nullptr if there's no such field (or this isn't a DyStruct.)
+	DyStructType::Field const * findField (std::string const & field_name) const {return m_field_index.find (field_name);}
+	DyStructType::Field const * findField (std::string const & field_name, FieldIndex::HashType hash) const {return m_field_index.find (field_name, hash);}
 	
 	template <Basic basic_type>
 	AccessorDirect<basic_type> accessor () const
@@ -743,12 +1565,19 @@ public:
 
 	template <Basic basic_type>
 	Accessor<basic_type> accessorField (std::string const & field_name) const
+	{
+		return accessorField<basic_type> (field_name, FieldIndex::Hash(field_name));
+	}
+
+	// Same as above, with the hash of the name (from FieldIndex::Hash) already computed.
+	template <Basic basic_type>
+	Accessor<basic_type> accessorField (std::string const & field_name, FieldIndex::HashType hash) const
 	{
 		assert (m_type->isDyStruct());
-		assert (m_type->asDyStruct()->hasField(field_name));
 
-		auto field = m_type->asDyStruct()->findField (field_name);
+		auto field = m_field_index.find (field_name, hash);
 
+		assert (field);
 		assert (field->type->isBasic());
 		assert (field->type->asBasic()->getType() == basic_type);
 
@@ -759,10 +1588,10 @@ public:
 	AccessorArray<basic_type> accessorFieldArray (std::string const & field_name) const
 	{
 		assert (m_type->isDyStruct());
-		assert (m_type->asDyStruct()->hasField(field_name));
 
-		auto field = m_type->asDyStruct()->findField (field_name);
+		auto field = m_field_index.find (field_name);
 
+		assert (field);
 		assert (field->type->isArray());
 		assert (field->type->asArray()->getElemType()->isBasic());
 		assert (field->type->asArray()->getElemType()->asBasic()->getType() == basic_type);
@@ -770,11 +1599,126 @@ public:
 		return AccessorArray<basic_type>{field->offset};
 	}
 
+	// Treats a run of packed instances of this type as an array of this one field.
+	template <Basic basic_type>
+	AccessorStriden<basic_type> accessorFieldStrided (std::string const & field_name) const
+	{
+		assert (m_type->isDyStruct());
+
+		auto field = m_field_index.find (field_name);
+
+		assert (field);
+		assert (field->type->isBasic());
+		assert (field->type->asBasic()->getType() == basic_type);
+
+		return AccessorStriden<basic_type>{field->offset, m_size};
+	}
+
+	// Resolves a path of field names and array indices, such as "a.b[3].c" or
+	// "[2].x", down to a single offset. One of the indices may be "[*]", which
+	// makes the path strided over that array, as in "points[*].x".
+	ResolvedPath resolvePath (std::string const & path) const;
+
+	// Direct accessors into nested fields, resolved once, up front; they cost
+	// the same as a one-level accessorField(). The path must end in a Basic (or
+	// an Enum whose underlying type is basic_type.) The accessors below come
+	// back invalid (see their isValid()) if the path doesn't resolve, or leads
+	// to something of the wrong type; check before using one built from input.
+	template <Basic basic_type>
+	Accessor<basic_type> accessorPath (std::string const & path) const
+	{
+		auto rp = resolvePath (path);
+		if (!rp.type || 0 != rp.stride || !IsLeafOf (rp.type, basic_type))
+			return Accessor<basic_type>{InvalidOffset};
+
+		return Accessor<basic_type>{rp.offset};
+	}
+
+	// For paths with a [*]; count, if given, gets the element count of that array.
+	template <Basic basic_type>
+	AccessorStriden<basic_type> accessorPathStrided (std::string const & path, CountType * count = nullptr) const
+	{
+		auto rp = resolvePath (path);
+		if (!rp.type || 0 == rp.stride || !IsLeafOf (rp.type, basic_type))
+			return AccessorStriden<basic_type>{InvalidOffset, 0};
+
+		if (count)
+			*count = rp.count;
+		return AccessorStriden<basic_type>{rp.offset, rp.stride};
+	}
+
+	// For a String field, at the end of a path as above (without [*].)
+	StringAccessor accessorString (std::string const & path) const;
+
+	// For a Vector field of Basics (or Enums), at the end of a path; see Vector.h.
+	template <Basic basic_type>
+	VectorAccessor<basic_type> accessorVector (std::string const & path) const
+	{
+		auto rp = resolvePath (path);
+		if (!rp.type || 0 != rp.stride || !rp.type->isVector() || !IsLeafOf (rp.type->asVector()->getElemType(), basic_type))
+			return VectorAccessor<basic_type>{InvalidOffset, nullptr};
+
+		return VectorAccessor<basic_type>{rp.offset, rp.type->asVector()};
+	}
+
+	// For a Set or Map field at the end of a path; see HashTable.h for what
+	// K and V can be. Invalid if they don't fit the key and value types.
+	template <typename K>
+	SetAccessor<K> accessorSet (std::string const & path) const
+	{
+		auto rp = resolvePath (path);
+		if (!rp.type || 0 != rp.stride || !rp.type->isSet() || !details::TableKey<K>::Accepts (rp.type->asSet()->getKeyType()))
+			return SetAccessor<K>{InvalidOffset, nullptr};
+
+		return SetAccessor<K>{rp.offset, rp.type->asSet()};
+	}
+
+	template <typename K, typename V>
+	MapAccessor<K, V> accessorMap (std::string const & path) const
+	{
+		auto rp = resolvePath (path);
+		if (!rp.type || 0 != rp.stride || !rp.type->isMap() || !details::TableKey<K>::Accepts (rp.type->asMap()->getKeyType())
+			|| (!std::is_same<V, Byte>::value && sizeof(V) != rp.type->asMap()->getValueType()->getSizeOf()))
+			return MapAccessor<K, V>{InvalidOffset, nullptr};
+
+		return MapAccessor<K, V>{rp.offset, rp.type->asMap()};
+	}
+
+private:
+	static bool IsLeafOf (Type const * type, Basic basic_type)
+	{
+		return (type->isBasic() && type->asBasic()->getType() == basic_type)
+			|| (type->isEnum() && type->asEnum()->getUnderlyingType() == basic_type);
+	}
+
 protected:
 	Type const * m_type;
 	SizeType const m_size;
+	LayoutContainer const m_layout;
+	bool const m_fixed_footprint;
 	ID const m_id;
 	Name const m_name;
+	SizeType const m_reorder_savings;
+	std::unique_ptr<InstancePool> const m_pool;
+	FieldIndex const m_field_index;
+	bool const m_bytewise;	// No padding, no floats; instances can be hashed and compared as plain bytes
+	CompileOptions const m_options;
+	bool const m_trivial_construct;
+	bool const m_trivial_destruct;
+	bool const m_trivial_copy;
+};
+
+//----------------------------------------------------------------------
+
+/// For unordered containers keyed by instance contents.
+struct InstanceHash
+{
+	size_t operator () (InstancePtr inst) const {return size_t(inst.type().hashInstance (inst));}
+};
+
+struct InstanceEqual
+{
+	bool operator () (InstancePtr a, InstancePtr b) const {return a.typePtr() == b.typePtr() && a.type().equals (a, b);}
 };
 
 //----------------------------------------------------------------------
@@ -5,7 +5,11 @@
 	
 //======================================================================
 
-#include <cstdio>
+#include <cstring>
+
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
 
 //======================================================================
 
@@ -13,6 +17,48 @@ namespace DyStruct {
 
 //======================================================================
 
+namespace details {
+	// Multiplies and folds the 128-bit product into 64 bits.
+	inline uint64_t Mum (uint64_t a, uint64_t b)
+	{
+	#if defined(__SIZEOF_INT128__)
+		unsigned __int128 r = a;
+		r *= b;
+		return uint64_t(r) ^ uint64_t(r >> 64);
+	#elif defined(_MSC_VER) && defined(_M_X64)
+		uint64_t hi;
+		uint64_t lo = _umul128 (a, b, &hi);
+		return lo ^ hi;
+	#else
+		uint64_t ha = a >> 32, hb = b >> 32, la = uint32_t(a), lb = uint32_t(b);
+		uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+		uint64_t t = rl + (rm0 << 32);
+		uint64_t c = (t < rl) ? 1 : 0;
+		uint64_t lo = t + (rm1 << 32);
+		c += (lo < t) ? 1 : 0;
+		uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+		return lo ^ hi;
+	#endif
+	}
+
+	inline uint64_t LoadLE64 (void const * p)
+	{
+		uint64_t ret;
+		std::memcpy (&ret, p, 8);
+	#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+		ret = __builtin_bswap64 (ret);
+	#endif
+		return ret;
+	}
+
+	uint64_t const gc_HashP0 = 0xa0761d6478bd642fULL;
+	uint64_t const gc_HashP1 = 0xe7037ed1a0b428dbULL;
+	uint64_t const gc_HashP2 = 0x8ebc6af09c88c6e3ULL;
+	uint64_t const gc_HashP3 = 0x589965cc75374cc3ULL;
+}
+
+//----------------------------------------------------------------------
+
 inline Hasher::Hasher ()
 {
 	reset ();
@@ -27,10 +73,21 @@ inline void Hasher::reset ()
 
 //----------------------------------------------------------------------
 
-inline void Hasher::update (void const * data, unsigned len)
+inline void Hasher::update (void const * data, size_t len)
 {
 	auto bytes = reinterpret_cast<unsigned char const *>(data);
-	for (unsigned i = 0; i < len; ++i)
+	size_t i = 0;
+
+	while (m_buffered != 0 && i < len)
+		hashByte (bytes[i++]);
+
+	for (; i + 8 <= len; i += 8)
+	{
+		mixWord (details::LoadLE64 (bytes + i));
+		m_length += 8;
+	}
+
+	for (; i < len; ++i)
 		hashByte (bytes[i]);
 }
 
@@ -38,67 +95,103 @@ inline void Hasher::update (void const * data, unsigned len)
 
 inline void Hasher::updateString (void const * str)
 {
-	auto bytes = reinterpret_cast<unsigned char const *>(str);
-	for (unsigned i = 0; bytes[i]; ++i)
-		hashByte (bytes[i]);
+	update (str, std::strlen (reinterpret_cast<char const *>(str)));
 }
 
 //----------------------------------------------------------------------
 
 inline void Hasher::updateUnsigned (uint32_t val)
 {
-	char temp [13];
-#if defined(_MSC_VER)
-	_snprintf_s (temp, 12, "%u", val);
-#else
-	snprintf (temp, 12, "%u", val);
-#endif
-	temp[12] = '\0';	// Just in case
+	updateWordBytes (val, 4);
+}
 
-	updateString (temp);
+//----------------------------------------------------------------------
+
+inline void Hasher::updateUnsigned64 (uint64_t val)
+{
+	updateWordBytes (val, 8);
 }
 
 //----------------------------------------------------------------------
 
 inline uint32_t Hasher::finalizeAndReset ()
 {
-	finalMix ();
-	auto ret = m_hash;
+	auto h = finalMix ();
+	reset ();
+	
+	return uint32_t(h ^ (h >> 32));
+}
+
+//----------------------------------------------------------------------
+
+inline uint64_t Hasher::finalize64AndReset ()
+{
+	auto ret = finalMix ();
 	reset ();
 	
 	return ret;
 }
 
+//----------------------------------------------------------------------
+
+inline void Hasher::hashByte (unsigned char byte)
+{
+	m_buffer |= uint64_t(byte) << (8 * m_buffered);
+	m_length += 1;
+	if (++m_buffered == 8)
+	{
+		mixWord (m_buffer);
+		m_buffer = 0;
+		m_buffered = 0;
+	}
+}
+
 //----------------------------------------------------------------------
 //----------------------------------------------------------------------
 
-inline void Hasher::setup (uint32_t init)
+// Same as hashing the low count bytes of val one at a time, but shifts them
+//  into the buffer all at once, and carries over whatever doesn't fit.
+inline void Hasher::updateWordBytes (uint64_t val, unsigned count)
 {
-	m_hash = init;
+	m_buffer |= val << (8 * m_buffered);
+	m_length += count;
+	m_buffered += count;
+	if (m_buffered < 8)
+		return;
+
+	mixWord (m_buffer);
+	m_buffered -= 8;
+	m_buffer = m_buffered == 0 ? 0 : val >> (8 * (count - m_buffered));
 }
 
 //----------------------------------------------------------------------
 
-inline void Hasher::hashByte (unsigned char byte)
+inline void Hasher::setup (uint64_t init)
 {
-	auto hash = m_hash;
-	hash += byte;
-	hash += hash << 10;
-	hash ^= hash >> 6;
-	m_hash = hash;
+	m_hash = init ^ details::gc_HashP0;
+	m_buffer = 0;
+	m_buffered = 0;
+	m_length = 0;
 }
 
 //----------------------------------------------------------------------
 
-inline void Hasher::finalMix ()
+inline void Hasher::mixWord (uint64_t word)
+{
+	m_hash = details::Mum (m_hash ^ word ^ details::gc_HashP1, details::gc_HashP0);
+}
+
+//----------------------------------------------------------------------
+
+inline uint64_t Hasher::finalMix () const
 {
 	auto hash = m_hash;
 	
-	hash += hash << 3;
-	hash ^= hash >> 11;
-	hash += hash << 15;
+	// The partial word goes in with the length, so trailing zero bytes still count
+	hash = details::Mum (hash ^ m_buffer ^ details::gc_HashP2, m_length ^ details::gc_HashP3);
+	hash = details::Mum (hash ^ details::gc_HashP0, details::gc_HashP1);
 	
-	m_hash = hash;
+	return hash;
 }
 
 //----------------------------------------------------------------------
@@ -138,6 +231,40 @@ inline void ArrayType::updateHash (Hasher & hasher) const
 	hasher.updateString ("]");
 }
 
+//----------------------------------------------------------------------
+
+inline bool ArrayType::construct (void * mem, SizeType sz) const
+{
+	assert (sz == getSizeOf());
+	if (sz != getSizeOf())
+		return false;
+	if (m_element_type->isTriviallyConstructible())
+		return true;
+
+	auto elem_size = m_element_type->getSizeOf();
+	for (CountType i = 0; i < m_count; ++i)
+		m_element_type->construct (((char *)mem) + i * elem_size, elem_size);
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+inline bool ArrayType::destruct (void * mem, SizeType sz) const
+{
+	assert (sz == getSizeOf());
+	if (sz != getSizeOf())
+		return false;
+	if (m_element_type->isTriviallyDestructible())
+		return true;
+
+	auto elem_size = m_element_type->getSizeOf();
+	for (CountType i = m_count; i > 0; --i)
+		m_element_type->destruct (((char *)mem) + (i - 1) * elem_size, elem_size);
+
+	return true;
+}
+
 //======================================================================
 
 inline void DyStructType::Field::hash (Hasher & hasher) const
@@ -190,6 +317,132 @@ inline bool DyStructType::destruct (void * mem, SizeType sz) const
 	return true;
 }
 
+//----------------------------------------------------------------------
+
+inline bool DyStructType::isTriviallyConstructible () const
+{
+	for (auto const & f : m_fields)
+		if (!f.type->isTriviallyConstructible())
+			return false;
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+inline bool DyStructType::isTriviallyDestructible () const
+{
+	for (auto const & f : m_fields)
+		if (!f.type->isTriviallyDestructible())
+			return false;
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+inline bool DyStructType::isTriviallyCopyable () const
+{
+	for (auto const & f : m_fields)
+		if (!f.type->isTriviallyCopyable())
+			return false;
+	return true;
+}
+
+//======================================================================
+
+inline void StringType::updateHash (Hasher & hasher) const
+{
+	hasher.updateString (m_interned ? "IString" : "String");
+	hasher.updateUnsigned (m_inline_capacity);
+}
+
+//----------------------------------------------------------------------
+
+inline StringRef StringType::ReadSlot (Byte const * slot, SizeType slot_size)
+{
+	auto tag = slot[slot_size - 1];
+	if (LongTag != tag)
+		return StringRef {reinterpret_cast<char const *>(slot), tag};
+
+	char const * ptr;
+	uint32_t length;
+	std::memcpy (&ptr, slot, sizeof(ptr));
+	std::memcpy (&length, slot + sizeof(ptr), sizeof(length));
+	return StringRef {ptr, length};
+}
+
+//======================================================================
+
+inline void VectorType::updateHash (Hasher & hasher) const
+{
+	hasher.updateString ("{");
+	m_element_type->updateHash (hasher);
+	hasher.updateString ("}");
+}
+
+//======================================================================
+
+inline HashTableType const * Type::asHashTable () const
+{
+	return (isSet() || isMap()) ? static_cast<HashTableType const *>(this) : nullptr;
+}
+
+//----------------------------------------------------------------------
+
+inline HashTableType * Type::asHashTable ()
+{
+	return (isSet() || isMap()) ? static_cast<HashTableType *>(this) : nullptr;
+}
+
+//----------------------------------------------------------------------
+
+template <typename F>
+inline void HashTableType::forEach (Byte * slot, F && f) const
+{
+	auto h = HeaderOf (slot);
+	if (0 == h->size)
+		return;
+
+	auto entries = EntriesOf (h->ctrl, h->capacity, m_entry_align);
+	for (uint32_t i = 0; i < h->capacity; ++i)
+		if (0 == (h->ctrl[i] & 0x80))
+			f (entries + size_t(i) * m_entry_size);
+}
+
+//----------------------------------------------------------------------
+
+template <typename F>
+inline void HashTableType::forEach (Byte const * slot, F && f) const
+{
+	auto h = HeaderOf (slot);
+	if (0 == h->size)
+		return;
+
+	Byte const * entries = EntriesOf (h->ctrl, h->capacity, m_entry_align);
+	for (uint32_t i = 0; i < h->capacity; ++i)
+		if (0 == (h->ctrl[i] & 0x80))
+			f (entries + size_t(i) * m_entry_size);
+}
+
+//----------------------------------------------------------------------
+
+inline void SetType::updateHash (Hasher & hasher) const
+{
+	hasher.updateString ("Set{");
+	getKeyType()->updateHash (hasher);
+	hasher.updateString ("}");
+}
+
+//----------------------------------------------------------------------
+
+inline void MapType::updateHash (Hasher & hasher) const
+{
+	hasher.updateString ("Map{");
+	getKeyType()->updateHash (hasher);
+	hasher.updateString (":");
+	getValueType()->updateHash (hasher);
+	hasher.updateString ("}");
+}
+
 //======================================================================
 
 inline void InstancePtr::destroySelf ()
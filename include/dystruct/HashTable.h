@@ -0,0 +1,177 @@
+#pragma once
+
+#if !defined(__Y__DYSTRUCT_HASH_TABLE_H__)
+#define      __Y__DYSTRUCT_HASH_TABLE_H__
+
+//======================================================================
+
+#include "DyStruct.h"
+#include "Arena.h"
+
+#include <cstring>
+#include <type_traits>
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+namespace details {
+	// How the accessors below hand keys of type K to HashTableType, and read
+	// them back. K is the C++ type of a Basic (see BasicTypeMap), which also
+	// works for Enums of that size, or StringRef for String keys.
+	template <typename K>
+	struct TableKey
+	{
+		static_assert (std::is_arithmetic<K>::value, "Keys are Basic values, or StringRefs");
+
+		static bool Accepts (Type const * key_type)
+		{
+			Basic basic;
+			if (key_type->isBasic())
+				basic = key_type->asBasic()->getType();
+			else if (key_type->isEnum())
+				basic = key_type->asEnum()->getUnderlyingType();
+			else
+				return false;
+			return gc_BasicTraits[int(basic)].size == sizeof(K) && gc_BasicTraits[int(basic)].is_float == std::is_floating_point<K>::value;
+		}
+
+		static K Read (HashTableType const * /*table*/, Byte const * entry) {K ret; std::memcpy (&ret, entry, sizeof(K)); return ret;}
+	};
+
+	template <>
+	struct TableKey<StringRef>
+	{
+		static bool Accepts (Type const * key_type) {return key_type->isString();}
+		static StringRef Read (HashTableType const * table, Byte const * entry) {return table->readStringKey (entry);}
+	};
+}
+
+//======================================================================
+
+/// For a Set field; get one from CompiledType::accessorSet(). K is the C++
+/// type of the key (e.g. int32_t, or StringRef.) As with VectorAccessor, the
+/// arena should be the one that owns the instance, e.g. InstanceArray::arena().
+template <typename K>
+class SetAccessor
+{
+	typedef details::TableKey<K> KeyT;
+
+public:
+	SetAccessor (OffsetType offset, SetType const * type)
+		: m_offset {offset}
+		, m_type {type}
+	{
+		assert (nullptr == type || KeyT::Accepts (type->getKeyType()));
+	}
+
+	size_t size (InstancePtr inst) const {return header(inst)->size;}
+	bool empty (InstancePtr inst) const {return 0 == header(inst)->size;}
+
+	bool contains (InstancePtr inst, K key) const {return nullptr != m_type->find (inst.data() + m_offset, &key);}
+
+	// False only if out of memory; inserted says whether key is new.
+	bool insert (InstancePtr inst, K key, Arena & arena, bool * inserted = nullptr) const {return nullptr != m_type->insert (inst.data() + m_offset, &key, arena, inserted);}
+	bool erase (InstancePtr inst, K key) const {return m_type->erase (inst.data() + m_offset, &key);}
+
+	bool reserve (InstancePtr inst, size_t count, Arena & arena) const {return m_type->reserve (inst.data() + m_offset, count, arena);}
+	void clear (InstancePtr inst) const {m_type->clear (inst.data() + m_offset);}
+
+	// Calls f (key) for every key, in no particular order.
+	template <typename F>
+	void forEach (InstancePtr inst, F && f) const
+	{
+		auto type = m_type;
+		m_type->forEach (const_cast<Byte const *>(inst.data() + m_offset), [&] (Byte const * entry) {f (KeyT::Read (type, entry));});
+	}
+
+	OffsetType offset () const {return m_offset;}
+	SetType const * type () const {return m_type;}
+	bool isValid () const {return nullptr != m_type;}	// False if it came from a path that didn't resolve
+
+private:
+	HashTableType::Header * header (InstancePtr inst) const {return HashTableType::HeaderOf (inst.data() + m_offset);}
+
+private:
+	OffsetType m_offset;
+	SetType const * m_type;
+};
+
+//======================================================================
+
+/// For a Map field; get one from CompiledType::accessorMap(). K is as for
+/// SetAccessor; V is the C++ type of the values, which must be the same size
+/// as the Map's value type (a Basic's type, or a struct mirroring a DyStruct
+/// value), or Byte to get at the raw bytes of any value. Value pointers are
+/// good until the next insert into the same map.
+template <typename K, typename V>
+class MapAccessor
+{
+	typedef details::TableKey<K> KeyT;
+
+public:
+	MapAccessor (OffsetType offset, MapType const * type)
+		: m_offset {offset}
+		, m_type {type}
+	{
+		assert (nullptr == type || KeyT::Accepts (type->getKeyType()));
+		assert (nullptr == type || (std::is_same<V, Byte>::value) || sizeof(V) == type->getValueType()->getSizeOf());
+	}
+
+	size_t size (InstancePtr inst) const {return header(inst)->size;}
+	bool empty (InstancePtr inst) const {return 0 == header(inst)->size;}
+
+	bool contains (InstancePtr inst, K key) const {return nullptr != m_type->find (inst.data() + m_offset, &key);}
+
+	// The value of key, or nullptr.
+	V * find (InstancePtr inst, K key) const {return value (m_type->find (inst.data() + m_offset, &key));}
+
+	// The value of key, added zeroed if it isn't there; nullptr if out of memory.
+	V * insert (InstancePtr inst, K key, Arena & arena, bool * inserted = nullptr) const {return value (m_type->insert (inst.data() + m_offset, &key, arena, inserted));}
+
+	bool set (InstancePtr inst, K key, V const & val, Arena & arena) const
+	{
+		static_assert (!std::is_same<V, Byte>::value, "Use insert() and write the bytes");
+		auto p = insert (inst, key, arena);
+		if (nullptr == p)
+			return false;
+		std::memcpy (p, &val, sizeof(V));
+		return true;
+	}
+
+	bool erase (InstancePtr inst, K key) const {return m_type->erase (inst.data() + m_offset, &key);}
+
+	bool reserve (InstancePtr inst, size_t count, Arena & arena) const {return m_type->reserve (inst.data() + m_offset, count, arena);}
+	void clear (InstancePtr inst) const {m_type->clear (inst.data() + m_offset);}
+
+	// Calls f (key, value) for every entry, in no particular order.
+	template <typename F>
+	void forEach (InstancePtr inst, F && f) const
+	{
+		auto type = m_type;
+		auto value_offset = m_type->getValueOffset();
+		m_type->forEach (inst.data() + m_offset, [&] (Byte * entry) {f (KeyT::Read (type, entry), *reinterpret_cast<V *>(entry + value_offset));});
+	}
+
+	OffsetType offset () const {return m_offset;}
+	MapType const * type () const {return m_type;}
+	bool isValid () const {return nullptr != m_type;}	// False if it came from a path that didn't resolve
+
+private:
+	HashTableType::Header * header (InstancePtr inst) const {return HashTableType::HeaderOf (inst.data() + m_offset);}
+	V * value (Byte * entry) const {return entry ? reinterpret_cast<V *>(entry + m_type->getValueOffset()) : nullptr;}
+
+private:
+	OffsetType m_offset;
+	MapType const * m_type;
+};
+
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================
+
+#endif	// __Y__DYSTRUCT_HASH_TABLE_H__
@@ -0,0 +1,146 @@
+#pragma once
+
+#if !defined(__Y__DYSTRUCT_INSTANCE_ARRAY_H__)
+#define      __Y__DYSTRUCT_INSTANCE_ARRAY_H__
+
+//======================================================================
+
+#include "DyStruct.h"
+#include "Arena.h"
+
+#include <cstddef>
+#include <iterator>
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+/// Owns a bunch of instances of a single CompiledType, packed back-to-back
+/// (array-of-structs) in one cache-line aligned block, sizeOf() bytes apart.
+/// Elements are handed out as plain InstancePtrs, so any accessor works on
+/// them. Growing the array moves the instances around with memcpy (DyStruct
+/// instances never point into themselves) and invalidates the InstancePtrs.
+/// The elements of Vector fields go into the array's own arena(), and are
+/// all freed together with it.
+class InstanceArray
+{
+	friend class MorphPlan;
+
+public:
+	class Iterator
+	{
+		friend class InstanceArray;
+
+	public:
+		typedef std::random_access_iterator_tag iterator_category;
+		typedef InstancePtr value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef InstancePtr const * pointer;
+		typedef InstancePtr reference;
+
+	private:
+		Iterator (Byte * base, size_t index, SizeType stride, CompiledType const * ctype)
+			: m_base (base), m_index (index), m_stride (stride), m_ctype (ctype)
+		{}
+
+	public:
+		InstancePtr operator * () const {return InstancePtr (m_base + m_index * m_stride, m_ctype);}
+		InstancePtr operator [] (difference_type n) const {return InstancePtr (m_base + (m_index + n) * m_stride, m_ctype);}
+		size_t index () const {return m_index;}
+
+		Iterator & operator ++ () {++m_index; return *this;}
+		Iterator & operator -- () {--m_index; return *this;}
+		Iterator operator ++ (int) {auto ret = *this; ++m_index; return ret;}
+		Iterator operator -- (int) {auto ret = *this; --m_index; return ret;}
+		Iterator & operator += (difference_type n) {m_index += n; return *this;}
+		Iterator & operator -= (difference_type n) {m_index -= n; return *this;}
+		Iterator operator + (difference_type n) const {auto ret = *this; return ret += n;}
+		Iterator operator - (difference_type n) const {auto ret = *this; return ret -= n;}
+		difference_type operator - (Iterator const & that) const {return difference_type(m_index) - difference_type(that.m_index);}
+
+		bool operator == (Iterator const & that) const {return m_index == that.m_index;}
+		bool operator != (Iterator const & that) const {return m_index != that.m_index;}
+		bool operator < (Iterator const & that) const {return m_index < that.m_index;}
+		bool operator > (Iterator const & that) const {return m_index > that.m_index;}
+		bool operator <= (Iterator const & that) const {return m_index <= that.m_index;}
+		bool operator >= (Iterator const & that) const {return m_index >= that.m_index;}
+
+	private:
+		Byte * m_base;
+		size_t m_index;	// Compare indices, not pointers; stride might be zero
+		SizeType m_stride;
+		CompiledType const * m_ctype;
+	};
+
+public:
+	explicit InstanceArray (CompiledType const * ctype);
+	InstanceArray (CompiledType const * ctype, size_t count);	// Check size() to see if it worked
+	~InstanceArray ();
+
+	InstanceArray (InstanceArray && that);
+	InstanceArray & operator = (InstanceArray && that);
+
+	InstanceArray (InstanceArray const &) = delete;
+	InstanceArray & operator = (InstanceArray const &) = delete;
+
+	CompiledType const & type () const {return *m_ctype;}
+	CompiledType const * typePtr () const {return m_ctype;}
+	SizeType stride () const {return m_stride;}
+	size_t size () const {return m_size;}
+	size_t capacity () const {return m_capacity;}
+	bool empty () const {return 0 == m_size;}
+
+	Byte * data () {return m_data;}
+	Byte const * data () const {return m_data;}
+
+	// Where the elements of the instances' Vector fields should go.
+	Arena & arena () {return m_arena;}
+
+	// InstancePtr, like a pointer, doesn't do const.
+	InstancePtr operator [] (size_t index) const {assert (index < m_size); return InstancePtr (m_data + index * m_stride, m_ctype);}
+	InstancePtr front () const {return (*this)[0];}
+	InstancePtr back () const {return (*this)[m_size - 1];}
+
+	Iterator begin () const {return Iterator (m_data, 0, m_stride, m_ctype);}
+	Iterator end () const {return Iterator (m_data, m_size, m_stride, m_ctype);}
+
+	bool reserve (size_t count);
+	bool resize (size_t count);		// New instances are constructed, removed ones are destructed
+	bool resizeZeroed (size_t count);	// Same, but new instances are zeroed before they're constructed
+
+	// New instances are byte copies of prototype (which may not be one of
+	// this array's own); only for trivially copyable types.
+	bool resize (size_t count, InstancePtr prototype);
+	InstancePtr push ();			// Returns a null InstancePtr on failure
+	void pop ();
+	void clear ();					// Keeps the memory around; resets the arena
+	void shrinkToFit ();
+
+private:
+	// New instances are left as they are, for a caller that writes every byte
+	// of them (but padding) itself, e.g. a MorphPlan.
+	bool resizeUninitialized (size_t count);
+
+	bool reallocate (size_t new_capacity);
+	bool grow (size_t count);
+	bool constructRange (size_t first, size_t last);
+	void destructRange (size_t first, size_t last);
+
+private:
+	CompiledType const * m_ctype;
+	SizeType m_stride;
+	size_t m_size;
+	size_t m_capacity;
+	Byte * m_data;
+	Arena m_arena;
+};
+
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================
+
+#endif	// __Y__DYSTRUCT_INSTANCE_ARRAY_H__
@@ -0,0 +1,147 @@
+#pragma once
+
+#if !defined(__Y__DYSTRUCT_INSTANCE_FILE_H__)
+#define      __Y__DYSTRUCT_INSTANCE_FILE_H__
+
+//======================================================================
+
+#include "DyStruct.h"
+
+#include <cstring>
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+class InstanceArray;
+
+//----------------------------------------------------------------------
+
+namespace details {
+	// Helpers for the binary formats; values are stored as they are in memory.
+	template <typename T>
+	void BlobPut (std::vector<Byte> & out, T v)
+	{
+		auto p = reinterpret_cast<Byte const *>(&v);
+		out.insert (out.end(), p, p + sizeof(T));
+	}
+
+	inline void BlobPutString (std::vector<Byte> & out, std::string const & str)
+	{
+		BlobPut (out, uint32_t(str.size()));
+		out.insert (out.end(), str.begin(), str.end());
+	}
+
+	// These return false, and leave cur alone, if there's not enough left before end.
+	template <typename T>
+	bool BlobGet (Byte const * & cur, Byte const * end, T & v)
+	{
+		if (size_t(end - cur) < sizeof(T))
+			return false;
+		std::memcpy (&v, cur, sizeof(T));
+		cur += sizeof(T);
+		return true;
+	}
+
+	inline bool BlobGetString (Byte const * & cur, Byte const * end, std::string & str)
+	{
+		uint32_t len = 0;
+		auto p = cur;
+		if (!BlobGet (p, end, len) || size_t(end - p) < len)
+			return false;
+		str.assign (reinterpret_cast<char const *>(p), len);
+		cur = p + len;
+		return true;
+	}
+}
+
+//----------------------------------------------------------------------
+
+// A binary description of a Type tree (families, Basic types, counts, enum
+// entries, field names and field order; no offsets, since those follow from
+// the rest.) Writing fails for families that can't be described yet.
+// Reading creates fresh Types in the TypeManager; it returns nullptr (and
+// leaves whatever it created so far to the TypeManager) on malformed input,
+// which includes types nested more than 64 levels deep.
+bool WriteTypeDescription (Type const * type, std::vector<Byte> & out);
+Type * ReadTypeDescription (TypeManager & tm, Byte const * & cur, Byte const * end);
+
+//======================================================================
+
+/// A read-only file mapped into memory. Pages are copy-on-write, so the
+/// mapping can be written to, but nothing goes back to the file.
+class MappedFile
+{
+public:
+	MappedFile ();
+	~MappedFile ();
+
+	MappedFile (MappedFile const &) = delete;
+	MappedFile & operator = (MappedFile const &) = delete;
+
+	bool open (std::string const & path);
+	void close ();
+
+	bool isOpen () const {return nullptr != m_data;}
+	Byte * data () const {return m_data;}
+	size_t size () const {return m_size;}
+
+private:
+	Byte * m_data;
+	size_t m_size;
+#if defined(_WIN32)
+	void * m_file;
+	void * m_mapping;
+#endif
+};
+
+//======================================================================
+
+/// A file of packed instances of one fixed-footprint CompiledType: a header
+/// (type ID, name and description,) then the instances exactly as they are
+/// laid out in memory, starting on a cache-line boundary. Opening one maps
+/// it and hands out InstancePtrs right into the mapping; nothing is parsed
+/// or copied. The files are only meant to be read on the same kind of
+/// machine (endianness, Basic sizes) that wrote them.
+class InstanceFile
+{
+public:
+	static bool Write (std::string const & path, InstanceArray const & instances);
+	static bool Write (std::string const & path, CompiledType const & type, void const * data, size_t count);
+
+public:
+	InstanceFile ();
+	~InstanceFile () = default;
+
+	InstanceFile (InstanceFile const &) = delete;
+	InstanceFile & operator = (InstanceFile const &) = delete;
+
+	// Uses the CompiledType of the stored name if tm has one (it must have the
+	// stored ID,) otherwise rebuilds the type from the stored description and
+	// compiles it under that name.
+	bool open (std::string const & path, TypeManager & tm);
+	void close ();
+
+	bool isOpen () const {return nullptr != m_ctype;}
+	CompiledType const * typePtr () const {return m_ctype;}
+	size_t size () const {return m_count;}
+	Byte * data () const {return m_data;}
+
+	InstancePtr operator [] (size_t index) const {assert (index < m_count); return InstancePtr (m_data + index * m_ctype->sizeOf(), m_ctype);}
+
+private:
+	MappedFile m_file;
+	CompiledType const * m_ctype;
+	Byte * m_data;
+	size_t m_count;
+};
+
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================
+
+#endif	// __Y__DYSTRUCT_INSTANCE_FILE_H__
@@ -0,0 +1,102 @@
+#pragma once
+
+#if !defined(__Y__DYSTRUCT_KERNELS_H__)
+#define      __Y__DYSTRUCT_KERNELS_H__
+
+//======================================================================
+
+#include "DyStruct.h"
+
+#include <type_traits>
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+enum class CompareOp
+{
+	Equal,
+	NotEqual,
+	Less,
+	LessEqual,
+	Greater,
+	GreaterEqual,
+
+	_count
+};
+
+//----------------------------------------------------------------------
+
+enum class SimdLevel
+{
+	Scalar,
+	SSE2,
+	AVX2,
+
+	_count
+};
+
+//======================================================================
+
+/// Bulk kernels over plain arrays of Basic values, e.g. ColumnTable columns
+/// or the contents of an ArrayType instance. Every kernel has a scalar
+/// version; the ones for I32, U32, F32 and F64 also have SSE2 and AVX2
+/// versions, picked at runtime based on what the CPU supports.
+namespace Kernels {
+	template <Basic basic_type>
+	struct KernelTraits
+	{
+		typedef typename details::BasicTypeMap<basic_type>::type ElemType;
+		typedef typename std::conditional<std::is_floating_point<ElemType>::value, double,
+			typename std::conditional<std::is_signed<ElemType>::value, int64_t, uint64_t>::type>::type SumType;
+	};
+
+	SimdLevel DetectedSimdLevel ();
+	SimdLevel ActiveSimdLevel ();
+	void SetSimdLevel (SimdLevel level);	// Mostly for testing and benchmarking; can't go above DetectedSimdLevel()
+
+	// Integers are summed into 64 bits (wrapping around on overflow,) floats into a double.
+	// The order of additions is unspecified, so float results may differ slightly between SIMD levels.
+	template <Basic basic_type>
+	typename KernelTraits<basic_type>::SumType Sum (typename KernelTraits<basic_type>::ElemType const * data, size_t count);
+
+	// These return false (and leave out alone) when count is zero. NaNs are ignored.
+	template <Basic basic_type>
+	bool Min (typename KernelTraits<basic_type>::ElemType const * data, size_t count, typename KernelTraits<basic_type>::ElemType & out);
+	template <Basic basic_type>
+	bool Max (typename KernelTraits<basic_type>::ElemType const * data, size_t count, typename KernelTraits<basic_type>::ElemType & out);
+
+	// Number of elements for which "data[i] op value" holds.
+	template <Basic basic_type>
+	size_t Count (typename KernelTraits<basic_type>::ElemType const * data, size_t count, CompareOp op, typename KernelTraits<basic_type>::ElemType value);
+
+	// Sets bit i of the bitmap (bit i % 64 of word i / 64) iff "data[i] op value" holds.
+	// The bitmap must have BitmapWords(count) words; the unused tail bits are cleared.
+	template <Basic basic_type>
+	void Filter (typename KernelTraits<basic_type>::ElemType const * data, size_t count, CompareOp op, typename KernelTraits<basic_type>::ElemType value, uint64_t * bitmap);
+
+	// Converts count values of src_type at src into dst_type at dst (which must not overlap.)
+	// This is static_cast, except that floats to integers always saturate (NaN becomes zero,)
+	// and anything to Bool is "!= 0". With saturate, integers that don't fit the destination
+	// clamp to its range too, instead of wrapping around. There is a converter for every pair
+	// of Basics; the common widenings, narrowings and int/float pairs have SIMD versions.
+	typedef void (* ConvertFn) (void const * src, void * dst, size_t count, bool saturate);
+	ConvertFn Converter (Basic src_type, Basic dst_type);
+	inline void Convert (Basic src_type, void const * src, Basic dst_type, void * dst, size_t count, bool saturate = false) {Converter (src_type, dst_type) (src, dst, count, saturate);}
+
+	inline size_t BitmapWords (size_t count) {return (count + 63) / 64;}
+	size_t BitmapCount (uint64_t const * bitmap, size_t count);
+	void BitmapAnd (uint64_t * dst, uint64_t const * src, size_t count);
+	void BitmapOr (uint64_t * dst, uint64_t const * src, size_t count);
+	inline bool BitmapTest (uint64_t const * bitmap, size_t index) {return 0 != ((bitmap[index / 64] >> (index % 64)) & 1);}
+}
+
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================
+
+#endif	// __Y__DYSTRUCT_KERNELS_H__
@@ -0,0 +1,108 @@
+#pragma once
+
+#if !defined(__Y__DYSTRUCT_MORPH_H__)
+#define      __Y__DYSTRUCT_MORPH_H__
+
+//======================================================================
+
+#include "DyStruct.h"
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+class InstanceArray;
+
+//----------------------------------------------------------------------
+
+struct MorphOp
+{
+	enum class Kind
+	{
+		Copy,		// memcpy size bytes
+		Convert,	// count Basic values, src_basic to dst_basic, elem_size bytes apart on both sides
+		Default,	// Zero size bytes of the destination
+
+		_count
+	};
+
+	Kind kind;
+	OffsetType src_offset;	// Unused for Default
+	OffsetType dst_offset;
+	SizeType size;			// Bytes of the destination this op writes
+	Basic src_basic;		// Only for Convert
+	Basic dst_basic;
+	CountType count;
+	SizeType src_elem_size;
+	SizeType dst_elem_size;
+};
+
+//======================================================================
+
+/// A compiled recipe for "assigning" instances of one CompiledType to
+/// another that is similar, e.g. two versions of a schema. Built by
+/// TypeManager::buildMorph(). DyStruct fields are matched by name (at every
+/// level of nesting); matching fields of the same type are copied, Basic
+/// (and Enum) fields that changed type are converted, and whatever the
+/// destination has that the source doesn't (or that can't be converted) is
+/// zeroed. Array elements are matched by index. Strings are copied if both
+/// sides store them the same way (the slot holds its own chars, or points
+/// into a pool that both share), and otherwise left empty. Vectors, Sets and
+/// Maps are always left empty, since their contents belong to the source's
+/// arena.
+///
+/// The result is a flat list of ops in destination order, where adjacent
+/// copies (and adjacent zeroings) are merged into single runs, so a field
+/// that was only added or removed costs a couple of memcpys per instance.
+///
+/// Conversions are done by Kernels::Convert(), in bulk when morphing many
+/// instances at once. Float to integer conversions saturate (NaN becomes
+/// zero); integer to integer conversions wrap around, as static_cast does,
+/// unless the plan was built saturating.
+class MorphPlan
+{
+	friend class TypeManager;
+
+public:
+	typedef std::vector<MorphOp> OpContainer;
+
+public:
+	MorphPlan () : m_src {nullptr}, m_dst {nullptr}, m_ops {}, m_saturate {false} {}
+
+	CompiledType const * srcType () const {return m_src;}
+	CompiledType const * dstType () const {return m_dst;}
+	OpContainer const & ops () const {return m_ops;}
+	bool isSaturating () const {return m_saturate;}
+
+	// True if the plan is a single copy of the whole instance
+	bool isPlainCopy () const;
+
+	void apply (InstancePtr src, InstancePtr dst) const;
+
+	// Morphs count packed instances, src_stride and dst_stride bytes apart.
+	void apply (Byte const * src, SizeType src_stride, Byte * dst, SizeType dst_stride, size_t count) const;
+
+	// Resizes dst to the size of src first; false if that fails. The new
+	// instances of dst aren't constructed first, just written once.
+	bool apply (InstanceArray const & src, InstanceArray & dst) const;
+
+private:
+	void build (Type const * src, OffsetType src_offset, Type const * dst, OffsetType dst_offset);
+	void addOp (MorphOp const & op);
+
+private:
+	CompiledType const * m_src;
+	CompiledType const * m_dst;
+	OpContainer m_ops;
+	bool m_saturate;
+};
+
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================
+
+#endif	// __Y__DYSTRUCT_MORPH_H__
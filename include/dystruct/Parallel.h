@@ -0,0 +1,160 @@
+#pragma once
+
+#if !defined(__Y__DYSTRUCT_PARALLEL_H__)
+#define      __Y__DYSTRUCT_PARALLEL_H__
+
+//======================================================================
+
+#include "DyStruct.h"
+#include "InstanceArray.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+namespace details {
+	// How many rows go in each chunk of a parallel pass over count instances,
+	// stride bytes apart, on threads threads. Always a multiple of the rows
+	// that make up a whole number of cache lines, so that chunks of an aligned
+	// array start on line boundaries and no two chunks write the same line.
+	size_t RowsPerChunk (size_t count, SizeType stride, unsigned threads);
+}
+
+//======================================================================
+
+/// A fixed set of worker threads that run batches of tasks (numbered 0 to
+/// count - 1) and return when they're all done; the calling thread works on
+/// the batch too. Each thread has its own deque of task ranges: it splits
+/// the range it's working on in half, pushes the back half, and carries on
+/// with the front, so it mostly works on neighbouring tasks (oldest last),
+/// and idle threads steal the biggest ranges off the other end of someone
+/// else's deque. Tasks can start batches of their own.
+class ThreadPool
+{
+public:
+	// One fewer than the hardware threads, since the caller works as well.
+	static unsigned DefaultWorkerCount ();
+
+	// Shared by everyone who doesn't bring their own; started on first use.
+	static ThreadPool & Default ();
+
+public:
+	explicit ThreadPool (unsigned worker_count = DefaultWorkerCount());
+	~ThreadPool ();
+
+	ThreadPool (ThreadPool const &) = delete;
+	ThreadPool & operator = (ThreadPool const &) = delete;
+
+	unsigned workerCount () const {return unsigned(m_workers.size());}
+	unsigned threadCount () const {return workerCount() + 1;}	// Including the caller
+
+	// Calls task (index) for every index in [0, count), from any of the
+	// threads, and waits for all of them.
+	template <typename F>
+	void run (size_t count, F && task)
+	{
+		typedef typename std::remove_reference<F>::type Task;
+		runTasks (count, [] (void * context, size_t index) {(*static_cast<Task *>(context)) (index);},
+			const_cast<void *>(static_cast<void const *>(&task)));
+	}
+
+private:
+	typedef void (* TaskFunc) (void * context, size_t index);
+
+	struct Job
+	{
+		TaskFunc func;
+		void * context;
+		std::atomic<size_t> remaining;
+	};
+
+	struct Range
+	{
+		Job * job;
+		size_t first;
+		size_t last;
+	};
+
+	struct Queue;
+
+	void runTasks (size_t count, TaskFunc func, void * context);
+	void workerMain (unsigned index);
+	unsigned homeQueue () const;		// The calling thread's deque
+	void push (unsigned queue, Range range);
+	bool popOrSteal (unsigned home, Range & out);
+	void execute (unsigned home, Range range);
+
+private:
+	std::vector<std::unique_ptr<Queue>> m_queues;	// One per worker, then one for everyone else
+	std::vector<std::thread> m_workers;
+	std::atomic<size_t> m_queued;		// Ranges in all the deques
+	std::atomic<unsigned> m_sleeping;
+	std::mutex m_sleep_lock;
+	std::condition_variable m_wake;
+	bool m_stop;
+};
+
+//======================================================================
+
+// Calls f (inst, row) for every instance of array, spread over the pool.
+// f runs concurrently, so it may only write to inst (and nothing shared),
+// and must not grow Vector fields, since the array's arena isn't
+// thread-safe.
+template <typename F>
+void ParallelForEach (InstanceArray & array, F && f, ThreadPool & pool = ThreadPool::Default())
+{
+	auto count = array.size();
+	if (0 == count)
+		return;
+
+	auto rows = details::RowsPerChunk (count, array.stride(), pool.threadCount());
+	pool.run ((count + rows - 1) / rows, [&] (size_t chunk) {
+		auto last = std::min (count, (chunk + 1) * rows);
+		for (auto row = chunk * rows; row < last; ++row)
+			f (array[row], row);
+	});
+}
+
+//----------------------------------------------------------------------
+
+// Calls f (src_inst, dst_inst, row) for every row, after resizing dst to the
+// size of src; false if that failed. Chunks follow dst's stride, since that's
+// what's written. The same rules as ParallelForEach() apply to f.
+template <typename F>
+bool ParallelTransform (InstanceArray const & src, InstanceArray & dst, F && f, ThreadPool & pool = ThreadPool::Default())
+{
+	assert (&src != &dst);
+	if (!dst.resize (src.size()))
+		return false;
+
+	auto count = src.size();
+	if (0 == count)
+		return true;
+
+	auto rows = details::RowsPerChunk (count, dst.stride(), pool.threadCount());
+	pool.run ((count + rows - 1) / rows, [&] (size_t chunk) {
+		auto last = std::min (count, (chunk + 1) * rows);
+		for (auto row = chunk * rows; row < last; ++row)
+			f (src[row], dst[row], row);
+	});
+	return true;
+}
+
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================
+
+#endif	// __Y__DYSTRUCT_PARALLEL_H__
@@ -0,0 +1,57 @@
+#pragma once
+
+#if !defined(__Y__DYSTRUCT_SCHEMA_H__)
+#define      __Y__DYSTRUCT_SCHEMA_H__
+
+//======================================================================
+
+#include "DyStruct.h"
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+/// The result of loading a schema: the compiled types, or where it went wrong.
+struct SchemaResult
+{
+	std::vector<CompiledType *> types;	// Every named type, in the order they were declared
+	std::string error;					// Empty on success
+	unsigned error_line = 0;			// 1-based
+	unsigned error_column = 0;			// 1-based
+};
+
+//----------------------------------------------------------------------
+
+/// Loads a text schema into tm in a single pass over the text. The format:
+///
+///     // Line comments, and /* block comments */
+///     enum Color { Red, Green = 5, Blue }		// Values follow the previous one by default
+///     struct Point { x : F32; y : F32; }
+///     struct Shape {
+///         color : Color;
+///         corners : Point[4];
+///         grid : U8[3][2];					// As in C: 3 arrays of 2
+///         extra : struct { id : U64; tag : enum { A, B }; };
+///     }
+///
+/// Field types are Basic names (I8, U8, ..., F64, Bool, Byte, Char, WChar),
+/// types declared earlier in the same schema, or types that tm has already
+/// compiled. Declarations must come before their uses. Once the whole text
+/// has parsed, every named struct and enum is compiled under its name, all
+/// together; if anything fails, nothing is compiled (but Types created on the
+/// way stay with tm, as they always do.)
+bool LoadSchema (TypeManager & tm, char const * text, size_t length, SchemaResult & result, CompileOptions const & options = CompileOptions{});
+inline bool LoadSchema (TypeManager & tm, std::string const & text, SchemaResult & result, CompileOptions const & options = CompileOptions{})
+{
+	return LoadSchema (tm, text.data(), text.size(), result, options);
+}
+
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================
+
+#endif	// __Y__DYSTRUCT_SCHEMA_H__
@@ -0,0 +1,255 @@
+#pragma once
+
+#if !defined(__Y__DYSTRUCT_STATIC_STRUCT_H__)
+#define      __Y__DYSTRUCT_STATIC_STRUCT_H__
+
+//======================================================================
+
+#include "DyStruct.h"
+
+#include <cstddef>
+#include <type_traits>
+
+//======================================================================
+// Describing existing C++ structs, so that their instances can be used
+// through InstancePtrs (introspection, hashing, morphing, saving, ...)
+// while code that knows the struct at build time keeps plain member speed.
+// Bind a struct once, at global scope, listing every field in declaration
+// order:
+//
+//     struct Particle {float pos [3]; uint32_t id; Vec3 vel;};
+//
+//     DYSTRUCT_STATIC_BEGIN (Particle)
+//         DYSTRUCT_STATIC_FIELD (pos)
+//         DYSTRUCT_STATIC_FIELD (id)
+//         DYSTRUCT_STATIC_FIELD (vel)		// Vec3 must be bound too
+//     DYSTRUCT_STATIC_END ()
+//
+// then TypeManager::compileStatic<Particle>("Particle") builds and compiles
+// the matching DyStructType, and checks that every field landed at its
+// offsetof(). Fields can be arithmetic types (and enums, as their underlying
+// type), arrays of those, and other bound structs. Leaving a field out, or
+// listing them out of order, makes the check fail. Wrap existing structs with
+// CompiledType::wrapInstance().
+//
+// DYSTRUCT_STATIC_ACCESSOR (Particle, id) is an accessor whose offset is a
+// compile-time constant, so it compiles to `mov eax, [rdx + 12]`, exactly
+// like p->id; the offset-in-a-register form of Accessor goes away for these.
+//======================================================================
+
+#define DYSTRUCT_STATIC_BEGIN(S)																\
+	namespace DyStruct {																		\
+	template <> struct StaticStruct<S>															\
+	{																							\
+		typedef S Struct;																		\
+		static_assert (std::is_standard_layout<S>::value, "Only standard-layout structs have offsetof()");	\
+		static bool Describe (StaticBinder & binder)											\
+		{																						\
+			return true
+
+#define DYSTRUCT_STATIC_FIELD(f)																\
+			&& binder.field<decltype(Struct::f)> (#f, offsetof(Struct, f))
+
+#define DYSTRUCT_STATIC_END()																	\
+			;																					\
+		}																						\
+	};																							\
+	}
+
+#define DYSTRUCT_STATIC_ACCESSOR(S, f)															\
+	::DyStruct::StaticAccessor<decltype(S::f), offsetof(S, f)> {}
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+// Specialized (by DYSTRUCT_STATIC_BEGIN) for every bound struct.
+template <typename S> struct StaticStruct;
+
+class StaticBinder;
+
+//----------------------------------------------------------------------
+
+namespace details {
+	// The Basic for a C++ arithmetic type, by what it is rather than what it's
+	// called (so long and long long both work); _count if there isn't one.
+	template <typename T>
+	constexpr Basic StaticBasic ()
+	{
+		return std::is_same<T, bool>::value ? Basic::Bool
+			: std::is_same<T, char>::value ? Basic::Char
+			: std::is_same<T, wchar_t>::value ? Basic::WChar
+			: std::is_same<T, float>::value ? Basic::F32
+			: std::is_same<T, double>::value ? Basic::F64
+			: !std::is_integral<T>::value ? Basic::_count
+			: 1 == sizeof(T) ? (std::is_signed<T>::value ? Basic::I8 : Basic::U8)
+			: 2 == sizeof(T) ? (std::is_signed<T>::value ? Basic::I16 : Basic::U16)
+			: 4 == sizeof(T) ? (std::is_signed<T>::value ? Basic::I32 : Basic::U32)
+			: 8 == sizeof(T) ? (std::is_signed<T>::value ? Basic::I64 : Basic::U64)
+			: Basic::_count;
+	}
+
+	template <typename T, bool = std::is_enum<T>::value> struct StaticUnderlying {typedef T type;};
+	template <typename T> struct StaticUnderlying<T, true> {typedef typename std::underlying_type<T>::type type;};
+
+	// Makes the Type for a field of C++ type T, or tells whether a Type is
+	// one that T can stand for (same Basic, element count, fields...)
+	template <typename T, bool = std::is_arithmetic<T>::value || std::is_enum<T>::value>
+	struct StaticType
+	{
+		static Type * Make (TypeManager & tm)
+		{
+			static_assert (Basic::_count != StaticBasic<typename StaticUnderlying<T>::type>(), "No Basic for this type");
+			return tm.createType<Family::Basic> (StaticBasic<typename StaticUnderlying<T>::type>());
+		}
+
+		static bool Matches (Type const * type)
+		{
+			auto basic = StaticBasic<typename StaticUnderlying<T>::type>();
+			return (type->isBasic() && type->asBasic()->getType() == basic)
+				|| (type->isEnum() && type->asEnum()->getUnderlyingType() == basic);
+		}
+	};
+
+	template <typename T, size_t N>
+	struct StaticType<T [N], false>
+	{
+		static Type * Make (TypeManager & tm)
+		{
+			auto elem = StaticType<T>::Make (tm);
+			return elem ? tm.createType<Family::Array> (CountType(N), elem) : nullptr;
+		}
+
+		static bool Matches (Type const * type)
+		{
+			return type->isArray() && N == type->getElemCount() && StaticType<T>::Matches (type->asArray()->getElemType());
+		}
+	};
+
+	template <typename S>
+	struct StaticType<S, false>
+	{
+		static inline Type * Make (TypeManager & tm);
+		static inline bool Matches (Type const * type);
+	};
+}
+
+//======================================================================
+
+/// What StaticStruct<S>::Describe() reports its fields to. It either builds
+/// a DyStructType out of them, or checks them against an existing one.
+class StaticBinder
+{
+public:
+	// Adds fields to type.
+	StaticBinder (TypeManager & tm, DyStructType * type) : m_tm {&tm}, m_build {type}, m_check {nullptr} {}
+
+	// Only checks that type has them.
+	explicit StaticBinder (DyStructType const * type) : m_tm {nullptr}, m_build {nullptr}, m_check {type} {}
+
+	template <typename F>
+	bool field (char const * name, size_t offset)
+	{
+		DyStructType::Field const * f = nullptr;
+		if (m_build)
+		{
+			auto type = details::StaticType<F>::Make (*m_tm);
+			if (nullptr == type || !m_build->addField ({type, name}))
+				return false;
+			f = m_build->findField (name);
+		}
+		else
+			f = m_check->findField (name);
+
+		// A field left out, or listed out of order, shows up as an offset mismatch
+		return nullptr != f && f->offset == offset && f->type->getSizeOf() == sizeof(F) && details::StaticType<F>::Matches (f->type);
+	}
+
+private:
+	TypeManager * m_tm;
+	DyStructType * m_build;
+	DyStructType const * m_check;
+};
+
+//----------------------------------------------------------------------
+
+// True if ctype has every field of S (by name) at the same offset and size,
+// and of the same kind (e.g. an F32 won't do for an int32_t), and is the same
+// size; e.g. for a type that came out of loadRegistry().
+template <typename S>
+bool MatchesStatic (CompiledType const & ctype)
+{
+	if (!ctype.rawType()->isDyStruct() || ctype.sizeOf() != sizeof(S))
+		return false;
+
+	StaticBinder binder {ctype.rawType()->asDyStruct()};
+	return StaticStruct<S>::Describe (binder);
+}
+
+//======================================================================
+
+/// An accessor whose offset is part of its type; get one with
+/// DYSTRUCT_STATIC_ACCESSOR. F is the field's C++ type.
+template <typename F, OffsetType offset>
+class StaticAccessor
+{
+public:
+	F & operator () (InstancePtr inst) {return *reinterpret_cast<F *>(inst.data() + offset);}
+	F const & operator () (InstancePtr inst) const {return *reinterpret_cast<F const *>(inst.data() + offset);}
+
+	static constexpr OffsetType Offset = offset;
+};
+
+//======================================================================
+
+template <typename S>
+inline Type * details::StaticType<S, false>::Make (TypeManager & tm)
+{
+	auto ret = tm.createType<Family::DyStruct> ();
+	StaticBinder binder {tm, ret};
+	if (!StaticStruct<S>::Describe (binder) || ret->getSizeOf() != sizeof(S) || ret->getAlignment() != alignof(S))
+	{
+		tm.destroyType (ret);
+		return nullptr;
+	}
+	return ret;
+}
+
+//----------------------------------------------------------------------
+
+template <typename S>
+inline bool details::StaticType<S, false>::Matches (Type const * type)
+{
+	if (!type->isDyStruct() || type->getSizeOf() != sizeof(S))
+		return false;
+
+	StaticBinder binder {type->asDyStruct()};
+	return StaticStruct<S>::Describe (binder);
+}
+
+//----------------------------------------------------------------------
+
+template <typename S>
+CompiledType * TypeManager::compileStatic (Name const & name, CompileOptions options)
+{
+	if (nullptr != getCompiledType (name))
+		return nullptr;
+
+	auto type = details::StaticType<S>::Make (*this);
+	assert (type);		// The binding doesn't describe S
+	if (nullptr == type)
+		return nullptr;
+
+	options.reorder_fields = false;		// S has the layout it has
+	return compile (type, name, options);
+}
+
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================
+
+#endif	// __Y__DYSTRUCT_STATIC_STRUCT_H__
@@ -0,0 +1,116 @@
+#pragma once
+
+#if !defined(__Y__DYSTRUCT_STRING_H__)
+#define      __Y__DYSTRUCT_STRING_H__
+
+//======================================================================
+
+#include "DyStruct.h"
+
+#include <atomic>
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+/// Backing store for StringTypes; every TypeManager has one. Stored chars
+/// live in big chunks and are never freed (or moved) until the pool is.
+/// Interning hands every distinct string a dense 32-bit id, with 0 being the
+/// empty string. Storing and interning take a lock; lookup() doesn't, as
+/// long as the id reached this thread the usual way (i.e. through memory
+/// that was properly handed over.)
+class StringPool
+{
+public:
+	StringPool ();
+	~StringPool ();
+
+	StringPool (StringPool const &) = delete;
+	StringPool & operator = (StringPool const &) = delete;
+
+	// Copies str into the pool; nullptr if out of memory.
+	char const * store (char const * str, size_t length);
+
+	// The id of str, adding it if it's new. Returns 0 (the empty string) for
+	// empty strings, and if the pool is out of ids or memory.
+	uint32_t intern (char const * str, size_t length);
+	uint32_t intern (StringRef str) {return intern (str.data, str.size);}
+
+	// The id must have come from intern().
+	StringRef lookup (uint32_t id) const
+	{
+		assert (id < m_count.load (std::memory_order_relaxed));
+		return m_blocks[id >> gc_BlockBits].load (std::memory_order_acquire)[id & (gc_BlockSize - 1)];
+	}
+
+	size_t internedCount () const {return m_count.load (std::memory_order_relaxed);}	// Including the empty string
+	size_t bytesStored () const;
+
+private:
+	static unsigned const gc_BlockBits = 16;
+	static size_t const gc_BlockSize = size_t(1) << gc_BlockBits;
+	static size_t const gc_MaxBlocks = 1024;
+	static size_t const gc_ChunkSize = 64 * 1024;
+
+	char * allocate (size_t length);		// With m_lock held
+	bool growTable ();
+
+private:
+	mutable std::mutex m_lock;
+
+	std::vector<char *> m_chunks;
+	char * m_bump;
+	char * m_bump_end;
+	size_t m_bytes;
+
+	std::atomic<StringRef *> m_blocks [gc_MaxBlocks];	// Interned strings by id, in blocks that never move
+	std::atomic<uint32_t> m_count;
+	std::vector<uint64_t> m_hashes;		// By id
+	std::vector<uint32_t> m_table;		// Open addressing over ids; 0 is an empty slot
+};
+
+//======================================================================
+
+/// Reads and writes one String field of instances; get one from
+/// CompiledType::accessorString().
+class StringAccessor
+{
+public:
+	StringAccessor (OffsetType offset, StringType const * type)
+		: m_offset {offset}
+		, m_type {type}
+	{}
+
+	StringRef get (InstancePtr inst) const {return m_type->read (inst.data() + m_offset);}
+	std::string str (InstancePtr inst) const {return get(inst).str();}
+
+	bool set (InstancePtr inst, char const * str, size_t length) const {return m_type->write (inst.data() + m_offset, str, length);}
+	bool set (InstancePtr inst, StringRef str) const {return set (inst, str.data, str.size);}
+
+	// Only for interned strings: the id, which is equal for equal strings.
+	uint32_t id (InstancePtr inst) const
+	{
+		assert (m_type->isInterned());
+		uint32_t ret;
+		std::memcpy (&ret, inst.data() + m_offset, sizeof(ret));
+		return ret;
+	}
+
+	OffsetType offset () const {return m_offset;}
+	StringType const * type () const {return m_type;}
+	bool isValid () const {return nullptr != m_type;}	// False if it came from a path that didn't resolve
+
+private:
+	OffsetType m_offset;
+	StringType const * m_type;
+};
+
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================
+
+#endif	// __Y__DYSTRUCT_STRING_H__
@@ -0,0 +1,109 @@
+#pragma once
+
+#if !defined(__Y__DYSTRUCT_VECTOR_H__)
+#define      __Y__DYSTRUCT_VECTOR_H__
+
+//======================================================================
+
+#include "DyStruct.h"
+#include "Arena.h"
+
+#include <algorithm>
+#include <cstring>
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+/// A pointer and a count; the elements are contiguous and aligned, so this
+/// is what to hand to anything that wants to chew through them in bulk.
+template <typename T>
+class Span
+{
+public:
+	Span () : m_data {nullptr}, m_size {0} {}
+	Span (T * data, size_t size) : m_data {data}, m_size {size} {}
+
+	T * data () const {return m_data;}
+	size_t size () const {return m_size;}
+	bool empty () const {return 0 == m_size;}
+
+	T & operator [] (size_t index) const {assert (index < m_size); return m_data[index];}
+	T * begin () const {return m_data;}
+	T * end () const {return m_data + m_size;}
+
+private:
+	T * m_data;
+	size_t m_size;
+};
+
+//======================================================================
+
+/// For a Vector field whose elements are Basic (or Enums whose underlying
+/// type is basic_type); get one from CompiledType::accessorVector(). The
+/// arena passed to the growing calls should be the one that owns the
+/// instance's other vectors, e.g. InstanceArray::arena().
+template <Basic basic_type>
+class VectorAccessor
+{
+	typedef typename details::BasicTypeMap<basic_type>::type MyT;
+
+public:
+	VectorAccessor (OffsetType offset, VectorType const * type)
+		: m_offset {offset}
+		, m_type {type}
+	{}
+
+	size_t size (InstancePtr inst) const {return header(inst)->size;}
+	size_t capacity (InstancePtr inst) const {return header(inst)->capacity;}
+	bool empty (InstancePtr inst) const {return 0 == header(inst)->size;}
+
+	Span<MyT> span (InstancePtr inst) const {auto h = header(inst); return Span<MyT> {reinterpret_cast<MyT *>(h->data), h->size};}
+	MyT & operator () (InstancePtr inst, size_t index) const {assert (index < size(inst)); return reinterpret_cast<MyT *>(header(inst)->data)[index];}
+
+	bool reserve (InstancePtr inst, size_t capacity, Arena & arena) const {return m_type->reserve (inst.data() + m_offset, capacity, arena);}
+	bool resize (InstancePtr inst, size_t count, Arena & arena) const {return m_type->resize (inst.data() + m_offset, count, arena);}	// New elements are zero
+	void clear (InstancePtr inst) const {header(inst)->size = 0;}
+
+	bool push (InstancePtr inst, MyT value, Arena & arena) const
+	{
+		auto h = header (inst);
+		if (h->size == h->capacity && !m_type->reserve (inst.data() + m_offset, std::max<size_t> (4, 2 * size_t(h->capacity)), arena))
+			return false;
+		reinterpret_cast<MyT *>(h->data)[h->size++] = value;
+		return true;
+	}
+
+	// Replaces the contents with count values from values.
+	bool assign (InstancePtr inst, MyT const * values, size_t count, Arena & arena) const
+	{
+		if (!m_type->reserve (inst.data() + m_offset, count, arena))
+			return false;
+		auto h = header (inst);
+		if (count > 0)
+			std::memcpy (h->data, values, count * sizeof(MyT));
+		h->size = uint32_t(count);
+		return true;
+	}
+
+	OffsetType offset () const {return m_offset;}
+	VectorType const * type () const {return m_type;}
+	bool isValid () const {return nullptr != m_type;}	// False if it came from a path that didn't resolve
+
+private:
+	VectorType::Header * header (InstancePtr inst) const {return VectorType::HeaderOf (inst.data() + m_offset);}
+
+private:
+	OffsetType m_offset;
+	VectorType const * m_type;
+};
+
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================
+
+#endif	// __Y__DYSTRUCT_VECTOR_H__
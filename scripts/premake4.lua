@@ -33,6 +33,9 @@ solution ("DyStruct" .. "_" .. _ACTION)
 
 	configuration ({"macosx", "gmake"})
 		buildoptions ({"--stdlib=libc++"})
+
+	configuration ({"linux", "gmake"})
+		links ({"pthread"})
 		
 ------------------------------------------------------------------------
 		
@@ -70,27 +73,64 @@ solution ("DyStruct" .. "_" .. _ACTION)
 -- Projects --
 ------------------------------------------------------------------------
 
+	-- The library itself, which every project builds in
+	local dystruct_files = {
+		"../include/dystruct/Arena.h",
+		"../include/dystruct/ColumnTable.h",
+		"../include/dystruct/DyStruct.h",
+		"../include/dystruct/DyStructInline.h",
+		"../include/dystruct/HashTable.h",
+		"../include/dystruct/InstanceArray.h",
+		"../include/dystruct/InstanceFile.h",
+		"../include/dystruct/Kernels.h",
+		"../include/dystruct/Morph.h",
+		"../include/dystruct/Parallel.h",
+		"../include/dystruct/Schema.h",
+		"../include/dystruct/StaticStruct.h",
+		"../include/dystruct/String.h",
+		"../include/dystruct/Vector.h",
+
+		"../src/dystruct/Arena.cpp",
+		"../src/dystruct/ColumnTable.cpp",
+		"../src/dystruct/DyStruct.cpp",
+		"../src/dystruct/HashTable.cpp",
+		"../src/dystruct/InstanceArray.cpp",
+		"../src/dystruct/InstanceFile.cpp",
+		"../src/dystruct/InstancePool.cpp",
+		"../src/dystruct/Kernels.cpp",
+		"../src/dystruct/Morph.cpp",
+		"../src/dystruct/Parallel.cpp",
+		"../src/dystruct/Registry.cpp",
+		"../src/dystruct/Schema.cpp",
+		"../src/dystruct/String.cpp",
+		"../src/dystruct/Vector.cpp",
+	}
+
 	project ("dystruct_test")
 		uuid ("312EC9D8-4541-4B9F-934F-250D94F24F7E")
 		language ("C++")
 		kind ("ConsoleApp")
 		location ("../build/" .. _ACTION .. "/")
 		
-		files ({
-			"../include/dystruct/DyStruct.h",
-			"../include/dystruct/DyStructInline.h",
+		files (dystruct_files)
+		files ({"../src/DyStructTestMain.cpp"})
+
+------------------------------------------------------------------------
 
-			"../src/dystruct/DyStruct.cpp",
-			
-			"../src/DyStructTestMain.cpp"
-		})
+	project ("DyStructBench")
+		uuid ("7CDB0DA4-AE8E-4596-8713-AECA868540A1")
+		language ("C++")
+		kind ("ConsoleApp")
+		location ("../build/" .. _ACTION .. "/")
+		
+		files (dystruct_files)
+		files ({"../src/DyStructBenchMain.cpp"})
 
 ------------------------------------------------------------------------
 -- Reserve UUIDs --
 ------------------------------------------------------------------------
 		
 -- Some more UUIDs to use: (delete each one that is used)
---		uuid ("7CDB0DA4-AE8E-4596-8713-AECA868540A1")
 --		uuid ("29DB298C-F09A-4EE4-B74C-5FCC5DBB65AA")
 --		uuid ("0039F44F-62B8-4EC1-8A28-DF3A46FC2027")
 --		uuid ("112A2B2E-E55A-4FB2-B6BF-F799D1A17E5A")
@@ -0,0 +1,415 @@
+
+#include <dystruct/DyStruct.h>
+#include <dystruct/InstanceArray.h>
+#include <dystruct/StaticStruct.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+//======================================================================
+// Micro-benchmarks of DyStruct against plain C++ structs. Prints one CSV
+// line per benchmark, after a header line:
+//
+//     benchmark,param,reps,ops,ns_per_op,checksum
+//
+// ns_per_op is the median over reps timed runs (after one untimed warm-up
+// run) of the run's time divided by its ops. The inputs are generated from
+// fixed seeds, so the checksums are the same from run to run and version to
+// version; a different checksum means the benchmark no longer does the same
+// work (and the native and DyStruct variants of one benchmark agree.)
+//
+// Usage: DyStructBench [filter [reps]]
+// where filter picks the benchmarks whose name contains it ("" is all.)
+//======================================================================
+
+namespace Dy = DyStruct;
+using DyF = DyStruct::Family;
+using DyB = DyStruct::Basic;
+
+//----------------------------------------------------------------------
+
+struct Row
+{
+	uint64_t a;
+	uint64_t b;
+	uint64_t c;
+	uint32_t d;
+	float f;
+};
+
+DYSTRUCT_STATIC_BEGIN (Row)
+	DYSTRUCT_STATIC_FIELD (a)
+	DYSTRUCT_STATIC_FIELD (b)
+	DYSTRUCT_STATIC_FIELD (c)
+	DYSTRUCT_STATIC_FIELD (d)
+	DYSTRUCT_STATIC_FIELD (f)
+DYSTRUCT_STATIC_END ()
+
+//======================================================================
+
+	namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+size_t const gc_RowCount = size_t(1) << 16;		// 2 MiB of Rows; fits in L2/L3 on most machines
+size_t const gc_BatchSize = 1024;
+std::string g_filter;
+int g_reps = 15;
+
+//----------------------------------------------------------------------
+
+// xorshift64*; the same numbers everywhere, unlike <random>'s distributions.
+struct Random
+{
+	uint64_t state;
+
+	explicit Random (uint64_t seed) : state {seed} {}
+
+	uint64_t next ()
+	{
+		state ^= state >> 12;
+		state ^= state << 25;
+		state ^= state >> 27;
+		return state * 0x2545F4914F6CDD1DULL;
+	}
+};
+
+//----------------------------------------------------------------------
+
+// body () does ops operations and returns a checksum of what it did.
+template <typename F>
+void Bench (char const * name, std::string const & param, size_t ops, F && body)
+{
+	if (std::string (name).find (g_filter) == std::string::npos)
+		return;
+
+	uint64_t checksum = body ();
+
+	std::vector<double> ns_per_op;
+	for (int r = 0; r < g_reps; ++r)
+	{
+		auto t0 = Clock::now ();
+		auto c = body ();
+		auto t1 = Clock::now ();
+		if (c != checksum)		// Not reproducible; say so rather than print a number
+			checksum = 0;
+		ns_per_op.push_back (std::chrono::duration<double, std::nano>(t1 - t0).count() / double(ops));
+	}
+
+	std::sort (ns_per_op.begin(), ns_per_op.end());
+	std::printf ("%s,%s,%d,%zu,%.3f,%llu\n", name, param.c_str(), g_reps, ops, ns_per_op[ns_per_op.size() / 2], (unsigned long long)checksum);
+	std::fflush (stdout);
+}
+
+//----------------------------------------------------------------------
+
+void FillRow (Row & row, Random & rnd)
+{
+	row.a = rnd.next() >> 8;
+	row.b = rnd.next() >> 8;
+	row.c = 0;
+	row.d = uint32_t(rnd.next());
+	row.f = float(rnd.next() % 1000) * 0.5f;
+}
+
+//----------------------------------------------------------------------
+
+// The same fields as Row, described by hand.
+Dy::DyStructType * MakeRowType (Dy::TypeManager & tm)
+{
+	auto tU64 = tm.createType<DyF::Basic> (DyB::U64);
+	auto ret = tm.createType<DyF::DyStruct> ();
+	ret->addField ({tU64, "a"});
+	ret->addField ({tU64, "b"});
+	ret->addField ({tU64, "c"});
+	ret->addField ({tm.createType<DyF::Basic> (DyB::U32), "d"});
+	ret->addField ({tm.createType<DyF::Basic> (DyB::F32), "f"});
+	return ret;
+}
+
+//----------------------------------------------------------------------
+
+// count fields of mixed sizes, named f0, f1, ...
+Dy::DyStructType * MakeWideType (Dy::TypeManager & tm, unsigned count)
+{
+	static DyB const basics [] = {DyB::U64, DyB::U8, DyB::F32, DyB::U16, DyB::I32, DyB::F64};
+
+	auto ret = tm.createType<DyF::DyStruct> ();
+	for (unsigned i = 0; i < count; ++i)
+		ret->addField ({tm.createType<DyF::Basic> (basics[i % (sizeof(basics) / sizeof(basics[0]))]), "f" + std::to_string (i)});
+	return ret;
+}
+
+//======================================================================
+
+void BenchFields (Dy::TypeManager & tm)
+{
+	std::vector<Row> native (gc_RowCount);
+	Dy::InstanceArray dynamic {tm.compile (MakeRowType (tm), "Row.dynamic")};
+	Dy::InstanceArray bound {tm.compileStatic<Row> ("Row.static")};
+	dynamic.resizeZeroed (gc_RowCount);
+	bound.resizeZeroed (gc_RowCount);
+
+	Random rnd {0x0123456789ABCDEFULL};
+	for (size_t i = 0; i < gc_RowCount; ++i)
+	{
+		FillRow (native[i], rnd);
+		std::memcpy (dynamic[i].data(), &native[i], sizeof(Row));
+		std::memcpy (bound[i].data(), &native[i], sizeof(Row));
+	}
+
+	auto & ct = dynamic.type();
+	auto a = ct.accessorField<DyB::U64> ("a");
+	auto b = ct.accessorField<DyB::U64> ("b");
+	auto c = ct.accessorField<DyB::U64> ("c");
+	auto d = ct.accessorField<DyB::U32> ("d");
+	auto f = ct.accessorField<DyB::F32> ("f");
+	auto sa = DYSTRUCT_STATIC_ACCESSOR (Row, a);
+	auto sb = DYSTRUCT_STATIC_ACCESSOR (Row, b);
+	auto sc = DYSTRUCT_STATIC_ACCESSOR (Row, c);
+	auto sd = DYSTRUCT_STATIC_ACCESSOR (Row, d);
+	auto sf = DYSTRUCT_STATIC_ACCESSOR (Row, f);
+
+	// Reads: sum two fields of every row
+	Bench ("field_read.native", "", gc_RowCount, [&] {
+		uint64_t sum = 0;
+		for (auto const & row : native)
+			sum += row.a ^ row.d;
+		return sum;
+	});
+	Bench ("field_read.accessor", "", gc_RowCount, [&] {
+		uint64_t sum = 0;
+		for (auto inst : dynamic)
+			sum += a(inst) ^ d(inst);
+		return sum;
+	});
+	Bench ("field_read.static_accessor", "", gc_RowCount, [&] {
+		uint64_t sum = 0;
+		for (auto inst : bound)
+			sum += sa(inst) ^ sd(inst);
+		return sum;
+	});
+
+	// Read-modify-write: c is computed from the others, so every run writes the same values
+	Bench ("field_rw.native", "", gc_RowCount, [&] {
+		uint64_t sum = 0;
+		for (auto & row : native)
+		{
+			row.c = row.a * 3 + row.b + uint64_t(row.f) + row.d;
+			sum += row.c;
+		}
+		return sum;
+	});
+	Bench ("field_rw.accessor", "", gc_RowCount, [&] {
+		uint64_t sum = 0;
+		for (auto inst : dynamic)
+		{
+			c(inst) = a(inst) * 3 + b(inst) + uint64_t(f(inst)) + d(inst);
+			sum += c(inst);
+		}
+		return sum;
+	});
+	Bench ("field_rw.static_accessor", "", gc_RowCount, [&] {
+		uint64_t sum = 0;
+		for (auto inst : bound)
+		{
+			sc(inst) = sa(inst) * 3 + sb(inst) + uint64_t(sf(inst)) + sd(inst);
+			sum += sc(inst);
+		}
+		return sum;
+	});
+}
+
+//----------------------------------------------------------------------
+
+void BenchInstances (Dy::TypeManager & tm)
+{
+	auto type = MakeRowType (tm);
+	Dy::CompileOptions cached;
+	cached.pool_thread_cache = true;
+
+	Dy::CompiledType const * ctypes [] = {tm.compile (type, "Row.pool"), tm.compile (type, "Row.pool_thread_cache", cached)};
+	char const * params [] = {"pool", "pool_thread_cache"};
+
+	for (int k = 0; k < 2; ++k)
+	{
+		auto ct = ctypes[k];
+		std::vector<Dy::InstancePtr> batch;
+		batch.reserve (gc_BatchSize);
+
+		// A batch at a time, so the pool has to hand out (and take back) many slots
+		Bench ("instance.create_destroy", params[k], 64 * gc_BatchSize, [&] {
+			uint64_t created = 0;
+			for (int round = 0; round < 64; ++round)
+			{
+				for (size_t i = 0; i < gc_BatchSize; ++i)
+					batch.push_back (ct->createInstance ());
+				for (auto & inst : batch)
+				{
+					created += inst.isNull() ? 0 : 1;
+					ct->destroyInstance (inst);
+				}
+				batch.clear ();
+			}
+			return created;
+		});
+	}
+
+	Bench ("instance.new_delete_native", "", 64 * gc_BatchSize, [&] {
+		std::vector<Row *> rows;
+		rows.reserve (gc_BatchSize);
+		uint64_t created = 0;
+		for (int round = 0; round < 64; ++round)
+		{
+			for (size_t i = 0; i < gc_BatchSize; ++i)
+				rows.push_back (new Row ());
+			for (auto row : rows)
+			{
+				created += (nullptr != row) ? 1 : 0;
+				delete row;
+			}
+			rows.clear ();
+		}
+		return created;
+	});
+}
+
+//----------------------------------------------------------------------
+
+void BenchAccessors (Dy::TypeManager & tm)
+{
+	for (unsigned fields : {8U, 64U})
+	{
+		auto ct = tm.compile (MakeWideType (tm, fields), "Wide.accessor." + std::to_string (fields));
+		std::vector<std::string> names;
+		for (unsigned i = 0; i < fields; i += 6)	// The U64 fields
+			names.push_back ("f" + std::to_string (i));
+		std::vector<Dy::FieldIndex::HashType> hashes;
+		for (auto const & n : names)
+			hashes.push_back (Dy::FieldIndex::Hash (n));
+
+		// Each U64 field holds its own number, to have something to read through the accessors
+		auto inst = ct->createInstanceZeroed ();
+		for (unsigned i = 0; i < fields; i += 6)
+			ct->accessorField<DyB::U64> ("f" + std::to_string (i)) (inst) = i;
+
+		size_t const ops = 1 << 16;
+		auto param = "fields=" + std::to_string (fields);
+
+		Bench ("accessor.by_name", param, ops, [&] {
+			uint64_t sum = 0;
+			for (size_t i = 0; i < ops; ++i)
+				sum += ct->accessorField<DyB::U64> (names[i % names.size()]) (inst);
+			return sum;
+		});
+		Bench ("accessor.by_hash", param, ops, [&] {
+			uint64_t sum = 0;
+			for (size_t i = 0; i < ops; ++i)
+				sum += ct->accessorField<DyB::U64> (names[i % names.size()], hashes[i % names.size()]) (inst);
+			return sum;
+		});
+
+		ct->destroyInstance (inst);
+	}
+}
+
+//----------------------------------------------------------------------
+
+void BenchCompile ()
+{
+	for (unsigned fields : {4U, 16U, 64U, 256U})
+	{
+		size_t const ops = 256;
+
+		// Describing the type, compiling it (layout, field index, pool) and destroying it all
+		Bench ("compile.describe_compile_destroy", "fields=" + std::to_string (fields), ops, [&] {
+			Dy::TypeManager tm;
+			uint64_t sum = 0;
+			for (size_t i = 0; i < ops; ++i)
+			{
+				auto ct = tm.compile (MakeWideType (tm, fields), "Wide");
+				sum += ct->sizeOf() + ct->id();
+				tm.destroyCompiledType (ct);
+			}
+			return sum;
+		});
+	}
+}
+
+//----------------------------------------------------------------------
+
+void BenchHashing (Dy::TypeManager & tm)
+{
+	Random rnd {0xFEDCBA9876543210ULL};
+
+	// Bytewise (no padding, no floats), and one that has to go leaf by leaf
+	auto tU64 = tm.createType<DyF::Basic> (DyB::U64);
+	auto bytewise = tm.createType<DyF::DyStruct> ();
+	for (int i = 0; i < 4; ++i)
+		bytewise->addField ({tU64, "u" + std::to_string (i)});
+
+	Dy::InstanceArray arrays [] = {
+		Dy::InstanceArray {tm.compile (bytewise, "Hash.bytewise")},
+		Dy::InstanceArray {tm.compile (MakeRowType (tm), "Hash.leaves")},
+	};
+	char const * params [] = {"bytewise", "leaves"};
+
+	for (int k = 0; k < 2; ++k)
+	{
+		auto & arr = arrays[k];
+		arr.resizeZeroed (gc_RowCount);
+		for (auto inst : arr)
+			for (Dy::SizeType i = 0; i + 8 <= arr.stride(); i += 8)
+			{
+				uint64_t v = rnd.next() >> 12;		// Small enough to be exact as a float, too
+				std::memcpy (inst.data() + i, &v, sizeof(v));
+			}
+
+		Bench ("hash.instance", params[k], gc_RowCount, [&] {
+			uint64_t sum = 0;
+			for (auto inst : arr)
+				sum += arr.type().hashInstance (inst);
+			return sum;
+		});
+	}
+
+	std::vector<Dy::Byte> bytes (64 * 1024);
+	for (auto & b : bytes)
+		b = Dy::Byte(rnd.next());
+
+	Bench ("hash.hasher_bytes", "64KiB", bytes.size(), [&] {
+		Dy::Hasher h;
+		h.update (bytes.data(), bytes.size());
+		return h.finalize64AndReset ();
+	});
+}
+
+//======================================================================
+
+	}	// namespace
+
+//======================================================================
+
+int main (int argc, char * argv [])
+{
+	if (argc > 1)
+		g_filter = argv[1];
+	if (argc > 2)
+		g_reps = std::max (1, std::atoi (argv[2]));
+
+	std::printf ("benchmark,param,reps,ops,ns_per_op,checksum\n");
+
+	Dy::TypeManager tm {};
+	BenchFields (tm);
+	BenchInstances (tm);
+	BenchAccessors (tm);
+	BenchCompile ();
+	BenchHashing (tm);
+
+	return 0;
+}
@@ -1,6 +1,27 @@
 
 #include <dystruct/DyStruct.h>
+#include <dystruct/ColumnTable.h>
+#include <dystruct/HashTable.h>
+#include <dystruct/InstanceArray.h>
+#include <dystruct/InstanceFile.h>
+#include <dystruct/Kernels.h>
+#include <dystruct/Morph.h>
+#include <dystruct/Parallel.h>
+#include <dystruct/Schema.h>
+#include <dystruct/StaticStruct.h>
+#include <dystruct/String.h>
+#include <dystruct/Vector.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <limits>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 using namespace std;
 
@@ -9,6 +30,49 @@ struct Vec3
 	unsigned long long x, y, z;
 };
 
+DYSTRUCT_STATIC_BEGIN (Vec3)
+	DYSTRUCT_STATIC_FIELD (x)
+	DYSTRUCT_STATIC_FIELD (y)
+	DYSTRUCT_STATIC_FIELD (z)
+DYSTRUCT_STATIC_END ()
+
+// Runs every reduction and filter kernel over data at each SIMD level the CPU
+//  has, and checks that they all agree with the scalar versions.
+template <DyStruct::Basic basic_type>
+bool KernelsAgree (std::vector<typename DyStruct::Kernels::KernelTraits<basic_type>::ElemType> const & data)
+{
+	namespace K = DyStruct::Kernels;
+	typedef typename K::KernelTraits<basic_type>::ElemType T;
+
+	auto detected = K::DetectedSimdLevel ();
+	auto n = data.size();
+	auto pivot = data[n / 2];
+
+	K::SetSimdLevel (DyStruct::SimdLevel::Scalar);
+	auto sum = K::Sum<basic_type> (data.data(), n);
+	T lo {}, hi {};
+	K::Min<basic_type> (data.data(), n, lo);
+	K::Max<basic_type> (data.data(), n, hi);
+	auto less = K::Count<basic_type> (data.data(), n, DyStruct::CompareOp::Less, pivot);
+	std::vector<uint64_t> bits (K::BitmapWords (n));
+	K::Filter<basic_type> (data.data(), n, DyStruct::CompareOp::GreaterEqual, pivot, bits.data());
+
+	bool ok = less + K::BitmapCount (bits.data(), n) == n;
+	for (int level = 1; level <= int(detected); ++level)
+	{
+		K::SetSimdLevel (DyStruct::SimdLevel(level));
+		T l {}, h {};
+		std::vector<uint64_t> b (bits.size(), ~uint64_t(0));
+		K::Filter<basic_type> (data.data(), n, DyStruct::CompareOp::GreaterEqual, pivot, b.data());
+		ok = ok && sum == K::Sum<basic_type> (data.data(), n)
+			&& K::Min<basic_type> (data.data(), n, l) && l == lo && K::Max<basic_type> (data.data(), n, h) && h == hi
+			&& less == K::Count<basic_type> (data.data(), n, DyStruct::CompareOp::Less, pivot) && b == bits;
+	}
+
+	K::SetSimdLevel (detected);
+	return ok;
+}
+
 int main ()
 {
 	namespace Dy = DyStruct;
@@ -32,6 +96,679 @@ int main ()
 	cout << cArr50->sizeOf() << " == " << tm.getCompiledType("ull[50]")->sizeOf() << endl;
 	cout << cIVec3->sizeOf() << " == " << tm.getCompiledType("IVec3")->sizeOf() << endl;
 
+// An Enum's underlying type grows with its biggest value
+	{
+		auto tEnum = tm.createType<DyF::Enum>(DyB::U8);
+		tEnum->addEntry ("Small", 1);
+		bool small_ok = 1 == tEnum->getSizeOf();
+		tEnum->addEntry ("Medium", 300);
+		bool medium_ok = 2 == tEnum->getSizeOf();
+		tEnum->addEntry ("Large", 70000);
+		bool large_ok = 4 == tEnum->getSizeOf();
+		cout << "Enum widens: " << (small_ok && medium_ok && large_ok ? "ok" : "FAILED") << endl;
+		tm.destroyType (tEnum);
+	}
+
+// Arrays are as big as all of their elements, whatever the elements are
+	{
+		auto tArr4x3 = tm.createType<DyF::Array>(4U, tm.createType<DyF::Array>(3U, tU64));
+		auto tArrVec = tm.createType<DyF::Array>(5U, tIVec3);
+		cout << "Array sizes: " << (4 * 3 * 8 == tArr4x3->getSizeOf() && 5 * 24 == tArrVec->getSizeOf() ? "ok" : "FAILED") << endl;
+	}
+
+// Interning a duplicate hands back the interned type, and leaves the duplicate
+//  alone: C still points at B, and compiling C hashes its way through B.
+	{
+		Dy::TypeManager itm {};
+		Dy::CompileOptions share;
+		share.share_interned = true;
+
+		auto tI32 = itm.createInterned<DyF::Basic>(DyB::I32);
+		auto tA = itm.createType<DyF::DyStruct>();
+		tA->addField ({tI32, "v"});
+		auto tB = itm.createType<DyF::DyStruct>();
+		tB->addField ({tI32, "v"});
+		auto tC = itm.createType<DyF::DyStruct>();
+		tC->addField ({tB, "b"});
+
+		auto iA = itm.intern (tA);
+		auto iB = itm.intern (tB);
+		auto cC = itm.compile (tC, "C", share);
+		auto cA = itm.compile (iA, "A", share);
+		auto cB = itm.compile (iB, "B", share);
+
+		bool ok = iA == tA && iB == tA && itm.hasType (tB) && !itm.isInterned (tB) && 4 == tB->getSizeOf()
+			&& nullptr != cC && 4 == cC->sizeOf() && nullptr != cA && cA == cB && itm.getCompiledType ("B") == cA;
+		cout << "Interning keeps duplicates: " << (ok ? "ok" : "FAILED") << endl;
+	}
+
+// A destroyed interned type takes its shared CompiledType with it, even if a
+//  later type is allocated at the same address (which churning makes likely)
+	{
+		Dy::TypeManager itm {};
+		Dy::CompileOptions share;
+		share.share_interned = true;
+
+		std::unordered_set<Dy::CompiledType const *> seen;
+		bool ok = true;
+		for (int k = 0; k < 64; ++k)
+		{
+			auto tI16 = itm.createInterned<DyF::Basic>(DyB::I16);
+			auto cI16 = itm.compile (tI16, "I16_" + to_string(k), share);
+			ok = ok && nullptr != cI16 && seen.insert (cI16).second;
+			itm.destroyType (tI16);
+		}
+		cout << "Destroying interned types: " << (ok ? "ok" : "FAILED") << endl;
+	}
+
+// Reordering fields at compile time leaves the type itself (and whatever
+//  already uses it) alone
+	{
+		auto tU8 = tm.createType<DyF::Basic>(DyB::U8);
+		auto tLoose = tm.createType<DyF::DyStruct>();
+		tLoose->addField ({tU8, "a"});
+		tLoose->addField ({tU64, "b"});
+		tLoose->addField ({tU8, "c"});
+		auto tOuter = tm.createType<DyF::DyStruct>();
+		tOuter->addField ({tLoose, "inner"});
+
+		Dy::CompileOptions reorder;
+		reorder.reorder_fields = true;
+		auto cLoose = tm.compile (tLoose, "Loose");
+		auto cTight = tm.compile (tLoose, "Tight", reorder);
+
+		bool ok = 24 == cLoose->sizeOf() && 24 == tLoose->getSizeOf() && 24 == tOuter->getSizeOf()
+			&& "a" == tLoose->getField(0).name && 16 == cTight->sizeOf() && 8 == cTight->reorderSavings()
+			&& cTight->rawType() != tLoose && 8 == cLoose->findField("b")->offset;
+		cout << "Reordering copies: " << (ok ? "ok" : "FAILED") << endl;
+	}
+
+// A Vector lays its elements out when it's compiled, not when it's created, and
+//  won't compile with elements that can't be copied as bytes
+	{
+		auto tElem = tm.createType<DyF::DyStruct>();
+		auto tVec = tm.createType<DyF::Vector>(tElem);
+		tElem->addField ({tU64, "a"});
+		tElem->addField ({tU64, "b"});
+		auto tNested = tm.createType<DyF::DyStruct>();
+		tNested->addField ({tm.createType<DyF::Vector>(tU64), "inner"});
+		auto tBad = tm.createType<DyF::Vector>(tNested);
+		auto tHolder = tm.createType<DyF::DyStruct>();
+		tHolder->addField ({tBad, "bad"});
+
+		bool ok = nullptr != tm.compile (tVec, "VecAB") && 1 == tVec->getElemLayout().size()
+			&& 2 == tVec->getElemLayout()[0].count && tVec->isElemBytewise()
+			&& nullptr == tm.compile (tBad, "BadVec") && nullptr == tm.compile (tHolder, "BadHolder");
+		cout << "Vector elements: " << (ok ? "ok" : "FAILED") << endl;
+	}
+
+// Morphing between managers doesn't copy strings, since a long one points
+//  into the source manager's pool
+	{
+		Dy::TypeManager otm {};
+		auto tSrc = tm.createType<DyF::DyStruct>();
+		tSrc->addField ({tm.createString(), "s"});
+		auto tDst = otm.createType<DyF::DyStruct>();
+		tDst->addField ({otm.createString(), "s"});
+		auto cSrc = tm.compile (tSrc, "StrSrc");
+		auto cDst = otm.compile (tDst, "StrDst");
+
+		auto i = cSrc->createInstance ();
+		auto o = cDst->createInstance ();
+		cSrc->accessorString("s").set (i, "long enough not to fit in the slot itself");
+		otm.buildMorph(*cSrc, *cDst).apply (i, o);
+
+		bool ok = cDst->accessorString("s").str(o).empty();
+		cSrc->destroyInstance (i);
+		cDst->destroyInstance (o);
+		cout << "Strings stay in their pool: " << (ok ? "ok" : "FAILED") << endl;
+	}
+
+// Accessors for paths that don't lead anywhere useful come back invalid
+	{
+		auto tPts = tm.createType<DyF::DyStruct>();
+		tPts->addField ({tm.createType<DyF::Array>(4U, tIVec3), "pts"});
+		tPts->addField ({tm.createString(), "label"});
+		tPts->addField ({tm.createType<DyF::Vector>(tU64), "ids"});
+		auto cPts = tm.compile (tPts, "Points");
+
+		bool good = cPts->accessorPath<DyB::U64>("pts[1].y").isValid() && cPts->accessorPathStrided<DyB::U64>("pts[*].z").isValid()
+			&& cPts->accessorString("label").isValid() && cPts->accessorVector<DyB::U64>("ids").isValid();
+		bool bad = !cPts->accessorPath<DyB::U64>("pts[4].y").isValid() && !cPts->accessorPath<DyB::U32>("pts[1].y").isValid()
+			&& !cPts->accessorPath<DyB::U64>("pts[*].y").isValid() && !cPts->accessorPathStrided<DyB::U64>("pts[1].w").isValid()
+			&& !cPts->accessorString("pts").isValid() && !cPts->accessorVector<DyB::U32>("ids").isValid()
+			&& !cPts->accessorVector<DyB::U64>("label").isValid();
+		cout << "Bad paths: " << (good && bad ? "ok" : "FAILED") << endl;
+	}
+
+// A destroyed CompiledType loses its names, but what a lookup handed out stays usable
+	{
+		tm.compile (tIVec3, "Doomed");
+		auto found = tm.getCompiledType ("Doomed");
+		bool destroyed = tm.destroyCompiledType (found);
+
+		auto i = found->createInstance ();
+		bool ok = destroyed && nullptr == tm.getCompiledType ("Doomed") && !tm.hasCompiledType (found)
+			&& 24 == found->sizeOf() && !i.isNull();
+		found->destroyInstance (i);
+		cout << "Destroyed types linger: " << (ok ? "ok" : "FAILED") << endl;
+	}
+
+// A bound struct only matches a type whose fields are the same kind, not just the same size
+	{
+		auto tI64 = tm.createType<DyF::DyStruct>();
+		tI64->addField ({tm.createType<DyF::Basic>(DyB::I64), "x"});
+		tI64->addField ({tU64, "y"});
+		tI64->addField ({tU64, "z"});
+		auto tF64 = tm.createType<DyF::DyStruct>();
+		tF64->addField ({tU64, "x"});
+		tF64->addField ({tm.createType<DyF::Basic>(DyB::F64), "y"});
+		tF64->addField ({tU64, "z"});
+
+		bool ok = Dy::MatchesStatic<Vec3> (*cIVec3) && !Dy::MatchesStatic<Vec3> (*tm.compile (tI64, "I64Vec3"))
+			&& !Dy::MatchesStatic<Vec3> (*tm.compile (tF64, "F64Vec3"));
+		cout << "Static kinds: " << (ok ? "ok" : "FAILED") << endl;
+	}
+
+// Morphing into an array writes each new instance once, defaults included
+	{
+		auto tNext = tm.createType<DyF::DyStruct>();
+		tNext->addField ({tU64, "z"});
+		tNext->addField ({tm.createString(), "label"});
+		tNext->addField ({tm.createType<DyF::Vector>(tU64), "ids"});
+		tNext->addField ({tU64, "x"});
+		auto cNext = tm.compile (tNext, "NextVec3");
+
+		Dy::InstanceArray from {cIVec3, 3};
+		for (size_t k = 0; k < from.size(); ++k)
+		{
+			cIVec3->accessorField<DyB::U64>("x")(from[k]) = k;
+			cIVec3->accessorField<DyB::U64>("z")(from[k]) = 10 * k;
+		}
+		Dy::InstanceArray to {cNext};
+		bool ok = tm.buildMorph(*cIVec3, *cNext).apply (from, to) && 3 == to.size();
+		for (size_t k = 0; ok && k < to.size(); ++k)
+			ok = k == cNext->accessorPath<DyB::U64>("x")(to[k]) && 10 * k == cNext->accessorPath<DyB::U64>("z")(to[k])
+				&& cNext->accessorString("label").str(to[k]).empty() && cNext->accessorVector<DyB::U64>("ids").empty(to[k]);
+		cout << "Morph arrays: " << (ok ? "ok" : "FAILED") << endl;
+	}
+
+// A ColumnTable copies rows as bytes, so it won't take a field that owns memory
+	{
+		auto tHasVec = tm.createType<DyF::DyStruct>();
+		tHasVec->addField ({tU64, "n"});
+		tHasVec->addField ({tm.createType<DyF::Vector>(tU64), "v"});
+		Dy::ColumnTable plain {cIVec3};
+		Dy::ColumnTable owning {tm.compile (tHasVec, "HasVec")};
+
+		bool ok = plain.isValid() && plain.resize (3) && !owning.isValid() && !owning.resize (3) && 0 == owning.size()
+			&& 1 == plain.columnIndex ("y") && Dy::ColumnTable::InvalidColumn == plain.columnIndex ("w")
+			&& 16 == plain.columnField(2).offset && Dy::ColumnTable::InvalidColumn == owning.columnIndex ("n");
+		cout << "Column copies: " << (ok ? "ok" : "FAILED") << endl;
+	}
+
+// The SIMD kernels agree with the scalar ones, tails included (1003 isn't a
+//  multiple of any vector width.) Float values are small integers, so that
+//  summing them in a different order gives exactly the same result.
+	{
+		size_t const n = 1003;
+		vector<int32_t> i32 (n);
+		vector<uint32_t> u32 (n);
+		vector<float> f32 (n);
+		vector<double> f64 (n);
+		uint32_t seed = 12345;
+		for (size_t k = 0; k < n; ++k)
+		{
+			seed = seed * 1664525 + 1013904223;
+			i32[k] = int32_t(seed);
+			u32[k] = seed ^ 0x9E3779B9;
+			f32[k] = float(int32_t(seed >> 8) % 4096 - 2048);
+			f64[k] = double(int32_t(seed) % 100000) * 0.5;
+		}
+
+		bool ok = KernelsAgree<DyB::I32> (i32) && KernelsAgree<DyB::U32> (u32) && KernelsAgree<DyB::F32> (f32) && KernelsAgree<DyB::F64> (f64);
+		cout << "SIMD kernels: " << (ok ? "ok" : "FAILED") << endl;
+	}
+
+// Saturating conversions clamp instead of wrapping, and NaN becomes zero.
+//  Long enough to go through the SIMD loop as well as the tail.
+	{
+		size_t const n = 37;
+		vector<int32_t> i32 (n);
+		vector<float> f32 (n);
+		for (size_t k = 0; k < n; ++k)
+		{
+			i32[k] = k % 3 == 0 ? -5 : (k % 3 == 1 ? 70000 : int32_t(k));
+			f32[k] = k % 3 == 0 ? numeric_limits<float>::quiet_NaN() : (k % 3 == 1 ? 1e10f : -1e10f);
+		}
+
+		vector<uint16_t> u16 (n);
+		vector<int32_t> from_f32 (n);
+		Dy::Kernels::Convert (DyB::I32, i32.data(), DyB::U16, u16.data(), n, true);
+		Dy::Kernels::Convert (DyB::F32, f32.data(), DyB::I32, from_f32.data(), n);
+
+		bool ok = true;
+		for (size_t k = 0; k < n; ++k)
+		{
+			ok = ok && u16[k] == (k % 3 == 0 ? 0 : (k % 3 == 1 ? 65535 : uint16_t(k)));
+			ok = ok && from_f32[k] == (k % 3 == 0 ? 0 : (k % 3 == 1 ? numeric_limits<int32_t>::max() : numeric_limits<int32_t>::min()));
+		}
+		cout << "Saturating conversions: " << (ok ? "ok" : "FAILED") << endl;
+	}
+
+// A strided accessor gathers one field out of packed instances, and
+//  scatters it back without touching the other fields.
+	{
+		Dy::InstanceArray arr (cIVec3, 21);
+		auto x = cIVec3->accessorField<DyB::U64> ("x");
+		auto y = cIVec3->accessorField<DyB::U64> ("y");
+		auto z = cIVec3->accessorFieldStrided<DyB::U64> ("z");
+		for (size_t i = 0; i < arr.size(); ++i)
+		{
+			x(arr[i]) = i;
+			y(arr[i]) = 100 + i;
+			z(arr.front(), i) = 200 + i;
+		}
+
+		vector<uint64_t> zs (arr.size());
+		z.copyOut (arr.front(), zs.size(), zs.data());
+		bool ok = arr.size() == 21 && z.isValid();
+		for (size_t i = 0; i < zs.size(); ++i)
+		{
+			ok = ok && zs[i] == 200 + i;
+			zs[i] = 300 + i;
+		}
+
+		z.copyIn (arr.front(), zs.size(), zs.data());
+		for (size_t i = 0; i < arr.size(); ++i)
+			ok = ok && x(arr[i]) == i && y(arr[i]) == 100 + i && z(arr.front(), i) == 300 + i;
+		cout << "Strided copies: " << (ok ? "ok" : "FAILED") << endl;
+	}
+
+// The hasher doesn't care how its input is chunked, or whether numbers go in
+//  as words or as bytes, but trailing zero bytes do change the hash.
+	{
+		unsigned char buf [61];
+		for (size_t i = 0; i < sizeof(buf); ++i)
+			buf[i] = (unsigned char)(i * 37 + 11);
+
+		Dy::Hasher h;
+		h.update (buf, sizeof(buf));
+		auto whole = h.finalize64AndReset ();
+
+		bool ok = true;
+		for (size_t step = 1; step <= 13; ++step)
+		{
+			for (size_t i = 0; i < sizeof(buf); i += step)
+				h.update (buf + i, min (step, sizeof(buf) - i));
+			ok = ok && h.finalize64AndReset () == whole;
+		}
+
+		for (size_t lead = 0; lead < 8; ++lead)
+		{
+			uint64_t v = 0x0102030405060708ull;
+			h.update (buf, lead);
+			h.updateUnsigned (uint32_t(v));
+			h.updateUnsigned64 (v);
+			auto words = h.finalize64AndReset ();
+
+			h.update (buf, lead);
+			for (int b = 0; b < 4; ++b)
+				h.hashByte ((unsigned char)(v >> (8 * b)));
+			for (int b = 0; b < 8; ++b)
+				h.hashByte ((unsigned char)(v >> (8 * b)));
+			ok = ok && h.finalize64AndReset () == words;
+		}
+
+		unsigned char zeros [16] = {};
+		unordered_set<uint64_t> hashes;
+		for (size_t len = 0; len <= sizeof(zeros); ++len)
+		{
+			h.update (buf, 5);
+			h.update (zeros, len);
+			hashes.insert (h.finalize64AndReset ());
+		}
+		ok = ok && hashes.size() == sizeof(zeros) + 1;
+		cout << "Hasher chunking: " << (ok ? "ok" : "FAILED") << endl;
+	}
+
+// A saved registry loads back into a fresh manager with the same names, IDs,
+//  sizes and field offsets, and a truncated blob or a changed ID is refused.
+	{
+		Dy::TypeManager rtm {};
+		Dy::CompileOptions reorder, share;
+		reorder.reorder_fields = true;
+		share.share_interned = true;
+
+		auto tU8 = rtm.createInterned<DyF::Basic>(DyB::U8);
+		auto tF64 = rtm.createInterned<DyF::Basic>(DyB::F64);
+		auto tColor = rtm.createType<DyF::Enum>(DyB::U8);
+		tColor->addEntry ("Red");
+		tColor->addEntry ("Blue", 700);
+		auto tInner = rtm.createType<DyF::DyStruct>();
+		tInner->addField ({tU8, "a"});
+		tInner->addField ({tF64, "b"});
+		auto tOuter = rtm.createType<DyF::DyStruct>();
+		tOuter->addField ({tColor, "color"});
+		tOuter->addField ({tInner, "inner"});
+		tOuter->addField ({tU8, "flag"});
+		auto tPair = rtm.createType<DyF::DyStruct>();
+		tPair->addField ({tU8, "lo"});
+		tPair->addField ({tF64, "hi"});
+		auto iPair = rtm.intern (tPair);
+
+		Dy::CompiledType const * saved [] = {
+			rtm.compile (tColor, "Color"), rtm.compile (tOuter, "Outer"), rtm.compile (tOuter, "OuterPacked", reorder),
+			rtm.compile (iPair, "Pair", share), rtm.compile (iPair, "PairAlias", share)};
+		vector<Dy::Byte> blob;
+		bool ok = saved[3] == saved[4] && 2 == tColor->getSizeOf() && rtm.saveRegistry (blob);
+
+		Dy::TypeManager loaded {};
+		ok = ok && loaded.loadRegistry (blob.data(), blob.size());
+		for (auto c : saved)
+		{
+			auto l = loaded.getCompiledType (c->name());
+			ok = ok && l && l->id() == c->id() && l->sizeOf() == c->sizeOf();
+			if (ok && c->rawType()->isDyStruct())
+				for (Dy::SizeType i = 0; i < c->rawType()->asDyStruct()->getFieldCount(); ++i)
+				{
+					auto const & f = c->rawType()->asDyStruct()->getField (i);
+					auto lf = l->findField (f.name);
+					ok = ok && lf && lf->offset == f.offset;
+				}
+		}
+		ok = ok && loaded.getCompiledType ("PairAlias") == loaded.getCompiledType ("Pair");
+
+		for (size_t cut = 0; cut < blob.size(); cut += 7)
+		{
+			Dy::TypeManager t {};
+			ok = ok && !t.loadRegistry (blob.data(), cut);
+		}
+
+		uint64_t id = saved[1]->id();
+		auto at = search (blob.begin(), blob.end(), reinterpret_cast<Dy::Byte const *>(&id), reinterpret_cast<Dy::Byte const *>(&id) + sizeof(id));
+		ok = ok && at != blob.end();
+		if (ok)
+		{
+			*at ^= 1;
+			Dy::TypeManager t {};
+			ok = !t.loadRegistry (blob.data(), blob.size()) && nullptr == t.getCompiledType ("Outer");
+		}
+		cout << "Registry round trip: " << (ok ? "ok" : "FAILED") << endl;
+	}
+
+// An instance file opens with the writer's CompiledType, or with a rebuilt
+//  one in a manager that doesn't have it; truncated or foreign files don't.
+	{
+		char const * path = "DyStructTest.instances";
+		Dy::InstanceArray arr (cIVec3, 33);
+		auto y = cIVec3->accessorField<DyB::U64> ("y");
+		for (size_t i = 0; i < arr.size(); ++i)
+			y(arr[i]) = 7 * i;
+
+		bool ok = Dy::InstanceFile::Write (path, arr);
+		{
+			Dy::InstanceFile same;
+			ok = ok && same.open (path, tm) && same.typePtr() == cIVec3 && same.size() == arr.size() && y(same[32]) == 7 * 32;
+		}
+		{
+			Dy::TypeManager ftm {};
+			Dy::InstanceFile fresh;
+			ok = ok && fresh.open (path, ftm) && fresh.typePtr()->id() == cIVec3->id() && fresh.size() == arr.size()
+				&& fresh.typePtr()->accessorField<DyB::U64> ("y")(fresh[5]) == 35;
+		}
+
+		string bytes;
+		{
+			ifstream in (path, ios::binary);
+			bytes.assign (istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+		}
+		auto reopen = [&](string const & contents)
+		{
+			ofstream (path, ios::binary | ios::trunc) << contents;
+			Dy::TypeManager ftm {};
+			Dy::InstanceFile f;
+			return f.open (path, ftm);
+		};
+		string bad_magic = bytes;
+		bad_magic[0] ^= 0x20;
+		ok = ok && !bytes.empty() && !reopen (bytes.substr (0, bytes.size() - 1)) && !reopen (bad_magic) && reopen (bytes);
+		remove (path);
+		cout << "Instance files: " << (ok ? "ok" : "FAILED") << endl;
+	}
+
+// Sets and maps keep the right contents through rehashes and tombstones, and
+//  float keys that compare equal (-0 and +0, any two NaNs) are one key.
+	{
+		auto tBag = tm.createType<DyF::DyStruct>();
+		tBag->addField ({tm.createType<DyF::Map>(tm.createType<DyF::Basic>(DyB::U32), tU64), "m"});
+		tBag->addField ({tm.createType<DyF::Set>(tm.createType<DyF::Basic>(DyB::F32)), "fs"});
+		auto cBag = tm.compile (tBag, "Bag");
+		auto m = cBag->accessorMap<uint32_t, uint64_t> ("m");
+		auto fs = cBag->accessorSet<float> ("fs");
+
+		Dy::InstanceArray arr (cBag, 1);
+		auto bag = arr[0];
+		unordered_map<uint32_t, uint64_t> expected;
+		bool ok = true;
+		for (uint32_t round = 0; round < 3; ++round)
+		{
+			for (uint32_t k = 0; k < 2000; ++k)
+				if (k % 3 != round)
+				{
+					ok = ok && m.set (bag, k * 2654435761u, k + round, arr.arena());
+					expected[k * 2654435761u] = k + round;
+				}
+			for (uint32_t k = 0; k < 2000; k += 2)
+				ok = ok && m.erase (bag, k * 2654435761u) == (expected.erase (k * 2654435761u) == 1);
+		}
+		for (uint32_t k = 0; k < 2000; ++k)
+		{
+			auto e = expected.find (k * 2654435761u);
+			auto v = m.find (bag, k * 2654435761u);
+			ok = ok && m.contains (bag, k * 2654435761u) == (e != expected.end()) && (v ? e != expected.end() && *v == e->second : e == expected.end());
+		}
+		ok = ok && m.size (bag) == expected.size();
+
+		uint32_t const nan_bits [] = {0x7FC00000u, 0xFFC00000u, 0x7F800001u, 0x7FC12345u};
+		fs.insert (bag, 0.0f, arr.arena());
+		fs.insert (bag, -0.0f, arr.arena());
+		for (auto bits : nan_bits)
+		{
+			float nan;
+			memcpy (&nan, &bits, sizeof(nan));
+			fs.insert (bag, nan, arr.arena());
+		}
+		ok = ok && 2 == fs.size (bag) && fs.contains (bag, -0.0f) && fs.contains (bag, numeric_limits<float>::quiet_NaN());
+		cout << "Sets and maps: " << (ok ? "ok" : "FAILED") << endl;
+	}
+
+// Parallel passes visit every row exactly once, whatever the count, their
+//  chunks cover whole cache lines, and tasks can run batches of their own.
+	{
+		Dy::ThreadPool pool (3);
+		auto x = cIVec3->accessorField<DyB::U64> ("x");
+		auto y = cIVec3->accessorField<DyB::U64> ("y");
+
+		Dy::InstanceArray src (cIVec3);
+		bool ok = src.resizeZeroed (1001);
+		Dy::ParallelForEach (src, [&](Dy::InstancePtr inst, size_t row) {x(inst) = row; y(inst) += 1;}, pool);
+		Dy::InstanceArray dst (cIVec3);
+		ok = ok && Dy::ParallelTransform (src, dst, [&](Dy::InstancePtr s, Dy::InstancePtr d, size_t) {x(d) = 3 * x(s);}, pool)
+			&& dst.size() == src.size();
+		for (size_t i = 0; i < src.size(); ++i)
+			ok = ok && x(src[i]) == i && y(src[i]) == 1 && x(dst[i]) == 3 * i;
+
+		vector<int> hits (4 * 50);
+		pool.run (4, [&](size_t outer) {pool.run (50, [&](size_t inner) {++hits[outer * 50 + inner];});});
+		ok = ok && count (hits.begin(), hits.end(), 1) == int(hits.size());
+
+		size_t const rows_per_line_run = Dy::details::gc_CacheLineSize / 8;	// 24-byte rows fill whole lines every 64 / gcd(24, 64) rows
+		for (size_t n : {1u, 7u, 1001u, 100000u})
+			ok = ok && 0 == Dy::details::RowsPerChunk (n, 24, pool.threadCount()) % rows_per_line_run;
+		cout << "Parallel passes: " << (ok ? "ok" : "FAILED") << endl;
+	}
+
+// Content hashes and equality skip padding, treat -0 as 0 and all NaNs as
+//  one value, and a float hashes like an integer with the same bits would.
+	{
+		auto tU8 = tm.createType<DyF::Basic>(DyB::U8);
+		auto tF64 = tm.createType<DyF::Basic>(DyB::F64);
+		auto tPadded = tm.createType<DyF::DyStruct>();
+		tPadded->addField ({tU8, "a"});
+		tPadded->addField ({tF64, "b"});
+		tPadded->addField ({tm.createType<DyF::Basic>(DyB::U16), "c"});
+		auto tBits = tm.createType<DyF::DyStruct>();
+		tBits->addField ({tU64, "b"});
+		tBits->addField ({tU64, "n"});
+		auto tFloatBits = tm.createType<DyF::DyStruct>();
+		tFloatBits->addField ({tF64, "b"});
+		tFloatBits->addField ({tU64, "n"});
+		auto cPadded = tm.compile (tPadded, "Padded");
+		auto cBits = tm.compile (tBits, "Bits");
+		auto cFloatBits = tm.compile (tFloatBits, "FloatBits");
+
+		Dy::InstanceArray arr (cPadded, 2);
+		memset (arr[0].data(), 0xAA, cPadded->sizeOf());
+		memset (arr[1].data(), 0x55, cPadded->sizeOf());
+		auto a = cPadded->accessorField<DyB::U8> ("a");
+		auto b = cPadded->accessorField<DyB::F64> ("b");
+		auto c = cPadded->accessorField<DyB::U16> ("c");
+		auto same = [&] {return cPadded->equals (arr[0], arr[1]) && cPadded->hashInstance (arr[0]) == cPadded->hashInstance (arr[1]);};
+		for (int i = 0; i < 2; ++i)
+		{
+			a(arr[i]) = 7;
+			b(arr[i]) = 2.5;
+			c(arr[i]) = 300;
+		}
+		bool ok = !cPadded->isBytewiseComparable() && same();
+
+		b(arr[0]) = 0.0;
+		b(arr[1]) = -0.0;
+		ok = ok && same();
+
+		uint64_t const nan_bits [] = {0x7FF8000000000000ull, 0xFFF8000000000001ull};
+		for (int i = 0; i < 2; ++i)
+			memcpy (&b(arr[i]), &nan_bits[i], sizeof(double));
+		ok = ok && same();
+		b(arr[1]) = 1.0;
+		ok = ok && !cPadded->equals (arr[0], arr[1]);
+
+		double const value = 1234.5;
+		uint64_t value_bits;
+		memcpy (&value_bits, &value, sizeof(value));
+		Dy::InstanceArray bits (cBits, 1), float_bits (cFloatBits, 1);
+		cBits->accessorField<DyB::U64> ("b")(bits[0]) = value_bits;
+		cBits->accessorField<DyB::U64> ("n")(bits[0]) = 99;
+		cFloatBits->accessorField<DyB::F64> ("b")(float_bits[0]) = value;
+		cFloatBits->accessorField<DyB::U64> ("n")(float_bits[0]) = 99;
+		ok = ok && cBits->isBytewiseComparable() && !cFloatBits->isBytewiseComparable()
+			&& cBits->hashInstance (bits[0]) == cFloatBits->hashInstance (float_bits[0]);
+		cout << "Content hashes: " << (ok ? "ok" : "FAILED") << endl;
+	}
+
+// The example schema from Schema.h loads, with multidimensional arrays as in
+//  C, and a broken one says where it broke and compiles nothing at all.
+	{
+		Dy::TypeManager stm {};
+		Dy::SchemaResult result;
+		bool ok = Dy::LoadSchema (stm,
+			"// Line comments, and /* block comments */\n"
+			"enum Color { Red, Green = 5, Blue }\n"
+			"struct Point { x : F32; y : F32; }\n"
+			"struct Shape {\n"
+			"    color : Color;\n"
+			"    corners : Point[4];\n"
+			"    grid : U8[3][2];\n"
+			"    extra : struct { id : U64; tag : enum { A, B }; };\n"
+			"}\n", result);
+		ok = ok && result.error.empty() && 3 == result.types.size()
+			&& stm.getCompiledType ("Color") == result.types[0] && stm.getCompiledType ("Shape") == result.types[2]
+			&& 8 == result.types[1]->sizeOf();
+		auto grid = ok ? result.types[2]->findField ("grid") : nullptr;
+		ok = ok && grid && grid->type->isArray() && 3 == grid->type->asArray()->getElemCount()
+			&& grid->type->asArray()->getElemType()->isArray() && 2 == grid->type->asArray()->getElemType()->asArray()->getElemCount()
+			&& 6 == grid->type->getSizeOf();
+
+		Dy::SchemaResult broken;
+		ok = ok && !Dy::LoadSchema (stm,
+			"struct Fine { a : I32; }\n"
+			"struct Broken {\n"
+			"  b : Nope;\n"
+			"}\n", broken);
+		ok = ok && !broken.error.empty() && 3 == broken.error_line && 7 == broken.error_column
+			&& broken.types.empty() && nullptr == stm.getCompiledType ("Fine");
+		cout << "Schemas: " << (ok ? "ok" : "FAILED") << endl;
+	}
+
+// Pools hand freed slots out again before carving new ones, with or without
+//  the thread caches, so the same work twice over takes no more slabs.
+	{
+		Dy::InstancePool plain (24, 8, false, false);
+		auto first = plain.allocate ();
+		plain.deallocate (first);
+		bool ok = plain.allocate () == first && 1 == plain.slabCount();
+		plain.deallocate (first);
+
+		Dy::InstancePool lined (24, 8, true, false);
+		auto slot = lined.allocate ();
+		ok = ok && 0 == lined.slotSize() % Dy::details::gc_CacheLineSize && 0 == reinterpret_cast<uintptr_t>(slot) % Dy::details::gc_CacheLineSize;
+		lined.deallocate (slot);
+
+		Dy::InstancePool cached (24, 8, false, true);
+		size_t const per_thread = 3000;
+		auto churn = [&] (unsigned char mark, bool & good)
+		{
+			vector<Dy::Byte *> held (per_thread);
+			for (auto & mem : held)
+			{
+				mem = cached.allocate ();
+				good = good && mem;
+				if (mem)
+					memset (mem, mark, 24);
+			}
+			for (auto mem : held)
+				good = good && mem && mem[0] == mark && mem[23] == mark;
+			for (auto mem : held)
+				if (mem)
+					cached.deallocate (mem);
+		};
+
+		bool good [3] = {true, true, true};
+		size_t slabs [2] = {};
+		for (int round = 0; round < 2; ++round)
+		{
+			thread t1 (churn, 1, ref (good[1])), t2 (churn, 2, ref (good[2]));
+			churn (0, good[0]);
+			t1.join ();
+			t2.join ();
+			slabs[round] = cached.slabCount();
+		}
+		ok = ok && cached.hasThreadCache() && good[0] && good[1] && good[2] && slabs[0] > 0 && slabs[1] == slabs[0];
+		cout << "Pool reuse: " << (ok ? "ok" : "FAILED") << endl;
+	}
+
+// The field index of a wide struct finds every field, by name or by a hash
+//  worked out beforehand, and nothing for names that aren't there.
+	{
+		auto tWide = tm.createType<DyF::DyStruct>();
+		for (int i = 0; i < 64; ++i)
+			tWide->addField ({i % 3 ? static_cast<Dy::Type *>(tU64) : tIVec3, "field_" + to_string (i)});
+		auto cWide = tm.compile (tWide, "Wide");
+		auto const & fields = *cWide->rawType()->asDyStruct();
+
+		bool ok = 64 == fields.getFieldCount();
+		for (Dy::SizeType i = 0; i < fields.getFieldCount(); ++i)
+		{
+			auto const & name = fields.getField(i).name;
+			ok = ok && cWide->findField (name) == &fields.getField(i)
+				&& cWide->findField (name, Dy::FieldIndex::Hash (name)) == &fields.getField(i);
+		}
+		for (auto missing : {"field_64", "field_", "field_1 ", "Field_1", ""})
+			ok = ok && nullptr == cWide->findField (missing) && nullptr == cWide->findField (missing, Dy::FieldIndex::Hash (missing));
+		cout << "Wide field index: " << (ok ? "ok" : "FAILED") << endl;
+	}
+
 	Dy::InstancePtr p = cArr50->createInstance ();
 	Dy::InstancePtr q = p;
 	Dy::InstancePtr r = cU64->createInstance ();
@@ -81,6 +818,19 @@ int main ()
 		delete ss;
 	// }
 
+// Binding Vec3 itself: the static accessors have their offsets built in, so
+//  they compile to `mov rax, [rdx + 16]` just like the plain struct code above,
+//  while the instances are still described by (and usable through) a CompiledType.
+	auto cVec3 = tm.compileStatic<Vec3> ("Vec3");
+	auto sx = DYSTRUCT_STATIC_ACCESSOR (Vec3, x);
+	auto sy = DYSTRUCT_STATIC_ACCESSOR (Vec3, y);
+	auto sz = DYSTRUCT_STATIC_ACCESSOR (Vec3, z);
+
+	Vec3 v {x(s), y(s), z(s)};
+	auto vi = cVec3->wrapInstance (&v);
+	sz(vi) = sx(vi) + sy(vi);
+	cout << "v = (" << v.x << ", " << v.y << ", " << v.z << "), " << cVec3->sizeOf() << " bytes, matches IVec3: " << Dy::MatchesStatic<Vec3> (*cIVec3) << "\n";
+
 // Accessing an ArrayType
 	for (int i = 0, e = 50; i < e; ++i)
 		a[i](p) = 42 + i * i;
@@ -94,6 +844,9 @@ int main ()
 	cout << endl;
 	cout << "Sum = " << sum << endl;
 
+	// Same thing, but with the SIMD kernels, since the array elements are contiguous
+	cout << "Sum = " << Dy::Kernels::Sum<DyB::U64>(reinterpret_cast<uint64_t const *>(q.data()), 50) << endl;
+
 // Cleanup
 	t.destroySelf ();
 	s.destroySelf ();
@@ -0,0 +1,147 @@
+//======================================================================
+
+#include <dystruct/Arena.h>
+
+#include <algorithm>
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+Arena::Arena (size_t chunk_size)
+	: m_chunk_size {std::max<size_t> (chunk_size, details::gc_CacheLineSize)}
+	, m_chunks {}
+	, m_chunk_sizes {}
+	, m_bump {nullptr}
+	, m_bump_end {nullptr}
+	, m_allocated {0}
+	, m_reserved {0}
+{
+}
+
+//----------------------------------------------------------------------
+
+Arena::~Arena ()
+{
+	release ();
+}
+
+//----------------------------------------------------------------------
+
+Arena::Arena (Arena && that)
+	: m_chunk_size {that.m_chunk_size}
+	, m_chunks {std::move(that.m_chunks)}
+	, m_chunk_sizes {std::move(that.m_chunk_sizes)}
+	, m_bump {that.m_bump}
+	, m_bump_end {that.m_bump_end}
+	, m_allocated {that.m_allocated}
+	, m_reserved {that.m_reserved}
+{
+	that.m_chunks.clear ();
+	that.m_chunk_sizes.clear ();
+	that.m_bump = that.m_bump_end = nullptr;
+	that.m_allocated = that.m_reserved = 0;
+}
+
+//----------------------------------------------------------------------
+
+Arena & Arena::operator = (Arena && that)
+{
+	if (this != &that)
+	{
+		release ();
+
+		m_chunk_size = that.m_chunk_size;
+		m_chunks = std::move(that.m_chunks);
+		m_chunk_sizes = std::move(that.m_chunk_sizes);
+		m_bump = that.m_bump;
+		m_bump_end = that.m_bump_end;
+		m_allocated = that.m_allocated;
+		m_reserved = that.m_reserved;
+
+		that.m_chunks.clear ();
+		that.m_chunk_sizes.clear ();
+		that.m_bump = that.m_bump_end = nullptr;
+		that.m_allocated = that.m_reserved = 0;
+	}
+	return *this;
+}
+
+//----------------------------------------------------------------------
+
+void * Arena::allocate (size_t size, size_t align)
+{
+	assert (align > 0 && 0 == (align & (align - 1)) && align <= details::gc_CacheLineSize);
+
+	auto p = reinterpret_cast<uintptr_t>(m_bump);
+	auto aligned = (p + align - 1) & ~uintptr_t(align - 1);
+	auto end = reinterpret_cast<uintptr_t>(m_bump_end);
+	if (nullptr != m_bump && aligned <= end && size <= end - aligned)
+	{
+		m_bump = reinterpret_cast<Byte *>(aligned + size);
+		m_allocated += size;
+		return reinterpret_cast<void *>(aligned);
+	}
+
+	// Big allocations get a chunk of their own, so the current one isn't wasted.
+	// Chunks start cache-line aligned, so a fresh one always fits the alignment.
+	bool own = size > m_chunk_size / 4;
+	auto chunk_size = own ? (size + details::gc_CacheLineSize - 1) & ~size_t(details::gc_CacheLineSize - 1) : m_chunk_size;
+	if (chunk_size < size)
+		return nullptr;
+	auto chunk = static_cast<Byte *>(details::AlignedAlloc (std::max<size_t> (chunk_size, 1), details::gc_CacheLineSize));
+	if (nullptr == chunk)
+		return nullptr;
+
+	m_chunks.push_back (chunk);
+	m_chunk_sizes.push_back (chunk_size);
+	m_reserved += chunk_size;
+	m_allocated += size;
+	if (!own)
+	{
+		m_bump = chunk + size;
+		m_bump_end = chunk + chunk_size;
+	}
+	return chunk;
+}
+
+//----------------------------------------------------------------------
+
+void Arena::reset ()
+{
+	if (m_chunks.empty())
+		return;
+
+	for (size_t i = 1; i < m_chunks.size(); ++i)
+	{
+		details::AlignedFree (m_chunks[i]);
+		m_reserved -= m_chunk_sizes[i];
+	}
+	m_chunks.resize (1);
+	m_chunk_sizes.resize (1);
+
+	m_bump = m_chunks[0];
+	m_bump_end = m_bump + m_chunk_sizes[0];
+	m_allocated = 0;
+}
+
+//----------------------------------------------------------------------
+
+void Arena::release ()
+{
+	for (auto c : m_chunks)
+		details::AlignedFree (c);
+	m_chunks.clear ();
+	m_chunk_sizes.clear ();
+	m_bump = m_bump_end = nullptr;
+	m_allocated = m_reserved = 0;
+}
+
+//----------------------------------------------------------------------
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================
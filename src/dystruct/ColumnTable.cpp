@@ -0,0 +1,281 @@
+//======================================================================
+
+#include <dystruct/ColumnTable.h>
+#include <dystruct/Kernels.h>
+
+#include <algorithm>
+#include <cstring>
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+SizeType const ColumnTable::InvalidColumn;
+
+//----------------------------------------------------------------------
+
+ColumnTable::ColumnTable (CompiledType const * ctype)
+	: m_ctype (ctype)
+	, m_columns {}
+	, m_size (0)
+	, m_capacity (0)
+	, m_valid (false)
+{
+	assert (m_ctype);
+	assert (m_ctype->rawType()->isDyStruct());
+
+	auto st = m_ctype->rawType()->asDyStruct();
+	for (SizeType i = 0, e = st->getFieldCount(); i < e; ++i)
+	{
+		// A byte copy of a Vector, Set or Map header would alias its elements
+		if (!st->getField(i).type->isTriviallyCopyable())
+			return;
+	}
+
+	m_columns.reserve (st->getFieldCount());
+	for (SizeType i = 0, e = st->getFieldCount(); i < e; ++i)
+	{
+		auto const & f = st->getField(i);
+		m_columns.push_back (Column {f.type, f.offset, f.type->getSizeOf(), nullptr});
+	}
+	m_valid = true;
+}
+
+//----------------------------------------------------------------------
+
+ColumnTable::~ColumnTable ()
+{
+	clear ();
+	releaseColumns ();
+}
+
+//----------------------------------------------------------------------
+
+ColumnTable::ColumnTable (ColumnTable && that)
+	: m_ctype (that.m_ctype)
+	, m_columns (std::move(that.m_columns))
+	, m_size (that.m_size)
+	, m_capacity (that.m_capacity)
+	, m_valid (that.m_valid)
+{
+	that.m_columns.clear ();
+	that.m_size = 0;
+	that.m_capacity = 0;
+}
+
+//----------------------------------------------------------------------
+
+ColumnTable & ColumnTable::operator = (ColumnTable && that)
+{
+	if (this != &that)
+	{
+		clear ();
+		releaseColumns ();
+
+		m_ctype = that.m_ctype;
+		m_columns = std::move(that.m_columns);
+		m_size = that.m_size;
+		m_capacity = that.m_capacity;
+		m_valid = that.m_valid;
+
+		that.m_columns.clear ();
+		that.m_size = 0;
+		that.m_capacity = 0;
+	}
+	return *this;
+}
+
+//----------------------------------------------------------------------
+
+SizeType ColumnTable::columnIndex (std::string const & field_name, FieldIndex::HashType hash) const
+{
+	auto field = m_ctype->findField (field_name, hash);
+	if (nullptr == field || m_columns.empty())
+		return InvalidColumn;
+
+	return SizeType(field - &m_ctype->rawType()->asDyStruct()->getField(0));
+}
+
+//----------------------------------------------------------------------
+
+bool ColumnTable::convertColumn (SizeType column, Basic dst_type, void * out, bool saturate) const
+{
+	assert (column < columnCount());
+
+	auto type = m_columns[column].type;
+	if (!type->isBasic())
+		return false;
+
+	Kernels::Convert (type->asBasic()->getType(), m_columns[column].data, dst_type, out, m_size, saturate);
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+bool ColumnTable::reserve (size_t count)
+{
+	if (!m_valid)
+		return false;
+	if (count <= m_capacity)
+		return true;
+
+	return reallocate (count);
+}
+
+//----------------------------------------------------------------------
+
+bool ColumnTable::resize (size_t count)
+{
+	if (count < m_size)
+	{
+		destructRows (count, m_size);
+		m_size = count;
+		return true;
+	}
+
+	if (!m_valid)
+		return false;
+	if (count > m_capacity && !reallocate (std::max(count, 2 * m_capacity)))
+		return false;
+
+	if (!constructRows (m_size, count))
+		return false;
+
+	m_size = count;
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+bool ColumnTable::appendRow (InstancePtr src)
+{
+	if (!resize (m_size + 1))
+		return false;
+
+	writeRow (m_size - 1, src);
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+void ColumnTable::clear ()
+{
+	destructRows (0, m_size);
+	m_size = 0;
+}
+
+//----------------------------------------------------------------------
+
+void ColumnTable::readRow (size_t row, InstancePtr dst) const
+{
+	assert (row < m_size);
+	assert (dst.typePtr() == m_ctype && !dst.isNull());
+
+	for (auto const & c : m_columns)
+		std::memcpy (dst.data() + c.offset, c.data + row * c.elem_size, c.elem_size);
+}
+
+//----------------------------------------------------------------------
+
+void ColumnTable::writeRow (size_t row, InstancePtr src)
+{
+	assert (row < m_size);
+	assert (src.typePtr() == m_ctype && !src.isNull());
+
+	for (auto const & c : m_columns)
+		std::memcpy (c.data + row * c.elem_size, src.data() + c.offset, c.elem_size);
+}
+
+//----------------------------------------------------------------------
+//----------------------------------------------------------------------
+
+bool ColumnTable::reallocate (size_t new_capacity)
+{
+	assert (new_capacity >= m_size);
+
+	std::vector<Byte *> new_data (m_columns.size(), nullptr);
+	for (size_t i = 0; i < m_columns.size(); ++i)
+	{
+		auto bytes = new_capacity * m_columns[i].elem_size;
+		if (0 == bytes)
+			continue;
+
+		new_data[i] = static_cast<Byte *>(details::AlignedAlloc (bytes, details::gc_CacheLineSize));
+		if (nullptr == new_data[i])
+		{
+			for (auto p : new_data)
+				details::AlignedFree (p);
+			return false;
+		}
+	}
+
+	for (size_t i = 0; i < m_columns.size(); ++i)
+	{
+		auto & c = m_columns[i];
+		if (m_size > 0 && new_data[i])
+			std::memcpy (new_data[i], c.data, m_size * c.elem_size);
+		details::AlignedFree (c.data);
+		c.data = new_data[i];
+	}
+
+	m_capacity = new_capacity;
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+bool ColumnTable::constructRows (size_t first, size_t last)
+{
+	for (size_t ci = 0; ci < m_columns.size(); ++ci)
+	{
+		auto const & c = m_columns[ci];
+		if (c.type->isTriviallyConstructible())
+			continue;
+		for (auto r = first; r < last; ++r)
+			if (!c.type->construct (c.data + r * c.elem_size, c.elem_size))
+			{
+				// Undo this column's rows so far, then all the rows of the previous columns
+				for (auto rr = r; rr > first; --rr)
+					c.type->destruct (c.data + (rr - 1) * c.elem_size, c.elem_size);
+				for (auto cj = ci; cj > 0; --cj)
+				{
+					auto const & pc = m_columns[cj - 1];
+					for (auto rr = last; rr > first; --rr)
+						pc.type->destruct (pc.data + (rr - 1) * pc.elem_size, pc.elem_size);
+				}
+				return false;
+			}
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+void ColumnTable::destructRows (size_t first, size_t last)
+{
+	for (auto i = m_columns.rbegin(), e = m_columns.rend(); i != e; ++i)
+		if (!i->type->isTriviallyDestructible())
+			for (auto r = last; r > first; --r)
+				i->type->destruct (i->data + (r - 1) * i->elem_size, i->elem_size);
+}
+
+//----------------------------------------------------------------------
+
+void ColumnTable::releaseColumns ()
+{
+	for (auto & c : m_columns)
+	{
+		details::AlignedFree (c.data);
+		c.data = nullptr;
+	}
+}
+
+//----------------------------------------------------------------------
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================
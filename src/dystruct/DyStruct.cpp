@@ -1,7 +1,16 @@
 //======================================================================
 
 #include <dystruct/DyStruct.h>
-
+#include <dystruct/String.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <new>
+#include <thread>
+#include <type_traits>
 #include <utility>
 
 //======================================================================
@@ -29,22 +38,50 @@ const FamilyTraits gc_FamilyTraits [int(Family::_count)] =
 
 const BasicTraits gc_BasicTraits [int(Basic::_count)] =
 {
-	{Basic::I8   , "I8"   , sizeof(BasicTypeMap<Basic::I8>::type)   ,  true,  true,  true, false}, 
-	{Basic::U8   , "U8"   , sizeof(BasicTypeMap<Basic::U8>::type)   ,  true,  true, false, false},
-	{Basic::I16  , "I16"  , sizeof(BasicTypeMap<Basic::I16>::type)  ,  true,  true,  true, false},
-	{Basic::U16  , "U16"  , sizeof(BasicTypeMap<Basic::U16>::type)  ,  true,  true, false, false},
-	{Basic::I32  , "I32"  , sizeof(BasicTypeMap<Basic::I32>::type)  ,  true,  true,  true, false},
-	{Basic::U32  , "U32"  , sizeof(BasicTypeMap<Basic::U32>::type)  ,  true,  true, false, false},
-	{Basic::I64  , "I64"  , sizeof(BasicTypeMap<Basic::I64>::type)  ,  true,  true,  true, false},
-	{Basic::U64  , "U64"  , sizeof(BasicTypeMap<Basic::U64>::type)  ,  true,  true, false, false},
-	{Basic::F32  , "F32"  , sizeof(BasicTypeMap<Basic::F32>::type)  ,  true, false,  true,  true},
-	{Basic::F64  , "F64"  , sizeof(BasicTypeMap<Basic::F64>::type)  ,  true, false,  true,  true},
-	{Basic::Bool , "Bool" , sizeof(BasicTypeMap<Basic::Bool>::type) , false, false, false, false},
-	{Basic::Byte , "Byte" , sizeof(BasicTypeMap<Basic::Byte>::type) , false, false, false, false},
-	{Basic::Char , "Char" , sizeof(BasicTypeMap<Basic::Char>::type) , false, false, false, false},
-	{Basic::WChar, "WChar", sizeof(BasicTypeMap<Basic::WChar>::type), false, false, false, false},
+	{Basic::I8   , "I8"   , sizeof(BasicTypeMap<Basic::I8>::type)   , std::alignment_of<BasicTypeMap<Basic::I8>::type>::value   ,  true,  true,  true, false}, 
+	{Basic::U8   , "U8"   , sizeof(BasicTypeMap<Basic::U8>::type)   , std::alignment_of<BasicTypeMap<Basic::U8>::type>::value   ,  true,  true, false, false},
+	{Basic::I16  , "I16"  , sizeof(BasicTypeMap<Basic::I16>::type)  , std::alignment_of<BasicTypeMap<Basic::I16>::type>::value  ,  true,  true,  true, false},
+	{Basic::U16  , "U16"  , sizeof(BasicTypeMap<Basic::U16>::type)  , std::alignment_of<BasicTypeMap<Basic::U16>::type>::value  ,  true,  true, false, false},
+	{Basic::I32  , "I32"  , sizeof(BasicTypeMap<Basic::I32>::type)  , std::alignment_of<BasicTypeMap<Basic::I32>::type>::value  ,  true,  true,  true, false},
+	{Basic::U32  , "U32"  , sizeof(BasicTypeMap<Basic::U32>::type)  , std::alignment_of<BasicTypeMap<Basic::U32>::type>::value  ,  true,  true, false, false},
+	{Basic::I64  , "I64"  , sizeof(BasicTypeMap<Basic::I64>::type)  , std::alignment_of<BasicTypeMap<Basic::I64>::type>::value  ,  true,  true,  true, false},
+	{Basic::U64  , "U64"  , sizeof(BasicTypeMap<Basic::U64>::type)  , std::alignment_of<BasicTypeMap<Basic::U64>::type>::value  ,  true,  true, false, false},
+	{Basic::F32  , "F32"  , sizeof(BasicTypeMap<Basic::F32>::type)  , std::alignment_of<BasicTypeMap<Basic::F32>::type>::value  ,  true, false,  true,  true},
+	{Basic::F64  , "F64"  , sizeof(BasicTypeMap<Basic::F64>::type)  , std::alignment_of<BasicTypeMap<Basic::F64>::type>::value  ,  true, false,  true,  true},
+	{Basic::Bool , "Bool" , sizeof(BasicTypeMap<Basic::Bool>::type) , std::alignment_of<BasicTypeMap<Basic::Bool>::type>::value , false, false, false, false},
+	{Basic::Byte , "Byte" , sizeof(BasicTypeMap<Basic::Byte>::type) , std::alignment_of<BasicTypeMap<Basic::Byte>::type>::value , false, false, false, false},
+	{Basic::Char , "Char" , sizeof(BasicTypeMap<Basic::Char>::type) , std::alignment_of<BasicTypeMap<Basic::Char>::type>::value , false, false, false, false},
+	{Basic::WChar, "WChar", sizeof(BasicTypeMap<Basic::WChar>::type), std::alignment_of<BasicTypeMap<Basic::WChar>::type>::value, false, false, false, false},
 };
 
+//======================================================================
+
+void * AlignedAlloc (size_t size, size_t align)
+{
+	assert (align > 0 && (align & (align - 1)) == 0);
+	if (align < sizeof(void *))
+		align = sizeof(void *);
+
+	// Stash the pointer malloc gave us right before the aligned block
+	auto raw = static_cast<Byte *>(std::malloc (size + align + sizeof(void *)));
+	if (nullptr == raw)
+		return nullptr;
+
+	auto addr = reinterpret_cast<uintptr_t>(raw + sizeof(void *));
+	auto ret = reinterpret_cast<Byte *>((addr + align - 1) & ~uintptr_t(align - 1));
+	reinterpret_cast<void **>(ret)[-1] = raw;
+
+	return ret;
+}
+
+//----------------------------------------------------------------------
+
+void AlignedFree (void * mem)
+{
+	if (mem)
+		std::free (reinterpret_cast<void **>(mem)[-1]);
+}
+
 //======================================================================
 
 	}	// namespace details
@@ -60,7 +97,10 @@ bool EnumType::addEntry (std::string name, uint32_t value)
 	m_name_values.emplace_back (std::make_pair(std::move(name), value));
 	
 	if (value > m_max_value)
+	{
 		m_max_value = value;
+		m_underlying_type = underlyingType ();
+	}
 
 	return true;
 }
@@ -92,10 +132,9 @@ bool DyStructType::addField (Field field)
 	if (!field.type || field.name.empty() || hasField(field.name))
 		return false;
 
-	field.offset = m_cur_size;
-	auto fs = field.type->getSizeOf();
+	layoutField (field);
+	m_field_map[field.name] = SizeType(m_fields.size());
 	m_fields.emplace_back (std::move(field));
-	m_cur_size += fs;
 
 	return true;
 }
@@ -104,22 +143,50 @@ bool DyStructType::addField (Field field)
 
 bool DyStructType::hasField (std::string const & name) const
 {
-	for (auto const & f : m_fields)
-		if (name == f.name)
-			return true;
-
-	return false;
+	return m_field_map.end() != m_field_map.find(name);
 }
 
 //----------------------------------------------------------------------
 
 DyStructType::Field const * DyStructType::findField (std::string const & name) const
 {
-	for (auto const & f : m_fields)
-		if (name == f.name)
-			return &f;
+	auto i = m_field_map.find (name);
+	if (m_field_map.end() != i)
+		return &m_fields[i->second];
+	else
+		return nullptr;
+}
+
+//----------------------------------------------------------------------
+
+SizeType DyStructType::reorderFields ()
+{
+	auto old_size = m_cur_size;
+	FieldContainer old_fields = m_fields;
 
-	return nullptr;
+	std::stable_sort (m_fields.begin(), m_fields.end(),
+		[](Field const & a, Field const & b){return a.type->getAlignment() > b.type->getAlignment();});
+
+	m_cur_size = 0;
+	m_cur_end = 0;
+	m_cur_align = 1;
+	for (auto & f : m_fields)
+		layoutField (f);
+
+	// Can't happen as long as every size is a multiple of its alignment, but just in case...
+	if (m_cur_size > old_size)
+	{
+		m_fields = std::move(old_fields);
+		m_cur_size = 0;
+		m_cur_end = 0;
+		m_cur_align = 1;
+		for (auto & f : m_fields)
+			layoutField (f);
+	}
+
+	rebuildFieldMap ();
+
+	return old_size - m_cur_size;
 }
 
 //----------------------------------------------------------------------
@@ -145,15 +212,271 @@ bool DyStructType::allElementsFixedFootprint () const
 	return true;
 }
 
+//----------------------------------------------------------------------
+
+void DyStructType::layoutField (Field & field)
+{
+	auto fa = field.type->getAlignment();
+	field.offset = details::AlignUp (m_cur_end, fa);
+	m_cur_end = field.offset + field.type->getSizeOf();
+	if (fa > m_cur_align)
+		m_cur_align = fa;
+	m_cur_size = details::AlignUp (m_cur_end, m_cur_align);
+}
+
+//----------------------------------------------------------------------
+
+void DyStructType::rebuildFieldMap ()
+{
+	m_field_map.clear ();
+	for (SizeType i = 0, e = SizeType(m_fields.size()); i < e; ++i)
+		m_field_map[m_fields[i].name] = i;
+}
+
+//======================================================================
+
+	namespace {
+
+// Scrambles a name hash with a bucket seed.
+inline uint32_t SeededMix (uint32_t h, uint32_t seed)
+{
+	uint32_t x = h ^ (seed * 0x9E3779B9U);
+	x ^= x >> 16;
+	x *= 0x85EBCA6BU;
+	x ^= x >> 13;
+	x *= 0xC2B2AE35U;
+	x ^= x >> 16;
+	return x;
+}
+
+// Maps x to [0, n) with a multiply instead of a division.
+inline uint32_t FastRange (uint32_t x, uint32_t n)
+{
+	return uint32_t((uint64_t(x) * n) >> 32);
+}
+
+uint32_t const gc_MaxSeedTries = 1U << 16;
+
+	}	// namespace
+
+//----------------------------------------------------------------------
+
+FieldIndex::HashType FieldIndex::Hash (char const * name, size_t len)
+{
+	Hasher h;
+	h.update (name, len);
+	return h.finalizeAndReset ();
+}
+
+//----------------------------------------------------------------------
+
+FieldIndex::FieldIndex (DyStructType const * type)
+	: m_type {type}
+	, m_seeds {}
+	, m_slots {}
+	, m_fallback {false}
+{
+	assert (m_type);
+
+	auto n = m_type->getFieldCount();
+	if (0 == n)
+		return;
+
+	std::vector<HashType> hashes (n);
+	for (SizeType i = 0; i < n; ++i)
+		hashes[i] = Hash (m_type->getField(i).name);
+
+	// Distinct names with equal hashes can't be told apart by any seed
+	auto sorted = hashes;
+	std::sort (sorted.begin(), sorted.end());
+	if (std::adjacent_find (sorted.begin(), sorted.end()) != sorted.end())
+	{
+		m_fallback = true;
+		return;
+	}
+
+	// About two names per bucket; if the seeds can't be found (very unlikely,) use more buckets
+	for (uint32_t buckets = (n + 1) / 2; ; buckets *= 2)
+		if (build (hashes, buckets))
+			break;
+}
+
+//----------------------------------------------------------------------
+
+DyStructType::Field const * FieldIndex::find (std::string const & name, HashType hash) const
+{
+	if (m_fallback)
+		return m_type->findField (name);
+
+	if (m_slots.empty())
+		return nullptr;
+
+	auto n = uint32_t(m_slots.size());
+	auto bucket = FastRange (hash, uint32_t(m_seeds.size()));
+	auto slot = FastRange (SeededMix (hash, m_seeds[bucket]), n);
+	auto const & f = m_type->getField (m_slots[slot]);
+
+	return (f.name == name) ? &f : nullptr;
+}
+
+//----------------------------------------------------------------------
+
+bool FieldIndex::build (std::vector<HashType> const & hashes, uint32_t bucket_count)
+{
+	auto n = uint32_t(hashes.size());
+
+	std::vector<std::vector<SizeType>> buckets (bucket_count);
+	for (SizeType i = 0; i < n; ++i)
+		buckets[FastRange (hashes[i], bucket_count)].push_back (i);
+
+	// Biggest buckets first, while there's still lots of room
+	std::vector<uint32_t> order (bucket_count);
+	for (uint32_t b = 0; b < bucket_count; ++b)
+		order[b] = b;
+	std::stable_sort (order.begin(), order.end(),
+		[&buckets](uint32_t a, uint32_t b){return buckets[a].size() > buckets[b].size();});
+
+	m_seeds.assign (bucket_count, 0);
+	m_slots.assign (n, 0);
+	std::vector<bool> taken (n, false);
+	std::vector<uint32_t> slots;
+
+	for (auto b : order)
+	{
+		auto const & keys = buckets[b];
+		if (keys.empty())
+			break;
+
+		bool placed = false;
+		for (uint32_t seed = 0; seed < gc_MaxSeedTries && !placed; ++seed)
+		{
+			slots.clear ();
+			placed = true;
+			for (auto k : keys)
+			{
+				auto slot = FastRange (SeededMix (hashes[k], seed), n);
+				if (taken[slot] || slots.end() != std::find (slots.begin(), slots.end(), slot))
+				{
+					placed = false;
+					break;
+				}
+				slots.push_back (slot);
+			}
+
+			if (placed)
+			{
+				m_seeds[b] = seed;
+				for (size_t i = 0; i < keys.size(); ++i)
+				{
+					taken[slots[i]] = true;
+					m_slots[slots[i]] = keys[i];
+				}
+			}
+		}
+
+		if (!placed)
+			return false;
+	}
+
+	return true;
+}
+
 //----------------------------------------------------------------------
 //======================================================================
 //======================================================================
 
+namespace details {
+	// Readers inside a ReadSection, by epoch parity. One per cache line, and
+	// threads spread over them, so readers don't fight over one counter.
+	struct ReaderShard
+	{
+		std::atomic<uint32_t> count [2];
+		Byte padding [gc_CacheLineSize - 2 * sizeof(std::atomic<uint32_t>)];
+	};
+}
+
+//----------------------------------------------------------------------
+
+	namespace {
+
+unsigned const gc_ReaderShards = 64;
+
+std::atomic<unsigned> g_next_reader_shard {0};
+thread_local unsigned t_reader_shard = g_next_reader_shard++ % gc_ReaderShards;
+
+// What interned types are filed under. updateHash() leaves field names out,
+// so they're mixed in here; equal structures always get equal hashes.
+uint64_t InternHash (Type const * type)
+{
+	Hasher h;
+	type->updateHash (h);
+	if (type->isDyStruct())
+		for (SizeType i = 0, e = type->asDyStruct()->getFieldCount(); i < e; ++i)
+			h.updateString (type->asDyStruct()->getField(i).name.c_str());
+	return h.finalize64AndReset ();
+}
+
+bool SamePoolOptions (CompileOptions const & a, CompileOptions const & b)
+{
+	return a.pool_cache_line_slots == b.pool_cache_line_slots && a.pool_thread_cache == b.pool_thread_cache;
+}
+
+	}	// namespace
+
+//----------------------------------------------------------------------
+
+/// A reader's hold on the current name snapshot. Entering bumps this thread's
+/// counter for the current epoch before the snapshot is loaded; leaving drops
+/// it. Everything is seq_cst, so a writer that has published a new snapshot
+/// and then finds a counter at zero knows that anyone who bumps it later will
+/// load the new one.
+class TypeManager::ReadSection
+{
+public:
+	explicit ReadSection (TypeManager const & tm)
+		: m_counter {&tm.m_readers[t_reader_shard].count[tm.m_epoch.load () & 1]}
+	{
+		m_counter->fetch_add (1);
+		m_names = tm.m_snapshot.load ();
+	}
+
+	~ReadSection ()
+	{
+		m_counter->fetch_sub (1, std::memory_order_release);
+	}
+
+	ReadSection (ReadSection const &) = delete;
+	ReadSection & operator = (ReadSection const &) = delete;
+
+	NameContainer const & names () const {return *m_names;}
+
+private:
+	std::atomic<uint32_t> * m_counter;
+	NameContainer const * m_names;
+};
+
+//----------------------------------------------------------------------
+
 TypeManager::TypeManager ()
-	: m_raw_types {}
+	: m_lock {}
+	, m_raw_types {}
 	, m_compiled_types {}
+	, m_retired {}
+	, m_interned {}
+	, m_interned_compiled {}
 	, m_names {}
+	, m_snapshot {new NameContainer}
+	, m_epoch {0}
+	, m_readers {static_cast<details::ReaderShard *>(details::AlignedAlloc (gc_ReaderShards * sizeof(details::ReaderShard), details::gc_CacheLineSize))}
+	, m_string_pool {new StringPool}
 {
+	assert (m_readers);
+	for (unsigned i = 0; i < gc_ReaderShards; ++i)
+	{
+		new (m_readers + i) details::ReaderShard;
+		m_readers[i].count[0].store (0, std::memory_order_relaxed);
+		m_readers[i].count[1].store (0, std::memory_order_relaxed);
+	}
 }
 
 //----------------------------------------------------------------------
@@ -161,17 +484,47 @@ TypeManager::TypeManager ()
 TypeManager::~TypeManager ()
 {
 	clear ();
+
+	delete m_snapshot.load ();
+	details::AlignedFree (m_readers);
 }
 
 //----------------------------------------------------------------------
 
-void TypeManager::clear ()
+void TypeManager::publishNames (std::vector<CompiledType *> const & doomed)
 {
-	m_names.clear ();
+	auto old = m_snapshot.exchange (new NameContainer {m_names});
+
+	// Twice, flipping the epoch each time: the first wait catches the readers
+	// who entered under the old epoch, the second anyone who read the epoch
+	// just before the first flip but only got to bump its counter after.
+	for (int phase = 0; phase < 2; ++phase)
+	{
+		auto parity = m_epoch.fetch_add (1) & 1;
+		for (unsigned i = 0; i < gc_ReaderShards; ++i)
+			while (0 != m_readers[i].count[parity].load ())
+				std::this_thread::yield ();
+	}
 
-	for (auto & c : m_compiled_types)
+	delete old;
+	for (auto c : doomed)
 		delete c;
+}
+
+//----------------------------------------------------------------------
+
+void TypeManager::clear ()
+{
+	std::lock_guard<std::mutex> guard {m_lock};
+
+	m_names.clear ();
+	std::vector<CompiledType *> doomed (m_compiled_types.begin(), m_compiled_types.end());
+	doomed.insert (doomed.end(), m_retired.begin(), m_retired.end());
+	publishNames (doomed);
 	m_compiled_types.clear ();
+	m_retired.clear ();
+	m_interned_compiled.clear ();
+	m_interned.clear ();
 	
 	for (auto & t : m_raw_types)
 		delete t;
@@ -182,10 +535,18 @@ void TypeManager::clear ()
 
 bool TypeManager::destroyType (Type * type)
 {
+	std::lock_guard<std::mutex> guard {m_lock};
+
 	auto i = m_raw_types.find (type);
 	if (m_raw_types.end() == i)
 		return false;
 
+	auto j = findInterned (type);
+	if (m_interned.end() != j)
+		m_interned.erase (j);
+	// Or a later type at the same address would be handed this one's CompiledType
+	m_interned_compiled.erase (type);
+
 	delete *i;
 	m_raw_types.erase (i);
 	return true;
@@ -195,22 +556,155 @@ bool TypeManager::destroyType (Type * type)
 
 bool TypeManager::hasType (Type * type) const
 {
+	std::lock_guard<std::mutex> guard {m_lock};
 	return m_raw_types.end() != m_raw_types.find(type);
 }
 
 //----------------------------------------------------------------------
 
-CompiledType * TypeManager::compile (Type * type, Name const & name)
+std::unordered_multimap<uint64_t, Type *>::const_iterator TypeManager::findInterned (Type const * type) const
 {
+	if (m_interned.empty())		// Don't hash anything if nobody interns
+		return m_interned.end();
+
+	auto range = m_interned.equal_range (InternHash (type));
+	for (auto i = range.first; i != range.second; ++i)
+		if (i->second == type)
+			return i;
+	return m_interned.end();
+}
+
+//----------------------------------------------------------------------
+
+Type * TypeManager::intern (Type * type)
+{
+	std::lock_guard<std::mutex> guard {m_lock};
+
+	if (nullptr == type || m_raw_types.end() == m_raw_types.find (type))
+		return nullptr;
+
+	// A duplicate stays alive; other types (and the caller) may point at it
+	auto hash = InternHash (type);
+	auto range = m_interned.equal_range (hash);
+	for (auto i = range.first; i != range.second; ++i)
+		if (i->second == type || SameStructure (i->second, type))
+			return i->second;
+
+	m_interned.emplace (hash, type);
+	return type;
+}
+
+//----------------------------------------------------------------------
+
+bool TypeManager::isInterned (Type const * type) const
+{
+	std::lock_guard<std::mutex> guard {m_lock};
+
+	// Only look at types we own; findInterned() hashes it
+	if (m_raw_types.end() == m_raw_types.find (const_cast<Type *>(type)))
+		return false;
+	return m_interned.end() != findInterned (type);
+}
+
+//----------------------------------------------------------------------
+
+bool TypeManager::SameStructure (Type const * a, Type const * b)
+{
+	if (a == b)
+		return true;
+	if (a->getFamily() != b->getFamily() || a->getSizeOf() != b->getSizeOf() || a->getAlignment() != b->getAlignment())
+		return false;
+
+	switch (a->getFamily())
+	{
+	case Family::Basic:
+		return a->asBasic()->getType() == b->asBasic()->getType();
+
+	case Family::Enum:
+		return a->asEnum()->getUnderlyingType() == b->asEnum()->getUnderlyingType()
+			&& a->asEnum()->getNameValues() == b->asEnum()->getNameValues();
+
+	case Family::Array:
+		return a->getElemCount() == b->getElemCount() && SameStructure (a->asArray()->getElemType(), b->asArray()->getElemType());
+
+	case Family::DyStruct: {
+		auto sa = a->asDyStruct();
+		auto sb = b->asDyStruct();
+		if (sa->getFieldCount() != sb->getFieldCount())
+			return false;
+		for (SizeType i = 0, e = sa->getFieldCount(); i < e; ++i)
+		{
+			auto const & fa = sa->getField(i);
+			auto const & fb = sb->getField(i);
+			if (fa.offset != fb.offset || fa.name != fb.name || !SameStructure (fa.type, fb.type))
+				return false;
+		}
+		return true;
+	}
+
+	case Family::String:
+		return a->asString()->getInlineCapacity() == b->asString()->getInlineCapacity()
+			&& a->asString()->isInterned() == b->asString()->isInterned()
+			&& (!a->asString()->isInterned() || &a->asString()->getPool() == &b->asString()->getPool());
+
+	case Family::Vector:
+		return SameStructure (a->asVector()->getElemType(), b->asVector()->getElemType());
+
+	case Family::Set:
+		return SameStructure (a->asSet()->getKeyType(), b->asSet()->getKeyType());
+
+	case Family::Map:
+		return SameStructure (a->asMap()->getKeyType(), b->asMap()->getKeyType())
+			&& SameStructure (a->asMap()->getValueType(), b->asMap()->getValueType());
+
+	default:
+		return false;
+	}
+}
+
+//----------------------------------------------------------------------
+
+CompiledType * TypeManager::compile (Type * type, Name const & name, CompileOptions const & options)
+{
+	std::lock_guard<std::mutex> guard {m_lock};
+
 	if (m_names.find(name) != m_names.end())	// Name already exists
 		return nullptr;
+	if (!PrepareContainers (type))
+		return nullptr;
 
-	auto ret = new CompiledType {type, name};
+	// Reorder a copy: the type may already be compiled, or be a field of
+	// something else, and those must keep the layout they have
+	SizeType reorder_savings = 0;
+	if (options.reorder_fields && type->isDyStruct())
+	{
+		auto copy = static_cast<DyStructType *>(type->clone ());
+		reorder_savings = copy->reorderFields ();
+		m_raw_types.insert (copy);
+		type = copy;
+	}
+
+	bool share = options.share_interned && m_interned.end() != findInterned (type);
+	if (share)
+	{
+		auto i = m_interned_compiled.find (type);
+		if (m_interned_compiled.end() != i && SamePoolOptions (i->second->m_options, options))
+		{
+			m_names[name] = i->second;
+			publishNames ();
+			return i->second;
+		}
+	}
+
+	auto ret = new CompiledType {type, name, reorder_savings, options};
 
 	if (ret)
 	{
 		m_compiled_types.insert (ret);
 		m_names[name] = ret;
+		if (share)
+			m_interned_compiled.emplace (type, ret);
+		publishNames ();
 	}
 
 	return ret;
@@ -218,15 +712,61 @@ CompiledType * TypeManager::compile (Type * type, Name const & name)
 
 //----------------------------------------------------------------------
 
+bool TypeManager::PrepareContainers (Type * type)
+{
+	switch (type->getFamily())
+	{
+	case Family::Array:
+		return PrepareContainers (type->asArray()->m_element_type);
+
+	case Family::DyStruct: {
+		auto st = type->asDyStruct();
+		for (SizeType i = 0, e = st->getFieldCount(); i < e; ++i)
+			if (!PrepareContainers (st->m_fields[i].type))
+				return false;
+		return true;
+	}
+
+	case Family::Vector: {
+		auto vt = type->asVector();
+		return PrepareContainers (vt->m_element_type) && vt->refreshLayout ();
+	}
+
+	case Family::Set:
+	case Family::Map: {
+		auto ht = type->asHashTable();
+		return PrepareContainers (ht->m_key_type)
+			&& (nullptr == ht->m_value_type || PrepareContainers (ht->m_value_type))
+			&& ht->refreshLayout ();
+	}
+
+	default:
+		return true;
+	}
+}
+
+//----------------------------------------------------------------------
+
 bool TypeManager::destroyCompiledType (CompiledType * cmptype)
 {
+	std::lock_guard<std::mutex> guard {m_lock};
+
 	auto i = m_compiled_types.find (cmptype);
 	if (m_compiled_types.end() == i)
 		return false;
 
-	m_names.erase ((*i)->name());
-	delete *i;
+	// Readers might still be looking at it, or hold on to what they looked up
+	for (auto j = m_names.begin(); j != m_names.end(); )
+		if (j->second == cmptype)
+			j = m_names.erase (j);
+		else
+			++j;
+	auto k = m_interned_compiled.find (cmptype->rawType());
+	if (m_interned_compiled.end() != k && k->second == cmptype)
+		m_interned_compiled.erase (k);
 	m_compiled_types.erase (i);
+	m_retired.push_back (cmptype);
+	publishNames ();
 
 	return true;
 }
@@ -235,6 +775,7 @@ bool TypeManager::destroyCompiledType (CompiledType * cmptype)
 
 bool TypeManager::hasCompiledType (CompiledType * cmptype) const
 {
+	std::lock_guard<std::mutex> guard {m_lock};
 	return m_compiled_types.end() != m_compiled_types.find(cmptype);
 }
 
@@ -242,8 +783,10 @@ bool TypeManager::hasCompiledType (CompiledType * cmptype) const
 
 CompiledType * TypeManager::getCompiledType (Name const & name) const
 {
-	auto i = m_names.find (name);
-	if (m_names.end() != i)
+	ReadSection section {*this};
+
+	auto i = section.names().find (name);
+	if (section.names().end() != i)
 		return i->second;
 	else
 		return nullptr;
@@ -253,13 +796,433 @@ CompiledType * TypeManager::getCompiledType (Name const & name) const
 
 Type const * TypeManager::getType (Name const & name) const
 {
-	auto i = m_names.find (name);
-	if (m_names.end() != i)
+	ReadSection section {*this};
+
+	auto i = section.names().find (name);
+	if (section.names().end() != i)
 		return i->second->rawType();
 	else
 		return nullptr;
 }
 
+//======================================================================
+//======================================================================
+
+	namespace {
+
+// Appends a run to the layout, merging it into the previous one if it just continues it.
+void AddLeaf (LayoutContainer & layout, LayoutLeaf const & leaf)
+{
+	if (!layout.empty())
+	{
+		auto & last = layout.back();
+		if (last.basic == leaf.basic && last.family == leaf.family && last.type == leaf.type && last.size == leaf.size
+			&& leaf.offset == last.offset + last.count * last.stride
+			&& (1 == leaf.count || leaf.stride == last.stride)
+			&& (1 != last.count || leaf.stride == last.stride))
+		{
+			last.count += leaf.count;
+			return;
+		}
+	}
+	layout.push_back (leaf);
+}
+
+//----------------------------------------------------------------------
+
+void AppendLeaves (Type const * type, OffsetType offset, LayoutContainer & layout)
+{
+	switch (type->getFamily())
+	{
+	case Family::Basic:
+		AddLeaf (layout, {offset, type->getSizeOf(), 1, type->getSizeOf(), type->asBasic()->getType(), Family::Basic, nullptr});
+		break;
+	case Family::Enum:
+		AddLeaf (layout, {offset, type->getSizeOf(), 1, type->getSizeOf(), type->asEnum()->getUnderlyingType(), Family::Basic, nullptr});
+		break;
+	case Family::String:
+		if (type->asString()->isInterned())
+			AddLeaf (layout, {offset, type->getSizeOf(), 1, type->getSizeOf(), Basic::U32, Family::Basic, nullptr});
+		else
+			AddLeaf (layout, {offset, type->getSizeOf(), 1, type->getSizeOf(), Basic::Byte, Family::String, nullptr});
+		break;
+	case Family::Vector:
+		AddLeaf (layout, {offset, type->getSizeOf(), 1, type->getSizeOf(), Basic::Byte, Family::Vector, type});
+		break;
+	case Family::Set:
+	case Family::Map:
+		AddLeaf (layout, {offset, type->getSizeOf(), 1, type->getSizeOf(), Basic::Byte, type->getFamily(), type});
+		break;
+	case Family::Array: {
+		auto elem = type->asArray()->getElemType();
+		auto elem_size = elem->getSizeOf();
+		auto count = type->getElemCount();
+		if (0 == count)
+			break;
+
+		// If an element is a single value (e.g. a DyStruct with one field) the
+		// whole array is a single strided run; otherwise, unroll it.
+		LayoutContainer elem_layout;
+		AppendLeaves (elem, 0, elem_layout);
+		if (1 == elem_layout.size() && 1 == elem_layout[0].count)
+		{
+			auto leaf = elem_layout[0];
+			leaf.offset += offset;
+			leaf.count = count;
+			leaf.stride = elem_size;
+			AddLeaf (layout, leaf);
+		}
+		else
+			for (CountType i = 0; i < count; ++i)
+				for (auto leaf : elem_layout)
+				{
+					leaf.offset += offset + i * elem_size;
+					AddLeaf (layout, leaf);
+				}
+	}	break;
+	case Family::DyStruct:
+		for (SizeType i = 0, e = type->asDyStruct()->getFieldCount(); i < e; ++i)
+		{
+			auto const & f = type->asDyStruct()->getField(i);
+			AppendLeaves (f.type, offset + f.offset, layout);
+		}
+		break;
+	default:
+		assert (false);
+		break;
+	}
+}
+
+//----------------------------------------------------------------------
+
+// The canonical bits of a float: one NaN, one zero.
+template <typename F, typename U>
+U CanonicalFloatBits (Byte const * p)
+{
+	F f;
+	std::memcpy (&f, p, sizeof(F));
+	if (std::isnan (f))
+		f = std::numeric_limits<F>::quiet_NaN ();
+	else if (0 == f)
+		f = F(0);
+
+	U ret;
+	std::memcpy (&ret, &f, sizeof(F));
+	return ret;
+}
+
+//----------------------------------------------------------------------
+
+template <typename F>
+bool FloatEqual (Byte const * a, Byte const * b)
+{
+	F fa, fb;
+	std::memcpy (&fa, a, sizeof(F));
+	std::memcpy (&fb, b, sizeof(F));
+	return fa == fb || (std::isnan (fa) && std::isnan (fb));
+}
+
+//----------------------------------------------------------------------
+
+void HashLeaves (LayoutContainer const & layout, Byte const * data, Hasher & h);
+bool EqualLeaves (LayoutContainer const & layout, Byte const * a, Byte const * b);
+
+//----------------------------------------------------------------------
+
+// Entries come in no particular order, so their hashes are summed up.
+void HashTable (HashTableType const * table, Byte const * slot, Hasher & h)
+{
+	uint64_t sum = 0;
+	Hasher value_hasher;
+	table->forEach (slot, [&] (Byte const * entry) {
+		uint64_t value_hash = 0;
+		if (table->getValueType())
+		{
+			HashLeaves (table->getValueLayout(), entry + table->getValueOffset(), value_hasher);
+			value_hash = value_hasher.finalize64AndReset ();
+		}
+		sum += details::Mum (table->hashEntry (entry) ^ details::gc_HashP2, value_hash ^ details::gc_HashP3);
+	});
+
+	h.updateUnsigned (HashTableType::HeaderOf (slot)->size);
+	h.updateUnsigned64 (sum);
+}
+
+//----------------------------------------------------------------------
+
+bool EqualTables (HashTableType const * table, Byte const * a, Byte const * b)
+{
+	auto ha = HashTableType::HeaderOf (a);
+	auto hb = HashTableType::HeaderOf (b);
+	if (ha->size != hb->size)
+		return false;
+	if (ha->ctrl == hb->ctrl)
+		return true;
+
+	bool string_keys = table->getKeyType()->isString();
+	auto value_offset = table->getValueOffset();
+	bool ret = true;
+	table->forEach (a, [&] (Byte const * entry) {
+		if (!ret)
+			return;
+
+		StringRef str;
+		void const * key = entry;
+		if (string_keys)
+		{
+			str = table->readStringKey (entry);
+			key = &str;
+		}
+
+		auto other = table->find (b, key);
+		ret = nullptr != other
+			&& (nullptr == table->getValueType() || EqualLeaves (table->getValueLayout(), entry + value_offset, other + value_offset));
+	});
+	return ret;
+}
+
+//----------------------------------------------------------------------
+
+void HashLeaves (LayoutContainer const & layout, Byte const * data, Hasher & h)
+{
+	for (auto const & leaf : layout)
+	{
+		auto p = data + leaf.offset;
+		if (Family::String == leaf.family)
+			for (CountType i = 0; i < leaf.count; ++i)
+			{
+				auto str = StringType::ReadSlot (p + i * leaf.stride, leaf.size);
+				h.updateUnsigned (uint32_t(str.size));
+				h.update (str.data, str.size);
+			}
+		else if (Family::Vector == leaf.family)
+		{
+			auto vt = leaf.type->asVector();
+			auto elem_size = vt->getElemSize();
+			for (CountType i = 0; i < leaf.count; ++i)
+			{
+				auto header = VectorType::HeaderOf (p + i * leaf.stride);
+				h.updateUnsigned (header->size);
+				if (vt->isElemBytewise())
+					h.update (header->data, size_t(header->size) * elem_size);
+				else
+					for (uint32_t j = 0; j < header->size; ++j)
+						HashLeaves (vt->getElemLayout(), header->data + size_t(j) * elem_size, h);
+			}
+		}
+		else if (Family::Set == leaf.family || Family::Map == leaf.family)
+			for (CountType i = 0; i < leaf.count; ++i)
+				HashTable (leaf.type->asHashTable(), p + i * leaf.stride, h);
+		else if (Basic::F32 == leaf.basic)
+			for (CountType i = 0; i < leaf.count; ++i)
+				h.updateUnsigned (CanonicalFloatBits<float, uint32_t> (p + i * leaf.stride));
+		else if (Basic::F64 == leaf.basic)
+			for (CountType i = 0; i < leaf.count; ++i)
+				h.updateUnsigned64 (CanonicalFloatBits<double, uint64_t> (p + i * leaf.stride));
+		else if (leaf.stride == leaf.size)
+			h.update (p, leaf.count * leaf.size);
+		else
+			for (CountType i = 0; i < leaf.count; ++i)
+				h.update (p + i * leaf.stride, leaf.size);
+	}
+}
+
+//----------------------------------------------------------------------
+
+bool EqualLeaves (LayoutContainer const & layout, Byte const * a, Byte const * b)
+{
+	for (auto const & leaf : layout)
+	{
+		auto pa = a + leaf.offset;
+		auto pb = b + leaf.offset;
+		if (Family::String == leaf.family)
+		{
+			for (CountType i = 0; i < leaf.count; ++i)
+				if (StringType::ReadSlot (pa + i * leaf.stride, leaf.size) != StringType::ReadSlot (pb + i * leaf.stride, leaf.size))
+					return false;
+		}
+		else if (Family::Vector == leaf.family)
+		{
+			auto vt = leaf.type->asVector();
+			auto elem_size = vt->getElemSize();
+			for (CountType i = 0; i < leaf.count; ++i)
+			{
+				auto ha = VectorType::HeaderOf (pa + i * leaf.stride);
+				auto hb = VectorType::HeaderOf (pb + i * leaf.stride);
+				if (ha->size != hb->size)
+					return false;
+				if (ha->data == hb->data || 0 == ha->size)
+					continue;
+				if (vt->isElemBytewise())
+				{
+					if (0 != std::memcmp (ha->data, hb->data, size_t(ha->size) * elem_size))
+						return false;
+				}
+				else
+					for (uint32_t j = 0; j < ha->size; ++j)
+						if (!EqualLeaves (vt->getElemLayout(), ha->data + size_t(j) * elem_size, hb->data + size_t(j) * elem_size))
+							return false;
+			}
+		}
+		else if (Family::Set == leaf.family || Family::Map == leaf.family)
+		{
+			for (CountType i = 0; i < leaf.count; ++i)
+				if (!EqualTables (leaf.type->asHashTable(), pa + i * leaf.stride, pb + i * leaf.stride))
+					return false;
+		}
+		else if (Basic::F32 == leaf.basic)
+		{
+			for (CountType i = 0; i < leaf.count; ++i)
+				if (!FloatEqual<float> (pa + i * leaf.stride, pb + i * leaf.stride))
+					return false;
+		}
+		else if (Basic::F64 == leaf.basic)
+		{
+			for (CountType i = 0; i < leaf.count; ++i)
+				if (!FloatEqual<double> (pa + i * leaf.stride, pb + i * leaf.stride))
+					return false;
+		}
+		else if (leaf.stride == leaf.size)
+		{
+			if (0 != std::memcmp (pa, pb, leaf.count * leaf.size))
+				return false;
+		}
+		else
+			for (CountType i = 0; i < leaf.count; ++i)
+				if (0 != std::memcmp (pa + i * leaf.stride, pb + i * leaf.stride, leaf.size))
+					return false;
+	}
+	return true;
+}
+
+	}	// namespace
+
+//----------------------------------------------------------------------
+
+LayoutContainer details::FlattenLayout (Type const * type)
+{
+	LayoutContainer ret;
+	AppendLeaves (type, 0, ret);
+	ret.shrink_to_fit ();
+	return ret;
+}
+
+//----------------------------------------------------------------------
+
+bool details::IsBytewise (LayoutContainer const & layout, SizeType size)
+{
+	SizeType leaf_bytes = 0;
+	for (auto const & leaf : layout)
+	{
+		if (Family::Basic != leaf.family || details::gc_BasicTraits[int(leaf.basic)].is_float)
+			return false;
+		leaf_bytes += leaf.count * leaf.size;
+	}
+
+	return leaf_bytes == size;
+}
+
+//----------------------------------------------------------------------
+
+bool CompiledType::CalculateBytewise () const
+{
+	return details::IsBytewise (m_layout, m_size);
+}
+
+//----------------------------------------------------------------------
+
+ResolvedPath CompiledType::resolvePath (std::string const & path) const
+{
+	ResolvedPath ret;
+	Type const * type = m_type;
+	OffsetType offset = 0;
+	size_t i = 0, n = path.size();
+
+	while (i < n)
+	{
+		if ('[' == path[i])
+		{
+			if (!type->isArray())
+				return ResolvedPath {};
+
+			auto elem_size = type->asArray()->getElemType()->getSizeOf();
+			if (++i < n && '*' == path[i])
+			{
+				if (0 != ret.stride)		// Only one [*] per path
+					return ResolvedPath {};
+				ret.stride = elem_size;
+				ret.count = type->getElemCount();
+				++i;
+			}
+			else
+			{
+				uint64_t index = 0;
+				auto digits = i;
+				for (; i < n && path[i] >= '0' && path[i] <= '9' && index < type->getElemCount(); ++i)
+					index = index * 10 + (path[i] - '0');
+				if (digits == i || index >= type->getElemCount())
+					return ResolvedPath {};
+				offset += OffsetType(index) * elem_size;
+			}
+
+			if (i >= n || ']' != path[i])
+				return ResolvedPath {};
+			++i;
+			type = type->asArray()->getElemType();
+		}
+		else
+		{
+			if (0 != i && '.' != path[i++])
+				return ResolvedPath {};
+			if (!type->isDyStruct())
+				return ResolvedPath {};
+
+			auto name_end = std::min (path.find_first_of (".[", i), n);
+			std::string name {path, i, name_end - i};
+			auto field = (type == m_type) ? m_field_index.find (name) : type->asDyStruct()->findField (name);
+			if (nullptr == field)
+				return ResolvedPath {};
+
+			offset += field->offset;
+			type = field->type;
+			i = name_end;
+		}
+	}
+
+	ret.type = type;
+	ret.offset = offset;
+	return ret;
+}
+
+//----------------------------------------------------------------------
+
+uint64_t CompiledType::hashInstance (InstancePtr inst) const
+{
+	assert (inst.typePtr() == this && !inst.isNull());
+
+	Hasher h;
+	if (m_bytewise)
+		h.update (inst.data(), m_size);
+	else
+		HashLeaves (m_layout, inst.data(), h);
+
+	return h.finalize64AndReset ();
+}
+
+//----------------------------------------------------------------------
+
+bool CompiledType::equals (InstancePtr a, InstancePtr b) const
+{
+	assert (a.typePtr() == this && !a.isNull());
+	assert (b.typePtr() == this && !b.isNull());
+
+	if (a.data() == b.data())
+		return true;
+	if (m_bytewise)
+		return 0 == std::memcmp (a.data(), b.data(), m_size);
+	return EqualLeaves (m_layout, a.data(), b.data());
+}
+
 //----------------------------------------------------------------------
 //======================================================================
 
@@ -0,0 +1,459 @@
+//======================================================================
+
+#include <dystruct/HashTable.h>
+#include <dystruct/String.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// Control bytes are matched a group at a time; SSE2 does a whole group in a
+// couple of instructions, and every x64 compiler assumes it.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#define DYSTRUCT_TABLE_SSE2 1
+	#include <emmintrin.h>
+#else
+	#define DYSTRUCT_TABLE_SSE2 0
+#endif
+
+#if defined(_MSC_VER)
+	#include <intrin.h>
+#endif
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+	namespace {
+
+//======================================================================
+
+static_assert (HashTableType::GroupWidth == 16, "A group is one SSE2 register");
+
+//----------------------------------------------------------------------
+
+inline unsigned LowestBit (uint32_t mask)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return unsigned(__builtin_ctz (mask));
+#elif defined(_MSC_VER)
+	unsigned long ret;
+	_BitScanForward (&ret, mask);
+	return unsigned(ret);
+#else
+	unsigned ret = 0;
+	while (0 == (mask & 1))
+	{
+		mask >>= 1;
+		++ret;
+	}
+	return ret;
+#endif
+}
+
+//----------------------------------------------------------------------
+
+// The control bytes of one group; the matches are bit masks, bit i for entry i.
+class Group
+{
+public:
+#if DYSTRUCT_TABLE_SSE2
+	explicit Group (Byte const * ctrl) : m_ctrl {_mm_load_si128 (reinterpret_cast<__m128i const *>(ctrl))} {}
+
+	uint32_t match (Byte h2) const {return uint32_t(_mm_movemask_epi8 (_mm_cmpeq_epi8 (m_ctrl, _mm_set1_epi8 (char(h2)))));}
+	uint32_t matchEmpty () const {return match (HashTableType::CtrlEmpty);}
+	uint32_t matchEmptyOrDeleted () const {return uint32_t(_mm_movemask_epi8 (m_ctrl));}	// Both have the top bit set
+
+private:
+	__m128i m_ctrl;
+#else
+	explicit Group (Byte const * ctrl) : m_ctrl {ctrl} {}
+
+	uint32_t match (Byte h2) const
+	{
+		uint32_t ret = 0;
+		for (unsigned i = 0; i < HashTableType::GroupWidth; ++i)
+			ret |= uint32_t(m_ctrl[i] == h2) << i;
+		return ret;
+	}
+
+	uint32_t matchEmpty () const {return match (HashTableType::CtrlEmpty);}
+
+	uint32_t matchEmptyOrDeleted () const
+	{
+		uint32_t ret = 0;
+		for (unsigned i = 0; i < HashTableType::GroupWidth; ++i)
+			ret |= uint32_t(m_ctrl[i] >> 7) << i;
+		return ret;
+	}
+
+private:
+	Byte const * m_ctrl;
+#endif
+};
+
+//----------------------------------------------------------------------
+
+// At most 7/8 full; past that, probe sequences get long.
+inline uint32_t MaxLoad (uint32_t capacity)
+{
+	return capacity - capacity / 8;
+}
+
+//----------------------------------------------------------------------
+
+inline uint64_t MixBits (uint64_t bits)
+{
+	return details::Mum (bits ^ details::gc_HashP0, details::gc_HashP1);
+}
+
+//----------------------------------------------------------------------
+
+inline uint64_t HashChars (StringRef str)
+{
+	Hasher h;
+	h.update (str.data, str.size);
+	return h.finalize64AndReset ();
+}
+
+//----------------------------------------------------------------------
+
+SizeType EntryAlign (Type const * key_type, Type const * value_type)
+{
+	return std::max (key_type->getAlignment(), value_type ? value_type->getAlignment() : SizeType(1));
+}
+
+//----------------------------------------------------------------------
+
+SizeType ValueOffset (Type const * key_type, Type const * value_type)
+{
+	return value_type ? details::AlignUp (key_type->getSizeOf(), value_type->getAlignment()) : key_type->getSizeOf();
+}
+
+//======================================================================
+
+	}	// namespace
+
+//======================================================================
+//======================================================================
+
+HashTableType::HashTableType (Family family, Type * key_type, Type * value_type)
+	: Type {family}
+	, m_key_type {key_type}
+	, m_value_type {value_type}
+	, m_key_size {0}
+	, m_value_offset {0}
+	, m_entry_size {0}
+	, m_entry_align {1}
+	, m_key_kind {KeyKind::Bits}
+	, m_value_layout {}
+	, m_value_bytewise {true}
+{
+	assert (m_key_type->isBasic() || m_key_type->isEnum() || m_key_type->isString());
+	refreshLayout ();
+
+	if (m_key_type->isString())
+		m_key_kind = m_key_type->asString()->isInterned() ? KeyKind::InternedString : KeyKind::String;
+	else if (m_key_type->isBasic() && Basic::F32 == m_key_type->asBasic()->getType())
+		m_key_kind = KeyKind::F32;
+	else if (m_key_type->isBasic() && Basic::F64 == m_key_type->asBasic()->getType())
+		m_key_kind = KeyKind::F64;
+}
+
+//----------------------------------------------------------------------
+
+bool HashTableType::refreshLayout ()
+{
+	// Only write if something changed; other threads may be reading these
+	auto update = [] (SizeType & member, SizeType value) {if (member != value) member = value;};
+	update (m_key_size, m_key_type->getSizeOf());
+	update (m_value_offset, ValueOffset (m_key_type, m_value_type));
+	update (m_entry_align, EntryAlign (m_key_type, m_value_type));
+	update (m_entry_size, details::AlignUp (m_value_offset + (m_value_type ? m_value_type->getSizeOf() : 0), m_entry_align));
+
+	if (nullptr == m_value_type)
+		return true;
+
+	auto layout = details::FlattenLayout (m_value_type);
+	auto bytewise = details::IsBytewise (layout, m_value_type->getSizeOf());
+	if (layout != m_value_layout)
+		m_value_layout = std::move(layout);
+	if (bytewise != m_value_bytewise)
+		m_value_bytewise = bytewise;
+
+	return m_value_type->isTriviallyCopyable() && m_value_type->isTriviallyDestructible();
+}
+
+//----------------------------------------------------------------------
+
+inline uint64_t HashTableType::keyBits (void const * key) const
+{
+	uint64_t ret = 0;
+	switch (m_key_kind)
+	{
+	case KeyKind::F32: {
+		float f;
+		std::memcpy (&f, key, sizeof(f));
+		if (std::isnan (f))
+			f = std::numeric_limits<float>::quiet_NaN ();
+		else if (0 == f)
+			f = 0.0f;
+		std::memcpy (&ret, &f, sizeof(f));
+	}	break;
+	case KeyKind::F64: {
+		double d;
+		std::memcpy (&d, key, sizeof(d));
+		if (std::isnan (d))
+			d = std::numeric_limits<double>::quiet_NaN ();
+		else if (0 == d)
+			d = 0.0;
+		std::memcpy (&ret, &d, sizeof(d));
+	}	break;
+	default:
+		std::memcpy (&ret, key, m_key_size);
+		break;
+	}
+	return ret;
+}
+
+//----------------------------------------------------------------------
+
+inline uint64_t HashTableType::hashKey (void const * key) const
+{
+	if (KeyKind::String == m_key_kind || KeyKind::InternedString == m_key_kind)
+		return HashChars (*static_cast<StringRef const *>(key));
+	return MixBits (keyBits (key));
+}
+
+//----------------------------------------------------------------------
+
+inline bool HashTableType::keyEquals (Byte const * entry, void const * key) const
+{
+	if (KeyKind::String == m_key_kind || KeyKind::InternedString == m_key_kind)
+		return readStringKey (entry) == *static_cast<StringRef const *>(key);
+	return keyBits (entry) == keyBits (key);
+}
+
+//----------------------------------------------------------------------
+
+StringRef HashTableType::readStringKey (Byte const * entry) const
+{
+	assert (m_key_type->isString());
+	if (KeyKind::String == m_key_kind)
+		return StringType::ReadSlot (entry, m_key_size);
+	return m_key_type->asString()->read (entry);
+}
+
+//----------------------------------------------------------------------
+
+uint64_t HashTableType::hashEntry (Byte const * entry) const
+{
+	if (KeyKind::String == m_key_kind || KeyKind::InternedString == m_key_kind)
+		return HashChars (readStringKey (entry));
+	return MixBits (keyBits (entry));
+}
+
+//----------------------------------------------------------------------
+
+// Groups are probed in triangular steps (1, 2, 3...), which visits all of
+// them since their count is a power of two. A group with an empty entry ends
+// the search: an insert would have stopped there.
+Byte const * HashTableType::findIn (Header const * h, void const * key, uint64_t hash) const
+{
+	if (0 == h->size)
+		return nullptr;
+
+	auto h2 = Byte(hash & 0x7F);
+	Byte const * entries = EntriesOf (h->ctrl, h->capacity, m_entry_align);
+	auto group_mask = h->capacity / GroupWidth - 1;
+	auto g = uint32_t(hash >> 7) & group_mask;
+	for (uint32_t step = 1; step <= group_mask + 1; ++step)
+	{
+		Group group {h->ctrl + size_t(g) * GroupWidth};
+		for (auto m = group.match (h2); 0 != m; m &= m - 1)
+		{
+			auto e = entries + (size_t(g) * GroupWidth + LowestBit (m)) * m_entry_size;
+			if (keyEquals (e, key))
+				return e;
+		}
+		if (0 != group.matchEmpty ())
+			return nullptr;
+		g = (g + step) & group_mask;
+	}
+	return nullptr;
+}
+
+//----------------------------------------------------------------------
+
+Byte const * HashTableType::find (Byte const * slot, void const * key) const
+{
+	auto h = HeaderOf (slot);
+	if (0 == h->size)
+		return nullptr;
+	return findIn (h, key, hashKey (key));
+}
+
+//----------------------------------------------------------------------
+
+Byte * HashTableType::claim (Header * h, uint64_t hash) const
+{
+	auto entries = EntriesOf (h->ctrl, h->capacity, m_entry_align);
+	auto group_mask = h->capacity / GroupWidth - 1;
+	auto g = uint32_t(hash >> 7) & group_mask;
+	for (uint32_t step = 1; step <= group_mask + 1; ++step)
+	{
+		auto m = Group {h->ctrl + size_t(g) * GroupWidth}.matchEmptyOrDeleted ();
+		if (0 != m)
+		{
+			auto i = size_t(g) * GroupWidth + LowestBit (m);
+			if (CtrlEmpty == h->ctrl[i])
+				--h->growth_left;
+			h->ctrl[i] = Byte(hash & 0x7F);
+			++h->size;
+			return entries + i * m_entry_size;
+		}
+		g = (g + step) & group_mask;
+	}
+
+	assert (false);		// Can't happen; MaxLoad() keeps some entries empty
+	return nullptr;
+}
+
+//----------------------------------------------------------------------
+
+Byte * HashTableType::insert (Byte * slot, void const * key, Arena & arena, bool * inserted) const
+{
+	if (inserted)
+		*inserted = false;
+
+	auto h = HeaderOf (slot);
+	auto hash = hashKey (key);
+	if (auto found = findIn (h, key, hash))
+		return const_cast<Byte *>(found);
+
+	if (0 == h->growth_left)
+	{
+		// Double, unless it's mostly deleted entries that can just be cleaned out
+		uint32_t capacity = std::max (h->capacity, uint32_t(GroupWidth));
+		if (0 != h->capacity && h->size >= MaxLoad (h->capacity) / 2)
+		{
+			if (capacity > std::numeric_limits<uint32_t>::max() / 2)
+				return nullptr;
+			capacity *= 2;
+		}
+		if (!rehash (h, capacity, arena))
+			return nullptr;
+	}
+
+	auto e = claim (h, hash);
+	std::memset (e, 0, m_entry_size);
+	if (KeyKind::String == m_key_kind || KeyKind::InternedString == m_key_kind)
+	{
+		auto str = static_cast<StringRef const *>(key);
+		if (!m_key_type->asString()->write (e, str->data, str->size))
+		{
+			// The entry is gone again; deleted is always a safe state for it
+			h->ctrl[(e - EntriesOf (h->ctrl, h->capacity, m_entry_align)) / m_entry_size] = CtrlDeleted;
+			--h->size;
+			return nullptr;
+		}
+	}
+	else
+		std::memcpy (e, key, m_key_size);
+
+	if (m_value_type && !m_value_type->isTriviallyConstructible())
+		m_value_type->construct (e + m_value_offset, m_value_type->getSizeOf());
+
+	if (inserted)
+		*inserted = true;
+	return e;
+}
+
+//----------------------------------------------------------------------
+
+bool HashTableType::erase (Byte * slot, void const * key) const
+{
+	auto h = HeaderOf (slot);
+	auto e = findIn (h, key, hashKey (key));
+	if (nullptr == e)
+		return false;
+
+	// If the entry's group has an empty entry, no probe ever went past it, so
+	// this entry can be made empty too; otherwise it has to stay as a marker.
+	auto i = size_t(e - EntriesOf (h->ctrl, h->capacity, m_entry_align)) / m_entry_size;
+	if (0 != Group {h->ctrl + (i & ~size_t(GroupWidth - 1))}.matchEmpty ())
+	{
+		h->ctrl[i] = CtrlEmpty;
+		++h->growth_left;
+	}
+	else
+		h->ctrl[i] = CtrlDeleted;
+	--h->size;
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+bool HashTableType::reserve (Byte * slot, size_t count, Arena & arena) const
+{
+	auto h = HeaderOf (slot);
+	if (count <= size_t(h->size) + h->growth_left)
+		return true;
+
+	uint32_t capacity = GroupWidth;
+	while (MaxLoad (capacity) < count)
+	{
+		if (capacity > std::numeric_limits<uint32_t>::max() / 2)
+			return false;
+		capacity *= 2;
+	}
+	return rehash (h, capacity, arena);
+}
+
+//----------------------------------------------------------------------
+
+void HashTableType::clear (Byte * slot) const
+{
+	auto h = HeaderOf (slot);
+	if (0 == h->capacity)
+		return;
+
+	std::memset (h->ctrl, CtrlEmpty, h->capacity);
+	h->size = 0;
+	h->growth_left = MaxLoad (h->capacity);
+}
+
+//----------------------------------------------------------------------
+
+bool HashTableType::rehash (Header * h, uint32_t capacity, Arena & arena) const
+{
+	assert (capacity >= GroupWidth && 0 == (capacity & (capacity - 1)));
+
+	size_t ctrl_bytes = details::AlignUp (capacity, m_entry_align);
+	if (size_t(capacity) > (std::numeric_limits<size_t>::max() - ctrl_bytes) / m_entry_size)
+		return false;
+
+	// Control bytes are loaded a group at a time, so the block is aligned for that
+	auto block = static_cast<Byte *>(arena.allocate (ctrl_bytes + size_t(capacity) * m_entry_size, std::max<size_t> (m_entry_align, GroupWidth)));
+	if (nullptr == block)
+		return false;
+	std::memset (block, CtrlEmpty, capacity);
+
+	Header fresh {block, 0, capacity, MaxLoad (capacity)};
+	forEach (reinterpret_cast<Byte const *>(h), [&] (Byte const * entry) {
+		std::memcpy (claim (&fresh, hashEntry (entry)), entry, m_entry_size);
+	});
+
+	// The old block stays with the arena
+	*h = fresh;
+	return true;
+}
+
+//======================================================================
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================
@@ -0,0 +1,283 @@
+//======================================================================
+
+#include <dystruct/InstanceArray.h>
+
+#include <algorithm>
+#include <cstring>
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+InstanceArray::InstanceArray (CompiledType const * ctype)
+	: m_ctype (ctype)
+	, m_stride (ctype->sizeOf())
+	, m_size (0)
+	, m_capacity (0)
+	, m_data (nullptr)
+	, m_arena ()
+{
+	assert (m_ctype);
+}
+
+//----------------------------------------------------------------------
+
+InstanceArray::InstanceArray (CompiledType const * ctype, size_t count)
+	: InstanceArray (ctype)
+{
+	resize (count);
+}
+
+//----------------------------------------------------------------------
+
+InstanceArray::~InstanceArray ()
+{
+	clear ();
+	details::AlignedFree (m_data);
+}
+
+//----------------------------------------------------------------------
+
+InstanceArray::InstanceArray (InstanceArray && that)
+	: m_ctype (that.m_ctype)
+	, m_stride (that.m_stride)
+	, m_size (that.m_size)
+	, m_capacity (that.m_capacity)
+	, m_data (that.m_data)
+	, m_arena (std::move(that.m_arena))
+{
+	that.m_size = 0;
+	that.m_capacity = 0;
+	that.m_data = nullptr;
+}
+
+//----------------------------------------------------------------------
+
+InstanceArray & InstanceArray::operator = (InstanceArray && that)
+{
+	if (this != &that)
+	{
+		clear ();
+		details::AlignedFree (m_data);
+
+		m_ctype = that.m_ctype;
+		m_stride = that.m_stride;
+		m_size = that.m_size;
+		m_capacity = that.m_capacity;
+		m_data = that.m_data;
+		m_arena = std::move(that.m_arena);
+
+		that.m_size = 0;
+		that.m_capacity = 0;
+		that.m_data = nullptr;
+	}
+	return *this;
+}
+
+//----------------------------------------------------------------------
+
+bool InstanceArray::reserve (size_t count)
+{
+	if (count <= m_capacity)
+		return true;
+
+	return reallocate (count);
+}
+
+//----------------------------------------------------------------------
+
+bool InstanceArray::resize (size_t count)
+{
+	if (count < m_size)
+	{
+		destructRange (count, m_size);
+		m_size = count;
+		return true;
+	}
+
+	if (!grow (count) || !constructRange (m_size, count))
+		return false;
+
+	m_size = count;
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+bool InstanceArray::resizeZeroed (size_t count)
+{
+	if (count <= m_size)
+		return resize (count);
+
+	if (!grow (count))
+		return false;
+
+	std::memset (m_data + m_size * m_stride, 0, (count - m_size) * m_stride);
+	if (!constructRange (m_size, count))
+		return false;
+
+	m_size = count;
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+bool InstanceArray::resize (size_t count, InstancePtr prototype)
+{
+	assert (prototype.typePtr() == m_ctype && !prototype.isNull());
+	assert (m_ctype->isTriviallyCopyable());
+	if (!m_ctype->isTriviallyCopyable())
+		return false;
+
+	if (count <= m_size)
+		return resize (count);
+
+	// prototype might live in the block that grow() is about to free
+	Byte const * proto = prototype.data();
+	bool const inside = proto >= m_data && proto < m_data + m_size * m_stride;
+	size_t const proto_index = inside ? size_t(proto - m_data) / m_stride : 0;
+
+	if (!grow (count))
+		return false;
+	if (inside)
+		proto = m_data + proto_index * m_stride;
+
+	// One copy, then keep doubling the filled part
+	Byte * first = m_data + m_size * m_stride;
+	size_t const total = (count - m_size) * m_stride;
+	if (total > 0)
+	{
+		std::memcpy (first, proto, m_stride);
+		for (size_t filled = m_stride; filled < total; )
+		{
+			auto n = std::min (filled, total - filled);
+			std::memcpy (first + filled, first, n);
+			filled += n;
+		}
+	}
+
+	m_size = count;
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+InstancePtr InstanceArray::push ()
+{
+	if (!resize (m_size + 1))
+		return InstancePtr (m_ctype);
+
+	return back ();
+}
+
+//----------------------------------------------------------------------
+
+void InstanceArray::pop ()
+{
+	assert (m_size > 0);
+	if (m_size > 0)
+		resize (m_size - 1);
+}
+
+//----------------------------------------------------------------------
+
+void InstanceArray::clear ()
+{
+	destructRange (0, m_size);
+	m_size = 0;
+	m_arena.reset ();
+}
+
+//----------------------------------------------------------------------
+
+void InstanceArray::shrinkToFit ()
+{
+	if (m_capacity > m_size)
+		reallocate (m_size);
+}
+
+//----------------------------------------------------------------------
+//----------------------------------------------------------------------
+
+bool InstanceArray::reallocate (size_t new_capacity)
+{
+	assert (new_capacity >= m_size);
+
+	Byte * new_data = nullptr;
+	if (new_capacity > 0)
+	{
+		new_data = static_cast<Byte *>(details::AlignedAlloc (new_capacity * m_stride, details::gc_CacheLineSize));
+		if (nullptr == new_data)
+			return false;
+
+		if (m_size > 0)
+			std::memcpy (new_data, m_data, m_size * m_stride);
+	}
+
+	details::AlignedFree (m_data);
+	m_data = new_data;
+	m_capacity = new_capacity;
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+bool InstanceArray::resizeUninitialized (size_t count)
+{
+	if (count <= m_size)
+		return resize (count);
+
+	if (!grow (count))
+		return false;
+
+	m_size = count;
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+bool InstanceArray::grow (size_t count)
+{
+	return count <= m_capacity || reallocate (std::max(count, 2 * m_capacity));
+}
+
+//----------------------------------------------------------------------
+
+bool InstanceArray::constructRange (size_t first, size_t last)
+{
+	if (m_ctype->isTriviallyConstructible())
+		return true;
+
+	auto type = m_ctype->rawType();
+
+	for (auto i = first; i < last; ++i)
+		if (!type->construct (m_data + i * m_stride, m_stride))
+		{
+			destructRange (first, i);
+			return false;
+		}
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+void InstanceArray::destructRange (size_t first, size_t last)
+{
+	if (m_ctype->isTriviallyDestructible())
+		return;
+
+	auto type = m_ctype->rawType();
+
+	for (auto i = last; i > first; --i)
+		type->destruct (m_data + (i - 1) * m_stride, m_stride);
+}
+
+//----------------------------------------------------------------------
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================
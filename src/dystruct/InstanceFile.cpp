@@ -0,0 +1,422 @@
+//======================================================================
+
+#include <dystruct/InstanceFile.h>
+#include <dystruct/InstanceArray.h>
+
+#include <cstdio>
+#include <cstring>
+
+#if defined(_WIN32)
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+	namespace {
+
+//======================================================================
+
+char const gc_FileMagic [8] = {'D', 'y', 'S', 't', 'r', 'u', 'c', 't'};
+uint32_t const gc_FileVersion = 1;
+uint32_t const gc_EndianMarker = 0x01020304;
+unsigned const gc_MaxTypeDepth = 64;		// Nesting of arrays and structs in a type description
+
+struct FileHeader
+{
+	char magic [8];
+	uint32_t version;
+	uint32_t endian_marker;
+	uint64_t id;				// Always 64 bits on disk, whatever ID is
+	uint32_t size_of;
+	uint32_t alignment;
+	uint64_t count;
+	uint64_t name_offset;
+	uint64_t name_size;
+	uint64_t desc_offset;
+	uint64_t desc_size;
+	uint64_t data_offset;		// Multiple of the cache line size
+};
+
+//----------------------------------------------------------------------
+
+bool WriteAll (std::FILE * f, void const * data, size_t size)
+{
+	return 0 == size || 1 == std::fwrite (data, size, 1, f);
+}
+
+//======================================================================
+
+	}	// namespace
+
+//======================================================================
+//======================================================================
+
+bool WriteTypeDescription (Type const * type, std::vector<Byte> & out)
+{
+	details::BlobPut (out, uint8_t(type->getFamily()));
+
+	switch (type->getFamily())
+	{
+	case Family::Basic:
+		details::BlobPut (out, uint8_t(type->asBasic()->getType()));
+		return true;
+
+	case Family::Enum: {
+		auto const & nvs = type->asEnum()->getNameValues();
+		details::BlobPut (out, uint32_t(nvs.size()));
+		for (auto const & nv : nvs)
+		{
+			details::BlobPutString (out, nv.first);
+			details::BlobPut (out, uint32_t(nv.second));
+		}
+	}	return true;
+
+	case Family::Array:
+		details::BlobPut (out, uint32_t(type->getElemCount()));
+		return WriteTypeDescription (type->asArray()->getElemType(), out);
+
+	case Family::DyStruct: {
+		auto st = type->asDyStruct();
+		details::BlobPut (out, uint32_t(st->getFieldCount()));
+		for (SizeType i = 0, e = st->getFieldCount(); i < e; ++i)
+		{
+			details::BlobPutString (out, st->getField(i).name);
+			if (!WriteTypeDescription (st->getField(i).type, out))
+				return false;
+		}
+	}	return true;
+
+	default:
+		return false;
+	}
+}
+
+//======================================================================
+
+	namespace {
+
+// True if [offset, offset + length) is within size bytes, without overflowing.
+bool InRange (uint64_t offset, uint64_t length, size_t size)
+{
+	return offset <= size && length <= size - offset;
+}
+
+//----------------------------------------------------------------------
+
+// The input is untrusted, so the nesting is capped rather than recursing as deep as it says.
+Type * ReadType (TypeManager & tm, Byte const * & cur, Byte const * end, unsigned depth)
+{
+	uint8_t family = 0;
+	if (depth > gc_MaxTypeDepth || !details::BlobGet (cur, end, family))
+		return nullptr;
+
+	switch (Family(family))
+	{
+	case Family::Basic: {
+		uint8_t basic = 0;
+		if (!details::BlobGet (cur, end, basic) || basic >= uint8_t(Basic::_count))
+			return nullptr;
+		return tm.createType<Family::Basic> (Basic(basic));
+	}
+
+	case Family::Enum: {
+		uint32_t count = 0;
+		if (!details::BlobGet (cur, end, count))
+			return nullptr;
+		auto ret = tm.createType<Family::Enum> (Basic::U32);
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			std::string name;
+			uint32_t value = 0;
+			if (!details::BlobGetString (cur, end, name) || !details::BlobGet (cur, end, value) || !ret->addEntry (std::move(name), value))
+				return nullptr;
+		}
+		return ret;
+	}
+
+	case Family::Array: {
+		uint32_t count = 0;
+		if (!details::BlobGet (cur, end, count))
+			return nullptr;
+		auto elem = ReadType (tm, cur, end, depth + 1);
+		if (nullptr == elem)
+			return nullptr;
+		return tm.createType<Family::Array> (count, elem);
+	}
+
+	case Family::DyStruct: {
+		uint32_t count = 0;
+		if (!details::BlobGet (cur, end, count))
+			return nullptr;
+		auto ret = tm.createType<Family::DyStruct> ();
+		for (uint32_t i = 0; i < count; ++i)
+		{
+			std::string name;
+			if (!details::BlobGetString (cur, end, name))
+				return nullptr;
+			auto ft = ReadType (tm, cur, end, depth + 1);
+			if (nullptr == ft || !ret->addField ({ft, std::move(name)}))
+				return nullptr;
+		}
+		return ret;
+	}
+
+	default:
+		return nullptr;
+	}
+}
+
+	}	// namespace
+
+//----------------------------------------------------------------------
+
+Type * ReadTypeDescription (TypeManager & tm, Byte const * & cur, Byte const * end)
+{
+	return ReadType (tm, cur, end, 0);
+}
+
+//======================================================================
+
+MappedFile::MappedFile ()
+	: m_data (nullptr)
+	, m_size (0)
+#if defined(_WIN32)
+	, m_file (nullptr)
+	, m_mapping (nullptr)
+#endif
+{
+}
+
+//----------------------------------------------------------------------
+
+MappedFile::~MappedFile ()
+{
+	close ();
+}
+
+//----------------------------------------------------------------------
+
+bool MappedFile::open (std::string const & path)
+{
+	close ();
+
+#if defined(_WIN32)
+	auto file = ::CreateFileA (path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (INVALID_HANDLE_VALUE == file)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!::GetFileSizeEx (file, &size) || 0 == size.QuadPart)
+	{
+		::CloseHandle (file);
+		return false;
+	}
+
+	auto mapping = ::CreateFileMappingA (file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	if (nullptr == mapping)
+	{
+		::CloseHandle (file);
+		return false;
+	}
+
+	auto view = ::MapViewOfFile (mapping, FILE_MAP_COPY, 0, 0, 0);
+	if (nullptr == view)
+	{
+		::CloseHandle (mapping);
+		::CloseHandle (file);
+		return false;
+	}
+
+	m_file = file;
+	m_mapping = mapping;
+	m_data = static_cast<Byte *>(view);
+	m_size = size_t(size.QuadPart);
+#else
+	int fd = ::open (path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat st;
+	if (0 != ::fstat (fd, &st) || 0 == st.st_size)
+	{
+		::close (fd);
+		return false;
+	}
+
+	auto view = ::mmap (nullptr, size_t(st.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	::close (fd);	// The mapping keeps the file alive
+	if (MAP_FAILED == view)
+		return false;
+
+	m_data = static_cast<Byte *>(view);
+	m_size = size_t(st.st_size);
+#endif
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+void MappedFile::close ()
+{
+	if (nullptr == m_data)
+		return;
+
+#if defined(_WIN32)
+	::UnmapViewOfFile (m_data);
+	::CloseHandle (m_mapping);
+	::CloseHandle (m_file);
+	m_mapping = nullptr;
+	m_file = nullptr;
+#else
+	::munmap (m_data, m_size);
+#endif
+
+	m_data = nullptr;
+	m_size = 0;
+}
+
+//======================================================================
+
+bool InstanceFile::Write (std::string const & path, InstanceArray const & instances)
+{
+	return Write (path, instances.type(), instances.data(), instances.size());
+}
+
+//----------------------------------------------------------------------
+
+bool InstanceFile::Write (std::string const & path, CompiledType const & type, void const * data, size_t count)
+{
+	if (!type.isFixedFootprint())
+		return false;
+
+	std::vector<Byte> desc;
+	if (!WriteTypeDescription (type.rawType(), desc))
+		return false;
+
+	FileHeader header;
+	std::memset (&header, 0, sizeof(header));
+	std::memcpy (header.magic, gc_FileMagic, sizeof(header.magic));
+	header.version = gc_FileVersion;
+	header.endian_marker = gc_EndianMarker;
+	header.id = uint64_t(type.id());
+	header.size_of = type.sizeOf();
+	header.alignment = type.alignment();
+	header.count = count;
+	header.name_offset = sizeof(FileHeader);
+	header.name_size = type.name().size();
+	header.desc_offset = header.name_offset + header.name_size;
+	header.desc_size = desc.size();
+	header.data_offset = details::AlignUp (SizeType(header.desc_offset + header.desc_size), details::gc_CacheLineSize);
+
+	auto f = std::fopen (path.c_str(), "wb");
+	if (nullptr == f)
+		return false;
+
+	Byte const padding [details::gc_CacheLineSize] = {};
+	bool ok = WriteAll (f, &header, sizeof(header))
+		&& WriteAll (f, type.name().data(), type.name().size())
+		&& WriteAll (f, desc.data(), desc.size())
+		&& WriteAll (f, padding, size_t(header.data_offset - header.desc_offset - header.desc_size))
+		&& WriteAll (f, data, count * type.sizeOf());
+
+	ok = (0 == std::fclose (f)) && ok;
+	if (!ok)
+		std::remove (path.c_str());
+
+	return ok;
+}
+
+//----------------------------------------------------------------------
+
+InstanceFile::InstanceFile ()
+	: m_file ()
+	, m_ctype (nullptr)
+	, m_data (nullptr)
+	, m_count (0)
+{
+}
+
+//----------------------------------------------------------------------
+
+bool InstanceFile::open (std::string const & path, TypeManager & tm)
+{
+	close ();
+
+	if (!m_file.open (path))
+		return false;
+
+	auto base = m_file.data();
+	auto size = m_file.size();
+
+	FileHeader header;
+	if (size < sizeof(header))
+	{
+		close ();
+		return false;
+	}
+	std::memcpy (&header, base, sizeof(header));
+
+	bool valid = 0 == std::memcmp (header.magic, gc_FileMagic, sizeof(header.magic))
+		&& gc_FileVersion == header.version
+		&& gc_EndianMarker == header.endian_marker
+		&& InRange (header.name_offset, header.name_size, size)
+		&& InRange (header.desc_offset, header.desc_size, size)
+		&& 0 == header.data_offset % details::gc_CacheLineSize
+		&& header.data_offset <= size
+		&& (0 == header.size_of || header.count <= (size - header.data_offset) / header.size_of);
+	if (!valid)
+	{
+		close ();
+		return false;
+	}
+
+	Name name (reinterpret_cast<char const *>(base + header.name_offset), size_t(header.name_size));
+	CompiledType const * ctype = tm.getCompiledType (name);
+	if (nullptr == ctype)
+	{
+		Byte const * cur = base + header.desc_offset;
+		auto type = ReadTypeDescription (tm, cur, cur + header.desc_size);
+		if (type)
+			ctype = tm.compile (type, name);
+	}
+
+	if (nullptr == ctype || uint64_t(ctype->id()) != header.id || ctype->sizeOf() != header.size_of)
+	{
+		close ();
+		return false;
+	}
+
+	m_ctype = ctype;
+	m_data = base + header.data_offset;
+	m_count = size_t(header.count);
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+void InstanceFile::close ()
+{
+	m_file.close ();
+	m_ctype = nullptr;
+	m_data = nullptr;
+	m_count = 0;
+}
+
+//----------------------------------------------------------------------
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================
@@ -0,0 +1,299 @@
+//======================================================================
+
+#include <dystruct/DyStruct.h>
+
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+	namespace details {
+
+//======================================================================
+
+struct PoolNode
+{
+	PoolNode * next;
+};
+
+//----------------------------------------------------------------------
+
+	}	// namespace details
+
+//======================================================================
+
+	namespace {
+
+//======================================================================
+
+size_t const gc_MinSlabSize = 64 * 1024;
+CountType const gc_MinSlotsPerSlab = 16;
+
+CountType const gc_ThreadCacheWays = 8;		// Number of pools a thread can cache at once
+CountType const gc_ThreadCacheMax = 64;		// Free slots a thread holds on to, per pool
+CountType const gc_ThreadCacheBatch = 32;	// Slots moved between a thread cache and its pool at once
+
+//----------------------------------------------------------------------
+
+std::atomic<uint64_t> g_next_pool_serial {1};
+
+// Thread caches only know their pools by serial; they find out whether the
+// pool is still alive (and where it is) through this.
+std::mutex & RegistryLock ()
+{
+	static std::mutex s_lock;
+	return s_lock;
+}
+
+std::unordered_map<uint64_t, InstancePool *> & Registry ()
+{
+	static std::unordered_map<uint64_t, InstancePool *> s_registry;
+	return s_registry;
+}
+
+//----------------------------------------------------------------------
+
+struct ThreadCacheEntry
+{
+	uint64_t serial;
+	details::PoolNode * head;
+	CountType count;
+};
+
+//----------------------------------------------------------------------
+
+// Gives the cached slots back to their pool, or just forgets them if the pool is dead.
+void FlushEntry (ThreadCacheEntry & entry)
+{
+	if (entry.head)
+	{
+		std::lock_guard<std::mutex> guard {RegistryLock()};
+		auto i = Registry().find (entry.serial);
+		if (Registry().end() != i)
+		{
+			auto tail = entry.head;
+			while (tail->next)
+				tail = tail->next;
+			i->second->returnChain (entry.head, tail);
+		}
+	}
+
+	entry.serial = 0;
+	entry.head = nullptr;
+	entry.count = 0;
+}
+
+//----------------------------------------------------------------------
+
+struct ThreadCache
+{
+	ThreadCacheEntry entries [gc_ThreadCacheWays];
+
+	ThreadCache ()
+	{
+		for (auto & e : entries)
+			e = ThreadCacheEntry {0, nullptr, 0};
+	}
+
+	~ThreadCache ()
+	{
+		for (auto & e : entries)
+			FlushEntry (e);
+	}
+
+	ThreadCacheEntry & entryFor (uint64_t serial)
+	{
+		auto & e = entries[serial % gc_ThreadCacheWays];
+		if (e.serial != serial)
+		{
+			FlushEntry (e);
+			e.serial = serial;
+		}
+		return e;
+	}
+};
+
+thread_local ThreadCache t_cache;
+
+//======================================================================
+
+	}	// namespace
+
+//======================================================================
+//======================================================================
+
+InstancePool::InstancePool (SizeType instance_size, SizeType alignment, bool cache_line_slots, bool thread_cache)
+	: m_slot_size {details::AlignUp (std::max<SizeType>(instance_size, sizeof(details::PoolNode)),
+		cache_line_slots ? details::gc_CacheLineSize : std::max<SizeType>(alignment, alignof(details::PoolNode)))}
+	, m_slab_size {details::AlignUp (SizeType(std::max<size_t>(gc_MinSlabSize, size_t(m_slot_size) * gc_MinSlotsPerSlab)), details::gc_CacheLineSize)}
+	, m_thread_cache {thread_cache}
+	, m_serial {g_next_pool_serial++}
+	, m_lock {}
+	, m_free {nullptr}
+	, m_bump {nullptr}
+	, m_bump_end {nullptr}
+	, m_slabs {}
+{
+	assert (alignment <= details::gc_CacheLineSize);
+
+	if (m_thread_cache)
+	{
+		std::lock_guard<std::mutex> guard {RegistryLock()};
+		Registry()[m_serial] = this;
+	}
+}
+
+//----------------------------------------------------------------------
+
+InstancePool::~InstancePool ()
+{
+	if (m_thread_cache)
+	{
+		std::lock_guard<std::mutex> guard {RegistryLock()};
+		Registry().erase (m_serial);
+	}
+
+	for (auto slab : m_slabs)
+		details::AlignedFree (slab);
+}
+
+//----------------------------------------------------------------------
+
+Byte * InstancePool::allocate ()
+{
+	if (m_thread_cache)
+	{
+		auto & e = t_cache.entryFor (m_serial);
+		if (nullptr == e.head)
+			e.head = takeChain (gc_ThreadCacheBatch, e.count);
+		if (nullptr == e.head)
+			return nullptr;
+
+		auto node = e.head;
+		e.head = node->next;
+		e.count -= 1;
+		return reinterpret_cast<Byte *>(node);
+	}
+
+	std::lock_guard<std::mutex> guard {m_lock};
+	return reinterpret_cast<Byte *>(allocateLocked ());
+}
+
+//----------------------------------------------------------------------
+
+void InstancePool::deallocate (Byte * mem)
+{
+	if (nullptr == mem)
+		return;
+
+	auto node = reinterpret_cast<details::PoolNode *>(mem);
+
+	if (m_thread_cache)
+	{
+		auto & e = t_cache.entryFor (m_serial);
+		node->next = e.head;
+		e.head = node;
+		e.count += 1;
+
+		if (e.count > gc_ThreadCacheMax)
+		{
+			// Keep the most recently freed (i.e. warmest) slots, give the rest back
+			auto tail = e.head;
+			for (CountType i = 1; i < gc_ThreadCacheMax - gc_ThreadCacheBatch; ++i)
+				tail = tail->next;
+			auto surplus = tail->next;
+			tail->next = nullptr;
+			e.count = gc_ThreadCacheMax - gc_ThreadCacheBatch;
+
+			auto surplus_tail = surplus;
+			while (surplus_tail->next)
+				surplus_tail = surplus_tail->next;
+			returnChain (surplus, surplus_tail);
+		}
+		return;
+	}
+
+	std::lock_guard<std::mutex> guard {m_lock};
+	node->next = m_free;
+	m_free = node;
+}
+
+//----------------------------------------------------------------------
+
+size_t InstancePool::slabCount () const
+{
+	std::lock_guard<std::mutex> guard {m_lock};
+	return m_slabs.size();
+}
+
+//----------------------------------------------------------------------
+
+details::PoolNode * InstancePool::takeChain (CountType max_count, CountType & count)
+{
+	std::lock_guard<std::mutex> guard {m_lock};
+
+	details::PoolNode * head = nullptr;
+	count = 0;
+	while (count < max_count)
+	{
+		auto node = allocateLocked ();
+		if (nullptr == node)
+			break;
+		node->next = head;
+		head = node;
+		count += 1;
+	}
+
+	return head;
+}
+
+//----------------------------------------------------------------------
+
+void InstancePool::returnChain (details::PoolNode * head, details::PoolNode * tail)
+{
+	assert (head && tail && nullptr == tail->next);
+
+	std::lock_guard<std::mutex> guard {m_lock};
+	tail->next = m_free;
+	m_free = head;
+}
+
+//----------------------------------------------------------------------
+//----------------------------------------------------------------------
+
+details::PoolNode * InstancePool::allocateLocked ()
+{
+	if (m_free)
+	{
+		auto ret = m_free;
+		m_free = ret->next;
+		return ret;
+	}
+
+	if (m_bump == m_bump_end)
+	{
+		auto slab = static_cast<Byte *>(details::AlignedAlloc (m_slab_size, details::gc_CacheLineSize));
+		if (nullptr == slab)
+			return nullptr;
+
+		m_slabs.push_back (slab);
+		m_bump = slab;
+		m_bump_end = slab + (m_slab_size / m_slot_size) * m_slot_size;
+	}
+
+	auto ret = reinterpret_cast<details::PoolNode *>(m_bump);
+	m_bump += m_slot_size;
+	return ret;
+}
+
+//----------------------------------------------------------------------
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================
@@ -0,0 +1,1545 @@
+//======================================================================
+
+#include <dystruct/Kernels.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <limits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+	#define DYSTRUCT_X86 1
+	#include <emmintrin.h>
+	#include <immintrin.h>
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#endif
+#else
+	#define DYSTRUCT_X86 0
+#endif
+
+// MSVC lets you use any intrinsic anywhere; GCC and Clang want to be told.
+#if DYSTRUCT_X86 && (defined(__GNUC__) || defined(__clang__))
+	#define DYSTRUCT_TARGET_SSE2 __attribute__((target("sse2")))
+	#define DYSTRUCT_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+	#define DYSTRUCT_TARGET_SSE2
+	#define DYSTRUCT_TARGET_AVX2
+#endif
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+	namespace {
+
+//======================================================================
+
+inline unsigned PopCount64 (uint64_t v)
+{
+#if defined(__GNUC__) || defined(__clang__)
+	return unsigned(__builtin_popcountll (v));
+#else
+	v = v - ((v >> 1) & 0x5555555555555555ULL);
+	v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+	v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return unsigned((v * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+//----------------------------------------------------------------------
+
+SimdLevel DetectSimdLevel ()
+{
+#if DYSTRUCT_X86 && defined(_MSC_VER)
+	int info [4];
+	__cpuid (info, 0);
+	int max_leaf = info[0];
+
+	__cpuid (info, 1);
+	bool sse2 = 0 != (info[3] & (1 << 26));
+	bool osxsave = 0 != (info[2] & (1 << 27));
+	bool avx = 0 != (info[2] & (1 << 28));
+	bool avx2 = false;
+	if (osxsave && avx && max_leaf >= 7 && 6 == (_xgetbv (0) & 6))
+	{
+		__cpuidex (info, 7, 0);
+		avx2 = 0 != (info[1] & (1 << 5));
+	}
+
+	return avx2 ? SimdLevel::AVX2 : (sse2 ? SimdLevel::SSE2 : SimdLevel::Scalar);
+#elif DYSTRUCT_X86
+	__builtin_cpu_init ();
+	if (__builtin_cpu_supports ("avx2"))
+		return SimdLevel::AVX2;
+	if (__builtin_cpu_supports ("sse2"))
+		return SimdLevel::SSE2;
+	return SimdLevel::Scalar;
+#else
+	return SimdLevel::Scalar;
+#endif
+}
+
+//----------------------------------------------------------------------
+
+// Atomic, since SetSimdLevel() may run while kernels on other threads
+// dispatch; which level a kernel already running picked doesn't matter.
+std::atomic<SimdLevel> & LevelSetting ()
+{
+	static std::atomic<SimdLevel> s_level {DetectSimdLevel ()};
+	return s_level;
+}
+
+//----------------------------------------------------------------------
+
+inline SimdLevel CurrentLevel ()
+{
+	return LevelSetting().load (std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------
+
+template <typename T>
+inline bool Compare (T a, CompareOp op, T b)
+{
+	switch (op)
+	{
+	case CompareOp::Equal:			return a == b;
+	case CompareOp::NotEqual:		return a != b;
+	case CompareOp::Less:			return a < b;
+	case CompareOp::LessEqual:		return a <= b;
+	case CompareOp::Greater:		return a > b;
+	case CompareOp::GreaterEqual:	return a >= b;
+	default:						return false;
+	}
+}
+
+//----------------------------------------------------------------------
+
+// +/-infinity for floats (so that NaNs lose every comparison and get ignored,) the extremes for the rest.
+template <typename T> T MinIdentity () {return std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();}
+template <typename T> T MaxIdentity () {return std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest();}
+
+//======================================================================
+// Scalar versions; these handle every type, and the tails for SIMD versions.
+//======================================================================
+
+template <typename T, typename S>
+S ScalarSum (T const * data, size_t count, S acc = S(0))
+{
+	for (size_t i = 0; i < count; ++i)
+		acc += S(data[i]);
+	return acc;
+}
+
+//----------------------------------------------------------------------
+
+template <typename T>
+T ScalarMin (T const * data, size_t count, T acc)
+{
+	for (size_t i = 0; i < count; ++i)
+		if (data[i] < acc)
+			acc = data[i];
+	return acc;
+}
+
+//----------------------------------------------------------------------
+
+template <typename T>
+T ScalarMax (T const * data, size_t count, T acc)
+{
+	for (size_t i = 0; i < count; ++i)
+		if (data[i] > acc)
+			acc = data[i];
+	return acc;
+}
+
+//----------------------------------------------------------------------
+
+template <typename T>
+size_t ScalarCount (T const * data, size_t count, CompareOp op, T value)
+{
+	size_t ret = 0;
+	for (size_t i = 0; i < count; ++i)
+		ret += Compare (data[i], op, value) ? 1 : 0;
+	return ret;
+}
+
+//----------------------------------------------------------------------
+
+// Fills bitmap starting at bit 'first_bit' (which must be a multiple of 64.)
+template <typename T>
+void ScalarFilter (T const * data, size_t first_bit, size_t count, CompareOp op, T value, uint64_t * bitmap)
+{
+	assert (0 == first_bit % 64);
+
+	for (size_t i = first_bit; i < count; i += 64)
+	{
+		uint64_t word = 0;
+		for (size_t j = 0, e = std::min<size_t>(64, count - i); j < e; ++j)
+			word |= uint64_t(Compare (data[i + j], op, value) ? 1 : 0) << j;
+		bitmap[i / 64] = word;
+	}
+}
+
+//======================================================================
+// The SIMD versions. Each "Ops" struct wraps one vector type for one ISA;
+// the kernel templates are written once per ISA (because GCC wants the
+// target attribute on everything) through the macro below.
+//======================================================================
+
+#if DYSTRUCT_X86
+
+struct Sse2I32
+{
+	static int const Lanes = 4;
+	typedef __m128i V;
+	typedef int32_t T;
+	DYSTRUCT_TARGET_SSE2 static V load (T const * p) {return _mm_loadu_si128 (reinterpret_cast<__m128i const *>(p));}
+	DYSTRUCT_TARGET_SSE2 static V set1 (T v) {return _mm_set1_epi32 (v);}
+	DYSTRUCT_TARGET_SSE2 static V min (V a, V b) {auto m = _mm_cmplt_epi32 (a, b); return _mm_or_si128 (_mm_and_si128 (m, a), _mm_andnot_si128 (m, b));}
+	DYSTRUCT_TARGET_SSE2 static V max (V a, V b) {auto m = _mm_cmpgt_epi32 (a, b); return _mm_or_si128 (_mm_and_si128 (m, a), _mm_andnot_si128 (m, b));}
+	DYSTRUCT_TARGET_SSE2 static void store (T * p, V v) {_mm_storeu_si128 (reinterpret_cast<__m128i *>(p), v);}
+	DYSTRUCT_TARGET_SSE2 static unsigned eq (V a, V b) {return unsigned(_mm_movemask_ps (_mm_castsi128_ps (_mm_cmpeq_epi32 (a, b))));}
+	DYSTRUCT_TARGET_SSE2 static unsigned lt (V a, V b) {return unsigned(_mm_movemask_ps (_mm_castsi128_ps (_mm_cmplt_epi32 (a, b))));}
+	DYSTRUCT_TARGET_SSE2 static unsigned gt (V a, V b) {return unsigned(_mm_movemask_ps (_mm_castsi128_ps (_mm_cmpgt_epi32 (a, b))));}
+	// Integers are totally ordered, so the rest are complements
+	DYSTRUCT_TARGET_SSE2 static unsigned ne (V a, V b) {return eq (a, b) ^ 0xF;}
+	DYSTRUCT_TARGET_SSE2 static unsigned le (V a, V b) {return gt (a, b) ^ 0xF;}
+	DYSTRUCT_TARGET_SSE2 static unsigned ge (V a, V b) {return lt (a, b) ^ 0xF;}
+};
+
+//----------------------------------------------------------------------
+
+// Unsigned compares are done as signed ones, after flipping the sign bits ("bias".)
+struct Sse2U32
+{
+	static int const Lanes = 4;
+	typedef __m128i V;
+	typedef uint32_t T;
+	DYSTRUCT_TARGET_SSE2 static V load (T const * p) {return _mm_loadu_si128 (reinterpret_cast<__m128i const *>(p));}
+	DYSTRUCT_TARGET_SSE2 static V set1 (T v) {return _mm_set1_epi32 (int32_t(v));}
+	DYSTRUCT_TARGET_SSE2 static V bias (V v) {return _mm_xor_si128 (v, _mm_set1_epi32 (int32_t(0x80000000U)));}
+	DYSTRUCT_TARGET_SSE2 static V min (V a, V b) {auto m = _mm_cmplt_epi32 (bias (a), bias (b)); return _mm_or_si128 (_mm_and_si128 (m, a), _mm_andnot_si128 (m, b));}
+	DYSTRUCT_TARGET_SSE2 static V max (V a, V b) {auto m = _mm_cmpgt_epi32 (bias (a), bias (b)); return _mm_or_si128 (_mm_and_si128 (m, a), _mm_andnot_si128 (m, b));}
+	DYSTRUCT_TARGET_SSE2 static void store (T * p, V v) {_mm_storeu_si128 (reinterpret_cast<__m128i *>(p), v);}
+	DYSTRUCT_TARGET_SSE2 static unsigned eq (V a, V b) {return unsigned(_mm_movemask_ps (_mm_castsi128_ps (_mm_cmpeq_epi32 (a, b))));}
+	DYSTRUCT_TARGET_SSE2 static unsigned lt (V a, V b) {return unsigned(_mm_movemask_ps (_mm_castsi128_ps (_mm_cmplt_epi32 (bias (a), bias (b)))));}
+	DYSTRUCT_TARGET_SSE2 static unsigned gt (V a, V b) {return unsigned(_mm_movemask_ps (_mm_castsi128_ps (_mm_cmpgt_epi32 (bias (a), bias (b)))));}
+	DYSTRUCT_TARGET_SSE2 static unsigned ne (V a, V b) {return eq (a, b) ^ 0xF;}
+	DYSTRUCT_TARGET_SSE2 static unsigned le (V a, V b) {return gt (a, b) ^ 0xF;}
+	DYSTRUCT_TARGET_SSE2 static unsigned ge (V a, V b) {return lt (a, b) ^ 0xF;}
+};
+
+//----------------------------------------------------------------------
+
+// Note that min/max take the accumulator as the second argument, which is what gets returned for NaNs.
+struct Sse2F32
+{
+	static int const Lanes = 4;
+	typedef __m128 V;
+	typedef float T;
+	DYSTRUCT_TARGET_SSE2 static V load (T const * p) {return _mm_loadu_ps (p);}
+	DYSTRUCT_TARGET_SSE2 static V set1 (T v) {return _mm_set1_ps (v);}
+	DYSTRUCT_TARGET_SSE2 static V min (V a, V b) {return _mm_min_ps (a, b);}
+	DYSTRUCT_TARGET_SSE2 static V max (V a, V b) {return _mm_max_ps (a, b);}
+	DYSTRUCT_TARGET_SSE2 static void store (T * p, V v) {_mm_storeu_ps (p, v);}
+	DYSTRUCT_TARGET_SSE2 static unsigned eq (V a, V b) {return unsigned(_mm_movemask_ps (_mm_cmpeq_ps (a, b)));}
+	DYSTRUCT_TARGET_SSE2 static unsigned ne (V a, V b) {return unsigned(_mm_movemask_ps (_mm_cmpneq_ps (a, b)));}
+	DYSTRUCT_TARGET_SSE2 static unsigned lt (V a, V b) {return unsigned(_mm_movemask_ps (_mm_cmplt_ps (a, b)));}
+	DYSTRUCT_TARGET_SSE2 static unsigned le (V a, V b) {return unsigned(_mm_movemask_ps (_mm_cmple_ps (a, b)));}
+	DYSTRUCT_TARGET_SSE2 static unsigned gt (V a, V b) {return unsigned(_mm_movemask_ps (_mm_cmpgt_ps (a, b)));}
+	DYSTRUCT_TARGET_SSE2 static unsigned ge (V a, V b) {return unsigned(_mm_movemask_ps (_mm_cmpge_ps (a, b)));}
+};
+
+//----------------------------------------------------------------------
+
+struct Sse2F64
+{
+	static int const Lanes = 2;
+	typedef __m128d V;
+	typedef double T;
+	DYSTRUCT_TARGET_SSE2 static V load (T const * p) {return _mm_loadu_pd (p);}
+	DYSTRUCT_TARGET_SSE2 static V set1 (T v) {return _mm_set1_pd (v);}
+	DYSTRUCT_TARGET_SSE2 static V min (V a, V b) {return _mm_min_pd (a, b);}
+	DYSTRUCT_TARGET_SSE2 static V max (V a, V b) {return _mm_max_pd (a, b);}
+	DYSTRUCT_TARGET_SSE2 static void store (T * p, V v) {_mm_storeu_pd (p, v);}
+	DYSTRUCT_TARGET_SSE2 static unsigned eq (V a, V b) {return unsigned(_mm_movemask_pd (_mm_cmpeq_pd (a, b)));}
+	DYSTRUCT_TARGET_SSE2 static unsigned ne (V a, V b) {return unsigned(_mm_movemask_pd (_mm_cmpneq_pd (a, b)));}
+	DYSTRUCT_TARGET_SSE2 static unsigned lt (V a, V b) {return unsigned(_mm_movemask_pd (_mm_cmplt_pd (a, b)));}
+	DYSTRUCT_TARGET_SSE2 static unsigned le (V a, V b) {return unsigned(_mm_movemask_pd (_mm_cmple_pd (a, b)));}
+	DYSTRUCT_TARGET_SSE2 static unsigned gt (V a, V b) {return unsigned(_mm_movemask_pd (_mm_cmpgt_pd (a, b)));}
+	DYSTRUCT_TARGET_SSE2 static unsigned ge (V a, V b) {return unsigned(_mm_movemask_pd (_mm_cmpge_pd (a, b)));}
+};
+
+//----------------------------------------------------------------------
+
+struct Avx2I32
+{
+	static int const Lanes = 8;
+	typedef __m256i V;
+	typedef int32_t T;
+	DYSTRUCT_TARGET_AVX2 static V load (T const * p) {return _mm256_loadu_si256 (reinterpret_cast<__m256i const *>(p));}
+	DYSTRUCT_TARGET_AVX2 static V set1 (T v) {return _mm256_set1_epi32 (v);}
+	DYSTRUCT_TARGET_AVX2 static V min (V a, V b) {return _mm256_min_epi32 (a, b);}
+	DYSTRUCT_TARGET_AVX2 static V max (V a, V b) {return _mm256_max_epi32 (a, b);}
+	DYSTRUCT_TARGET_AVX2 static void store (T * p, V v) {_mm256_storeu_si256 (reinterpret_cast<__m256i *>(p), v);}
+	DYSTRUCT_TARGET_AVX2 static unsigned mask (V m) {return unsigned(_mm256_movemask_ps (_mm256_castsi256_ps (m)));}
+	DYSTRUCT_TARGET_AVX2 static unsigned eq (V a, V b) {return mask (_mm256_cmpeq_epi32 (a, b));}
+	DYSTRUCT_TARGET_AVX2 static unsigned gt (V a, V b) {return mask (_mm256_cmpgt_epi32 (a, b));}
+	DYSTRUCT_TARGET_AVX2 static unsigned lt (V a, V b) {return mask (_mm256_cmpgt_epi32 (b, a));}
+	DYSTRUCT_TARGET_AVX2 static unsigned ne (V a, V b) {return eq (a, b) ^ 0xFF;}
+	DYSTRUCT_TARGET_AVX2 static unsigned le (V a, V b) {return gt (a, b) ^ 0xFF;}
+	DYSTRUCT_TARGET_AVX2 static unsigned ge (V a, V b) {return lt (a, b) ^ 0xFF;}
+};
+
+//----------------------------------------------------------------------
+
+struct Avx2U32
+{
+	static int const Lanes = 8;
+	typedef __m256i V;
+	typedef uint32_t T;
+	DYSTRUCT_TARGET_AVX2 static V load (T const * p) {return _mm256_loadu_si256 (reinterpret_cast<__m256i const *>(p));}
+	DYSTRUCT_TARGET_AVX2 static V set1 (T v) {return _mm256_set1_epi32 (int32_t(v));}
+	DYSTRUCT_TARGET_AVX2 static V bias (V v) {return _mm256_xor_si256 (v, _mm256_set1_epi32 (int32_t(0x80000000U)));}
+	DYSTRUCT_TARGET_AVX2 static V min (V a, V b) {return _mm256_min_epu32 (a, b);}
+	DYSTRUCT_TARGET_AVX2 static V max (V a, V b) {return _mm256_max_epu32 (a, b);}
+	DYSTRUCT_TARGET_AVX2 static void store (T * p, V v) {_mm256_storeu_si256 (reinterpret_cast<__m256i *>(p), v);}
+	DYSTRUCT_TARGET_AVX2 static unsigned mask (V m) {return unsigned(_mm256_movemask_ps (_mm256_castsi256_ps (m)));}
+	DYSTRUCT_TARGET_AVX2 static unsigned eq (V a, V b) {return mask (_mm256_cmpeq_epi32 (a, b));}
+	DYSTRUCT_TARGET_AVX2 static unsigned gt (V a, V b) {return mask (_mm256_cmpgt_epi32 (bias (a), bias (b)));}
+	DYSTRUCT_TARGET_AVX2 static unsigned lt (V a, V b) {return mask (_mm256_cmpgt_epi32 (bias (b), bias (a)));}
+	DYSTRUCT_TARGET_AVX2 static unsigned ne (V a, V b) {return eq (a, b) ^ 0xFF;}
+	DYSTRUCT_TARGET_AVX2 static unsigned le (V a, V b) {return gt (a, b) ^ 0xFF;}
+	DYSTRUCT_TARGET_AVX2 static unsigned ge (V a, V b) {return lt (a, b) ^ 0xFF;}
+};
+
+//----------------------------------------------------------------------
+
+struct Avx2F32
+{
+	static int const Lanes = 8;
+	typedef __m256 V;
+	typedef float T;
+	DYSTRUCT_TARGET_AVX2 static V load (T const * p) {return _mm256_loadu_ps (p);}
+	DYSTRUCT_TARGET_AVX2 static V set1 (T v) {return _mm256_set1_ps (v);}
+	DYSTRUCT_TARGET_AVX2 static V min (V a, V b) {return _mm256_min_ps (a, b);}
+	DYSTRUCT_TARGET_AVX2 static V max (V a, V b) {return _mm256_max_ps (a, b);}
+	DYSTRUCT_TARGET_AVX2 static void store (T * p, V v) {_mm256_storeu_ps (p, v);}
+	DYSTRUCT_TARGET_AVX2 static unsigned eq (V a, V b) {return unsigned(_mm256_movemask_ps (_mm256_cmp_ps (a, b, _CMP_EQ_OQ)));}
+	DYSTRUCT_TARGET_AVX2 static unsigned ne (V a, V b) {return unsigned(_mm256_movemask_ps (_mm256_cmp_ps (a, b, _CMP_NEQ_UQ)));}
+	DYSTRUCT_TARGET_AVX2 static unsigned lt (V a, V b) {return unsigned(_mm256_movemask_ps (_mm256_cmp_ps (a, b, _CMP_LT_OQ)));}
+	DYSTRUCT_TARGET_AVX2 static unsigned le (V a, V b) {return unsigned(_mm256_movemask_ps (_mm256_cmp_ps (a, b, _CMP_LE_OQ)));}
+	DYSTRUCT_TARGET_AVX2 static unsigned gt (V a, V b) {return unsigned(_mm256_movemask_ps (_mm256_cmp_ps (a, b, _CMP_GT_OQ)));}
+	DYSTRUCT_TARGET_AVX2 static unsigned ge (V a, V b) {return unsigned(_mm256_movemask_ps (_mm256_cmp_ps (a, b, _CMP_GE_OQ)));}
+};
+
+//----------------------------------------------------------------------
+
+struct Avx2F64
+{
+	static int const Lanes = 4;
+	typedef __m256d V;
+	typedef double T;
+	DYSTRUCT_TARGET_AVX2 static V load (T const * p) {return _mm256_loadu_pd (p);}
+	DYSTRUCT_TARGET_AVX2 static V set1 (T v) {return _mm256_set1_pd (v);}
+	DYSTRUCT_TARGET_AVX2 static V min (V a, V b) {return _mm256_min_pd (a, b);}
+	DYSTRUCT_TARGET_AVX2 static V max (V a, V b) {return _mm256_max_pd (a, b);}
+	DYSTRUCT_TARGET_AVX2 static void store (T * p, V v) {_mm256_storeu_pd (p, v);}
+	DYSTRUCT_TARGET_AVX2 static unsigned eq (V a, V b) {return unsigned(_mm256_movemask_pd (_mm256_cmp_pd (a, b, _CMP_EQ_OQ)));}
+	DYSTRUCT_TARGET_AVX2 static unsigned ne (V a, V b) {return unsigned(_mm256_movemask_pd (_mm256_cmp_pd (a, b, _CMP_NEQ_UQ)));}
+	DYSTRUCT_TARGET_AVX2 static unsigned lt (V a, V b) {return unsigned(_mm256_movemask_pd (_mm256_cmp_pd (a, b, _CMP_LT_OQ)));}
+	DYSTRUCT_TARGET_AVX2 static unsigned le (V a, V b) {return unsigned(_mm256_movemask_pd (_mm256_cmp_pd (a, b, _CMP_LE_OQ)));}
+	DYSTRUCT_TARGET_AVX2 static unsigned gt (V a, V b) {return unsigned(_mm256_movemask_pd (_mm256_cmp_pd (a, b, _CMP_GT_OQ)));}
+	DYSTRUCT_TARGET_AVX2 static unsigned ge (V a, V b) {return unsigned(_mm256_movemask_pd (_mm256_cmp_pd (a, b, _CMP_GE_OQ)));}
+};
+
+//----------------------------------------------------------------------
+
+// The generic kernels, stamped out once per ISA.
+#define DYSTRUCT_DEFINE_SIMD_KERNELS(NS, TARGET)													\
+	namespace NS {																					\
+		template <typename Ops>																		\
+		TARGET typename Ops::T Min (typename Ops::T const * data, size_t count)					\
+		{																							\
+			typedef typename Ops::T T;																\
+			auto acc = Ops::set1 (MinIdentity<T>());												\
+			size_t i = 0;																			\
+			for (; i + Ops::Lanes <= count; i += Ops::Lanes)										\
+				acc = Ops::min (Ops::load (data + i), acc);											\
+			T lanes [Ops::Lanes];																	\
+			Ops::store (lanes, acc);																\
+			return ScalarMin (data + i, count - i, ScalarMin (lanes, Ops::Lanes, MinIdentity<T>()));	\
+		}																							\
+																									\
+		template <typename Ops>																		\
+		TARGET typename Ops::T Max (typename Ops::T const * data, size_t count)					\
+		{																							\
+			typedef typename Ops::T T;																\
+			auto acc = Ops::set1 (MaxIdentity<T>());												\
+			size_t i = 0;																			\
+			for (; i + Ops::Lanes <= count; i += Ops::Lanes)										\
+				acc = Ops::max (Ops::load (data + i), acc);											\
+			T lanes [Ops::Lanes];																	\
+			Ops::store (lanes, acc);																\
+			return ScalarMax (data + i, count - i, ScalarMax (lanes, Ops::Lanes, MaxIdentity<T>()));	\
+		}																							\
+																									\
+		template <typename Ops>																		\
+		TARGET unsigned CompareMask (typename Ops::V a, CompareOp op, typename Ops::V b)			\
+		{																							\
+			switch (op)																				\
+			{																						\
+			case CompareOp::Equal:			return Ops::eq (a, b);									\
+			case CompareOp::NotEqual:		return Ops::ne (a, b);									\
+			case CompareOp::Less:			return Ops::lt (a, b);									\
+			case CompareOp::LessEqual:		return Ops::le (a, b);									\
+			case CompareOp::Greater:		return Ops::gt (a, b);									\
+			case CompareOp::GreaterEqual:	return Ops::ge (a, b);									\
+			default:						return 0;												\
+			}																						\
+		}																							\
+																									\
+		template <typename Ops>																		\
+		TARGET size_t Count (typename Ops::T const * data, size_t count, CompareOp op, typename Ops::T value)	\
+		{																							\
+			auto v = Ops::set1 (value);																\
+			size_t ret = 0;																			\
+			size_t i = 0;																			\
+			for (; i + Ops::Lanes <= count; i += Ops::Lanes)										\
+				ret += PopCount64 (CompareMask<Ops> (Ops::load (data + i), op, v));					\
+			return ret + ScalarCount (data + i, count - i, op, value);								\
+		}																							\
+																									\
+		template <typename Ops>																		\
+		TARGET void Filter (typename Ops::T const * data, size_t count, CompareOp op, typename Ops::T value, uint64_t * bitmap)	\
+		{																							\
+			auto v = Ops::set1 (value);																\
+			size_t i = 0;																			\
+			for (; i + 64 <= count; i += 64)														\
+			{																						\
+				uint64_t word = 0;																	\
+				for (int j = 0; j < 64; j += Ops::Lanes)											\
+					word |= uint64_t(CompareMask<Ops> (Ops::load (data + i + j), op, v)) << j;		\
+				bitmap[i / 64] = word;																\
+			}																						\
+			ScalarFilter (data, i, count, op, value, bitmap);										\
+		}																							\
+	}
+
+DYSTRUCT_DEFINE_SIMD_KERNELS (Sse2, DYSTRUCT_TARGET_SSE2)
+DYSTRUCT_DEFINE_SIMD_KERNELS (Avx2, DYSTRUCT_TARGET_AVX2)
+
+#undef DYSTRUCT_DEFINE_SIMD_KERNELS
+
+//----------------------------------------------------------------------
+// Sums widen, so they don't fit the generic mold.
+//----------------------------------------------------------------------
+
+	namespace Sse2 {
+
+DYSTRUCT_TARGET_SSE2 int64_t SumI32 (int32_t const * data, size_t count)
+{
+	auto acc0 = _mm_setzero_si128 (), acc1 = _mm_setzero_si128 ();
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		auto x = _mm_loadu_si128 (reinterpret_cast<__m128i const *>(data + i));
+		auto sign = _mm_cmplt_epi32 (x, _mm_setzero_si128 ());
+		acc0 = _mm_add_epi64 (acc0, _mm_unpacklo_epi32 (x, sign));
+		acc1 = _mm_add_epi64 (acc1, _mm_unpackhi_epi32 (x, sign));
+	}
+	int64_t lanes [2];
+	_mm_storeu_si128 (reinterpret_cast<__m128i *>(lanes), _mm_add_epi64 (acc0, acc1));
+	return ScalarSum (data + i, count - i, lanes[0] + lanes[1]);
+}
+
+DYSTRUCT_TARGET_SSE2 uint64_t SumU32 (uint32_t const * data, size_t count)
+{
+	auto acc0 = _mm_setzero_si128 (), acc1 = _mm_setzero_si128 ();
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		auto x = _mm_loadu_si128 (reinterpret_cast<__m128i const *>(data + i));
+		acc0 = _mm_add_epi64 (acc0, _mm_unpacklo_epi32 (x, _mm_setzero_si128 ()));
+		acc1 = _mm_add_epi64 (acc1, _mm_unpackhi_epi32 (x, _mm_setzero_si128 ()));
+	}
+	uint64_t lanes [2];
+	_mm_storeu_si128 (reinterpret_cast<__m128i *>(lanes), _mm_add_epi64 (acc0, acc1));
+	return ScalarSum (data + i, count - i, lanes[0] + lanes[1]);
+}
+
+DYSTRUCT_TARGET_SSE2 double SumF32 (float const * data, size_t count)
+{
+	auto acc0 = _mm_setzero_pd (), acc1 = _mm_setzero_pd ();
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		auto x = _mm_loadu_ps (data + i);
+		acc0 = _mm_add_pd (acc0, _mm_cvtps_pd (x));
+		acc1 = _mm_add_pd (acc1, _mm_cvtps_pd (_mm_movehl_ps (x, x)));
+	}
+	double lanes [2];
+	_mm_storeu_pd (lanes, _mm_add_pd (acc0, acc1));
+	return ScalarSum (data + i, count - i, lanes[0] + lanes[1]);
+}
+
+DYSTRUCT_TARGET_SSE2 double SumF64 (double const * data, size_t count)
+{
+	auto acc0 = _mm_setzero_pd (), acc1 = _mm_setzero_pd ();
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		acc0 = _mm_add_pd (acc0, _mm_loadu_pd (data + i));
+		acc1 = _mm_add_pd (acc1, _mm_loadu_pd (data + i + 2));
+	}
+	double lanes [2];
+	_mm_storeu_pd (lanes, _mm_add_pd (acc0, acc1));
+	return ScalarSum (data + i, count - i, lanes[0] + lanes[1]);
+}
+
+	}	// namespace Sse2
+
+//----------------------------------------------------------------------
+
+	namespace Avx2 {
+
+DYSTRUCT_TARGET_AVX2 int64_t HorizontalSum (__m256i v)
+{
+	int64_t lanes [4];
+	_mm256_storeu_si256 (reinterpret_cast<__m256i *>(lanes), v);
+	return lanes[0] + lanes[1] + lanes[2] + lanes[3];
+}
+
+DYSTRUCT_TARGET_AVX2 double HorizontalSum (__m256d v)
+{
+	double lanes [4];
+	_mm256_storeu_pd (lanes, v);
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+DYSTRUCT_TARGET_AVX2 int64_t SumI32 (int32_t const * data, size_t count)
+{
+	auto acc0 = _mm256_setzero_si256 (), acc1 = _mm256_setzero_si256 ();
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		acc0 = _mm256_add_epi64 (acc0, _mm256_cvtepi32_epi64 (_mm_loadu_si128 (reinterpret_cast<__m128i const *>(data + i))));
+		acc1 = _mm256_add_epi64 (acc1, _mm256_cvtepi32_epi64 (_mm_loadu_si128 (reinterpret_cast<__m128i const *>(data + i + 4))));
+	}
+	return ScalarSum (data + i, count - i, HorizontalSum (_mm256_add_epi64 (acc0, acc1)));
+}
+
+DYSTRUCT_TARGET_AVX2 uint64_t SumU32 (uint32_t const * data, size_t count)
+{
+	auto acc0 = _mm256_setzero_si256 (), acc1 = _mm256_setzero_si256 ();
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		acc0 = _mm256_add_epi64 (acc0, _mm256_cvtepu32_epi64 (_mm_loadu_si128 (reinterpret_cast<__m128i const *>(data + i))));
+		acc1 = _mm256_add_epi64 (acc1, _mm256_cvtepu32_epi64 (_mm_loadu_si128 (reinterpret_cast<__m128i const *>(data + i + 4))));
+	}
+	return ScalarSum (data + i, count - i, uint64_t(HorizontalSum (_mm256_add_epi64 (acc0, acc1))));
+}
+
+DYSTRUCT_TARGET_AVX2 double SumF32 (float const * data, size_t count)
+{
+	auto acc0 = _mm256_setzero_pd (), acc1 = _mm256_setzero_pd ();
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		acc0 = _mm256_add_pd (acc0, _mm256_cvtps_pd (_mm_loadu_ps (data + i)));
+		acc1 = _mm256_add_pd (acc1, _mm256_cvtps_pd (_mm_loadu_ps (data + i + 4)));
+	}
+	return ScalarSum (data + i, count - i, HorizontalSum (_mm256_add_pd (acc0, acc1)));
+}
+
+DYSTRUCT_TARGET_AVX2 double SumF64 (double const * data, size_t count)
+{
+	auto acc0 = _mm256_setzero_pd (), acc1 = _mm256_setzero_pd ();
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		acc0 = _mm256_add_pd (acc0, _mm256_loadu_pd (data + i));
+		acc1 = _mm256_add_pd (acc1, _mm256_loadu_pd (data + i + 4));
+	}
+	return ScalarSum (data + i, count - i, HorizontalSum (_mm256_add_pd (acc0, acc1)));
+}
+
+	}	// namespace Avx2
+
+#endif	// DYSTRUCT_X86
+
+//======================================================================
+// Dispatch: everything goes scalar, except the types that have SIMD versions.
+//======================================================================
+
+template <typename T, typename S>
+struct Dispatch
+{
+	static S sum (T const * data, size_t count) {return ScalarSum<T, S> (data, count);}
+	static T min (T const * data, size_t count) {return ScalarMin (data, count, MinIdentity<T>());}
+	static T max (T const * data, size_t count) {return ScalarMax (data, count, MaxIdentity<T>());}
+	static size_t count (T const * data, size_t count, CompareOp op, T value) {return ScalarCount (data, count, op, value);}
+	static void filter (T const * data, size_t count, CompareOp op, T value, uint64_t * bitmap) {ScalarFilter (data, 0, count, op, value, bitmap);}
+};
+
+//----------------------------------------------------------------------
+
+#if DYSTRUCT_X86
+
+#define DYSTRUCT_DEFINE_SIMD_DISPATCH(T_, S_, Suffix)														\
+	template <>																								\
+	struct Dispatch<T_, S_>																					\
+	{																										\
+		typedef T_ T;																						\
+		typedef S_ S;																						\
+		static S sum (T const * data, size_t count)															\
+		{																									\
+			switch (CurrentLevel())																			\
+			{																								\
+			case SimdLevel::AVX2: return Avx2::Sum##Suffix (data, count);									\
+			case SimdLevel::SSE2: return Sse2::Sum##Suffix (data, count);									\
+			default: return ScalarSum<T, S> (data, count);													\
+			}																								\
+		}																									\
+		static T min (T const * data, size_t count)															\
+		{																									\
+			switch (CurrentLevel())																			\
+			{																								\
+			case SimdLevel::AVX2: return Avx2::Min<Avx2##Suffix> (data, count);								\
+			case SimdLevel::SSE2: return Sse2::Min<Sse2##Suffix> (data, count);								\
+			default: return ScalarMin (data, count, MinIdentity<T>());										\
+			}																								\
+		}																									\
+		static T max (T const * data, size_t count)															\
+		{																									\
+			switch (CurrentLevel())																			\
+			{																								\
+			case SimdLevel::AVX2: return Avx2::Max<Avx2##Suffix> (data, count);								\
+			case SimdLevel::SSE2: return Sse2::Max<Sse2##Suffix> (data, count);								\
+			default: return ScalarMax (data, count, MaxIdentity<T>());										\
+			}																								\
+		}																									\
+		static size_t count (T const * data, size_t count, CompareOp op, T value)							\
+		{																									\
+			switch (CurrentLevel())																			\
+			{																								\
+			case SimdLevel::AVX2: return Avx2::Count<Avx2##Suffix> (data, count, op, value);				\
+			case SimdLevel::SSE2: return Sse2::Count<Sse2##Suffix> (data, count, op, value);				\
+			default: return ScalarCount (data, count, op, value);											\
+			}																								\
+		}																									\
+		static void filter (T const * data, size_t count, CompareOp op, T value, uint64_t * bitmap)			\
+		{																									\
+			switch (CurrentLevel())																			\
+			{																								\
+			case SimdLevel::AVX2: Avx2::Filter<Avx2##Suffix> (data, count, op, value, bitmap); break;		\
+			case SimdLevel::SSE2: Sse2::Filter<Sse2##Suffix> (data, count, op, value, bitmap); break;		\
+			default: ScalarFilter (data, 0, count, op, value, bitmap); break;								\
+			}																								\
+		}																									\
+	};
+
+DYSTRUCT_DEFINE_SIMD_DISPATCH (int32_t, int64_t, I32)
+DYSTRUCT_DEFINE_SIMD_DISPATCH (uint32_t, uint64_t, U32)
+DYSTRUCT_DEFINE_SIMD_DISPATCH (float, double, F32)
+DYSTRUCT_DEFINE_SIMD_DISPATCH (double, double, F64)
+
+#undef DYSTRUCT_DEFINE_SIMD_DISPATCH
+
+#endif	// DYSTRUCT_X86
+
+//======================================================================
+// Strided gather/scatter. AVX2 has gathers (but no scatters) for 32 and
+// 64-bit elements; everything else is a straight loop with a fixed-size copy.
+//======================================================================
+
+template <size_t N>
+void ScalarGather (Byte const * src, size_t src_stride, size_t count, Byte * dst)
+{
+	for (size_t i = 0; i < count; ++i, src += src_stride, dst += N)
+		std::memcpy (dst, src, N);
+}
+
+//----------------------------------------------------------------------
+
+template <size_t N>
+void ScalarScatter (Byte const * src, size_t count, Byte * dst, size_t dst_stride)
+{
+	for (size_t i = 0; i < count; ++i, src += N, dst += dst_stride)
+		std::memcpy (dst, src, N);
+}
+
+//----------------------------------------------------------------------
+
+#if DYSTRUCT_X86
+
+	namespace Avx2 {
+
+// The indices are 32-bit byte offsets, so the stride has to be small enough for 8 of them.
+inline bool CanGather (size_t stride) {return stride > 0 && stride <= size_t(std::numeric_limits<int32_t>::max() / 8);}
+
+DYSTRUCT_TARGET_AVX2 size_t Gather32 (Byte const * src, size_t src_stride, size_t count, Byte * dst)
+{
+	auto s = int32_t(src_stride);
+	auto idx = _mm256_setr_epi32 (0, s, 2 * s, 3 * s, 4 * s, 5 * s, 6 * s, 7 * s);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8, src += 8 * src_stride)
+	{
+		auto v = _mm256_i32gather_epi32 (reinterpret_cast<int const *>(src), idx, 1);
+		_mm256_storeu_si256 (reinterpret_cast<__m256i *>(dst + i * 4), v);
+	}
+	return i;
+}
+
+DYSTRUCT_TARGET_AVX2 size_t Gather64 (Byte const * src, size_t src_stride, size_t count, Byte * dst)
+{
+	auto s = int32_t(src_stride);
+	auto idx = _mm_setr_epi32 (0, s, 2 * s, 3 * s);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4, src += 4 * src_stride)
+	{
+		auto v = _mm256_i32gather_epi64 (reinterpret_cast<long long const *>(src), idx, 1);
+		_mm256_storeu_si256 (reinterpret_cast<__m256i *>(dst + i * 8), v);
+	}
+	return i;
+}
+
+	}	// namespace Avx2
+
+#endif	// DYSTRUCT_X86
+
+//======================================================================
+// Conversions. The scalar version handles every pair (and all the tails;)
+// the SIMD versions work on "lanes", i.e. what a Basic looks like to the
+// hardware, so e.g. Byte, U8 and (unsigned) Char all share the same code.
+//======================================================================
+
+template <typename T>
+inline bool IsNegative (T v, std::true_type) {return v < 0;}
+template <typename T>
+inline bool IsNegative (T, std::false_type) {return false;}
+
+//----------------------------------------------------------------------
+
+// Integer to integer; clamps to the range of D.
+template <typename D, typename S>
+inline D ClampInt (S v)
+{
+	if (IsNegative (v, std::integral_constant<bool, std::is_signed<S>::value>()))
+	{
+		if (!std::is_signed<D>::value)
+			return D(0);
+		if (int64_t(v) < int64_t(std::numeric_limits<D>::min()))
+			return std::numeric_limits<D>::min();
+		return D(v);
+	}
+	if (uint64_t(v) > uint64_t(std::numeric_limits<D>::max()))
+		return std::numeric_limits<D>::max();
+	return D(v);
+}
+
+//----------------------------------------------------------------------
+
+// Out-of-range float to integer casts are undefined, so these always clamp.
+template <typename D, typename S>
+inline D ClampFloat (S v)
+{
+	if (v != v)
+		return D(0);
+	if (v <= S(std::numeric_limits<D>::min()))
+		return std::numeric_limits<D>::min();
+	if (v >= S(std::numeric_limits<D>::max()))
+		return std::numeric_limits<D>::max();
+	return static_cast<D>(v);
+}
+
+//----------------------------------------------------------------------
+
+template <typename D, typename S,
+	int Kind = std::is_same<D, bool>::value ? 0
+		: (std::is_integral<D>::value && std::is_floating_point<S>::value) ? 1
+		: (std::is_integral<D>::value && std::is_integral<S>::value) ? 2
+		: 3>
+struct ValueConverter
+{
+	static D Convert (S v, bool /*saturate*/) {return static_cast<D>(v);}
+};
+
+template <typename D, typename S>
+struct ValueConverter<D, S, 0>
+{
+	static D Convert (S v, bool /*saturate*/) {return v != S(0);}
+};
+
+template <typename D, typename S>
+struct ValueConverter<D, S, 1>
+{
+	static D Convert (S v, bool /*saturate*/) {return ClampFloat<D> (v);}
+};
+
+template <typename D, typename S>
+struct ValueConverter<D, S, 2>
+{
+	static D Convert (S v, bool saturate) {return saturate ? ClampInt<D> (v) : static_cast<D>(v);}
+};
+
+//----------------------------------------------------------------------
+
+template <typename S, typename D>
+void ScalarConvert (S const * src, D * dst, size_t count, bool saturate)
+{
+	for (size_t i = 0; i < count; ++i)
+		dst[i] = ValueConverter<D, S>::Convert (src[i], saturate);
+}
+
+//----------------------------------------------------------------------
+
+enum class Lane
+{
+	I8, U8, I16, U16, I32, U32, I64, U64,
+	F32, F64,
+	Other,		// Bool; always scalar
+};
+
+template <typename T>
+constexpr Lane LaneOf ()
+{
+	return std::is_same<T, bool>::value ? Lane::Other
+		: std::is_floating_point<T>::value ? (4 == sizeof(T) ? Lane::F32 : (8 == sizeof(T) ? Lane::F64 : Lane::Other))
+		: 1 == sizeof(T) ? (std::is_signed<T>::value ? Lane::I8 : Lane::U8)
+		: 2 == sizeof(T) ? (std::is_signed<T>::value ? Lane::I16 : Lane::U16)
+		: 4 == sizeof(T) ? (std::is_signed<T>::value ? Lane::I32 : Lane::U32)
+		: 8 == sizeof(T) ? (std::is_signed<T>::value ? Lane::I64 : Lane::U64)
+		: Lane::Other;
+}
+
+inline bool LaneIsInt (Lane l) {return l <= Lane::U64;}
+inline bool LaneIsSigned (Lane l) {return LaneIsInt (l) && 0 == (int(l) & 1);}
+inline unsigned LaneBytes (Lane l) {return LaneIsInt (l) ? 1U << (int(l) / 2) : (Lane::F32 == l ? 4 : 8);}
+
+//----------------------------------------------------------------------
+
+#if DYSTRUCT_X86
+
+	namespace Sse2 {
+
+DYSTRUCT_TARGET_SSE2 inline __m128i LoadI (Byte const * p) {return _mm_loadu_si128 (reinterpret_cast<__m128i const *>(p));}
+DYSTRUCT_TARGET_SSE2 inline void StoreI (Byte * p, __m128i v) {_mm_storeu_si128 (reinterpret_cast<__m128i *>(p), v);}
+
+// Sign extension of the low 16 bits of each 32-bit lane
+DYSTRUCT_TARGET_SSE2 inline __m128i Sext16In32 (__m128i v) {return _mm_srai_epi32 (_mm_slli_epi32 (v, 16), 16);}
+
+// The bits to put above each lane when widening it
+DYSTRUCT_TARGET_SSE2 inline __m128i Ext8 (__m128i v, bool is_signed) {return is_signed ? _mm_cmpgt_epi8 (_mm_setzero_si128 (), v) : _mm_setzero_si128 ();}
+DYSTRUCT_TARGET_SSE2 inline __m128i Ext16 (__m128i v, bool is_signed) {return is_signed ? _mm_cmpgt_epi16 (_mm_setzero_si128 (), v) : _mm_setzero_si128 ();}
+DYSTRUCT_TARGET_SSE2 inline __m128i Ext32 (__m128i v, bool is_signed) {return is_signed ? _mm_cmpgt_epi32 (_mm_setzero_si128 (), v) : _mm_setzero_si128 ();}
+
+// Each of these returns the number of elements it converted, always from the start.
+
+DYSTRUCT_TARGET_SSE2 size_t Widen8To16 (Byte const * src, Byte * dst, size_t count, bool is_signed)
+{
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		auto x = LoadI (src + i);
+		auto e = Ext8 (x, is_signed);
+		StoreI (dst + 2 * i, _mm_unpacklo_epi8 (x, e));
+		StoreI (dst + 2 * i + 16, _mm_unpackhi_epi8 (x, e));
+	}
+	return i;
+}
+
+DYSTRUCT_TARGET_SSE2 size_t Widen8To32 (Byte const * src, Byte * dst, size_t count, bool is_signed)
+{
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		auto x = LoadI (src + i);
+		auto e = Ext8 (x, is_signed);
+		auto lo = _mm_unpacklo_epi8 (x, e);
+		auto hi = _mm_unpackhi_epi8 (x, e);
+		auto elo = Ext16 (lo, is_signed);
+		auto ehi = Ext16 (hi, is_signed);
+		StoreI (dst + 4 * i, _mm_unpacklo_epi16 (lo, elo));
+		StoreI (dst + 4 * i + 16, _mm_unpackhi_epi16 (lo, elo));
+		StoreI (dst + 4 * i + 32, _mm_unpacklo_epi16 (hi, ehi));
+		StoreI (dst + 4 * i + 48, _mm_unpackhi_epi16 (hi, ehi));
+	}
+	return i;
+}
+
+DYSTRUCT_TARGET_SSE2 size_t Widen16To32 (Byte const * src, Byte * dst, size_t count, bool is_signed)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		auto x = LoadI (src + 2 * i);
+		auto e = Ext16 (x, is_signed);
+		StoreI (dst + 4 * i, _mm_unpacklo_epi16 (x, e));
+		StoreI (dst + 4 * i + 16, _mm_unpackhi_epi16 (x, e));
+	}
+	return i;
+}
+
+DYSTRUCT_TARGET_SSE2 size_t Widen32To64 (Byte const * src, Byte * dst, size_t count, bool is_signed)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		auto x = LoadI (src + 4 * i);
+		auto e = Ext32 (x, is_signed);
+		StoreI (dst + 8 * i, _mm_unpacklo_epi32 (x, e));
+		StoreI (dst + 8 * i + 16, _mm_unpackhi_epi32 (x, e));
+	}
+	return i;
+}
+
+// Narrowing, keeping the low bits (i.e. wrapping around.)
+
+DYSTRUCT_TARGET_SSE2 size_t Narrow16To8 (Byte const * src, Byte * dst, size_t count)
+{
+	auto m = _mm_set1_epi16 (0xFF);
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+		StoreI (dst + i, _mm_packus_epi16 (_mm_and_si128 (LoadI (src + 2 * i), m), _mm_and_si128 (LoadI (src + 2 * i + 16), m)));
+	return i;
+}
+
+DYSTRUCT_TARGET_SSE2 size_t Narrow32To16 (Byte const * src, Byte * dst, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+		StoreI (dst + 2 * i, _mm_packs_epi32 (Sext16In32 (LoadI (src + 4 * i)), Sext16In32 (LoadI (src + 4 * i + 16))));
+	return i;
+}
+
+DYSTRUCT_TARGET_SSE2 size_t Narrow32To8 (Byte const * src, Byte * dst, size_t count)
+{
+	auto m = _mm_set1_epi16 (0xFF);
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		auto a = _mm_packs_epi32 (Sext16In32 (LoadI (src + 4 * i)), Sext16In32 (LoadI (src + 4 * i + 16)));
+		auto b = _mm_packs_epi32 (Sext16In32 (LoadI (src + 4 * i + 32)), Sext16In32 (LoadI (src + 4 * i + 48)));
+		StoreI (dst + i, _mm_packus_epi16 (_mm_and_si128 (a, m), _mm_and_si128 (b, m)));
+	}
+	return i;
+}
+
+DYSTRUCT_TARGET_SSE2 size_t Narrow64To32 (Byte const * src, Byte * dst, size_t count)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		auto a = _mm_shuffle_epi32 (LoadI (src + 8 * i), _MM_SHUFFLE (2, 0, 2, 0));
+		auto b = _mm_shuffle_epi32 (LoadI (src + 8 * i + 16), _MM_SHUFFLE (2, 0, 2, 0));
+		StoreI (dst + 4 * i, _mm_unpacklo_epi64 (a, b));
+	}
+	return i;
+}
+
+// Saturating narrowing of signed sources; these are just the pack instructions.
+
+DYSTRUCT_TARGET_SSE2 size_t PackSigned16To8 (Byte const * src, Byte * dst, size_t count, bool to_unsigned)
+{
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		auto a = LoadI (src + 2 * i);
+		auto b = LoadI (src + 2 * i + 16);
+		StoreI (dst + i, to_unsigned ? _mm_packus_epi16 (a, b) : _mm_packs_epi16 (a, b));
+	}
+	return i;
+}
+
+DYSTRUCT_TARGET_SSE2 size_t PackSigned32To16 (Byte const * src, Byte * dst, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+		StoreI (dst + 2 * i, _mm_packs_epi32 (LoadI (src + 4 * i), LoadI (src + 4 * i + 16)));
+	return i;
+}
+
+DYSTRUCT_TARGET_SSE2 size_t PackSigned32To8 (Byte const * src, Byte * dst, size_t count, bool to_unsigned)
+{
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		auto a = _mm_packs_epi32 (LoadI (src + 4 * i), LoadI (src + 4 * i + 16));
+		auto b = _mm_packs_epi32 (LoadI (src + 4 * i + 32), LoadI (src + 4 * i + 48));
+		StoreI (dst + i, to_unsigned ? _mm_packus_epi16 (a, b) : _mm_packs_epi16 (a, b));
+	}
+	return i;
+}
+
+// Floats
+
+DYSTRUCT_TARGET_SSE2 size_t I32ToF32 (int32_t const * src, float * dst, size_t count)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps (dst + i, _mm_cvtepi32_ps (_mm_loadu_si128 (reinterpret_cast<__m128i const *>(src + i))));
+	return i;
+}
+
+DYSTRUCT_TARGET_SSE2 size_t I32ToF64 (int32_t const * src, double * dst, size_t count)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		auto x = _mm_loadu_si128 (reinterpret_cast<__m128i const *>(src + i));
+		_mm_storeu_pd (dst + i, _mm_cvtepi32_pd (x));
+		_mm_storeu_pd (dst + i + 2, _mm_cvtepi32_pd (_mm_srli_si128 (x, 8)));
+	}
+	return i;
+}
+
+DYSTRUCT_TARGET_SSE2 size_t F32ToF64 (float const * src, double * dst, size_t count)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		auto x = _mm_loadu_ps (src + i);
+		_mm_storeu_pd (dst + i, _mm_cvtps_pd (x));
+		_mm_storeu_pd (dst + i + 2, _mm_cvtps_pd (_mm_movehl_ps (x, x)));
+	}
+	return i;
+}
+
+DYSTRUCT_TARGET_SSE2 size_t F64ToF32 (double const * src, float * dst, size_t count)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps (dst + i, _mm_movelh_ps (_mm_cvtpd_ps (_mm_loadu_pd (src + i)), _mm_cvtpd_ps (_mm_loadu_pd (src + i + 2))));
+	return i;
+}
+
+// NaNs become zero, then clamp. Floats can't hold INT32_MAX, and the
+// conversion gives INT32_MIN for anything too big, which we flip.
+DYSTRUCT_TARGET_SSE2 size_t F32ToI32 (float const * src, int32_t * dst, size_t count)
+{
+	auto lo = _mm_set1_ps (-2147483648.0f);
+	auto hi = _mm_set1_ps (2147483648.0f);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		auto x = _mm_loadu_ps (src + i);
+		x = _mm_max_ps (_mm_and_ps (x, _mm_cmpord_ps (x, x)), lo);
+		auto r = _mm_xor_si128 (_mm_cvttps_epi32 (x), _mm_castps_si128 (_mm_cmpge_ps (x, hi)));
+		_mm_storeu_si128 (reinterpret_cast<__m128i *>(dst + i), r);
+	}
+	return i;
+}
+
+DYSTRUCT_TARGET_SSE2 inline __m128i ClampCvtPd (__m128d x)
+{
+	x = _mm_and_pd (x, _mm_cmpord_pd (x, x));
+	x = _mm_min_pd (_mm_max_pd (x, _mm_set1_pd (-2147483648.0)), _mm_set1_pd (2147483647.0));
+	return _mm_cvttpd_epi32 (x);
+}
+
+DYSTRUCT_TARGET_SSE2 size_t F64ToI32 (double const * src, int32_t * dst, size_t count)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		auto r = _mm_unpacklo_epi64 (ClampCvtPd (_mm_loadu_pd (src + i)), ClampCvtPd (_mm_loadu_pd (src + i + 2)));
+		_mm_storeu_si128 (reinterpret_cast<__m128i *>(dst + i), r);
+	}
+	return i;
+}
+
+//----------------------------------------------------------------------
+
+size_t ConvertPrefix (Lane s, Lane d, Byte const * src, Byte * dst, size_t count, bool saturate)
+{
+	if (LaneIsInt (s) && LaneIsInt (d))
+	{
+		auto sb = LaneBytes (s), db = LaneBytes (d);
+		bool ss = LaneIsSigned (s), ds = LaneIsSigned (d);
+
+		if (sb < db)
+		{
+			if (saturate && ss && !ds)		// Negatives would have to become zero
+				return 0;
+			if (1 == sb && 2 == db) return Widen8To16 (src, dst, count, ss);
+			if (1 == sb && 4 == db) return Widen8To32 (src, dst, count, ss);
+			if (2 == sb && 4 == db) return Widen16To32 (src, dst, count, ss);
+			if (4 == sb && 8 == db) return Widen32To64 (src, dst, count, ss);
+		}
+		else if (sb > db && !saturate)
+		{
+			if (2 == sb && 1 == db) return Narrow16To8 (src, dst, count);
+			if (4 == sb && 2 == db) return Narrow32To16 (src, dst, count);
+			if (4 == sb && 1 == db) return Narrow32To8 (src, dst, count);
+			if (8 == sb && 4 == db) return Narrow64To32 (src, dst, count);
+		}
+		else if (sb > db && ss)
+		{
+			if (2 == sb && 1 == db) return PackSigned16To8 (src, dst, count, !ds);
+			if (4 == sb && 2 == db && ds) return PackSigned32To16 (src, dst, count);
+			if (4 == sb && 1 == db) return PackSigned32To8 (src, dst, count, !ds);
+		}
+		return 0;
+	}
+
+	if (Lane::I32 == s && Lane::F32 == d) return I32ToF32 (reinterpret_cast<int32_t const *>(src), reinterpret_cast<float *>(dst), count);
+	if (Lane::I32 == s && Lane::F64 == d) return I32ToF64 (reinterpret_cast<int32_t const *>(src), reinterpret_cast<double *>(dst), count);
+	if (Lane::F32 == s && Lane::F64 == d) return F32ToF64 (reinterpret_cast<float const *>(src), reinterpret_cast<double *>(dst), count);
+	if (Lane::F64 == s && Lane::F32 == d) return F64ToF32 (reinterpret_cast<double const *>(src), reinterpret_cast<float *>(dst), count);
+	if (Lane::F32 == s && Lane::I32 == d) return F32ToI32 (reinterpret_cast<float const *>(src), reinterpret_cast<int32_t *>(dst), count);
+	if (Lane::F64 == s && Lane::I32 == d) return F64ToI32 (reinterpret_cast<double const *>(src), reinterpret_cast<int32_t *>(dst), count);
+	return 0;
+}
+
+	}	// namespace Sse2
+
+//----------------------------------------------------------------------
+
+	namespace Avx2 {
+
+DYSTRUCT_TARGET_AVX2 inline __m128i LoadI (Byte const * p) {return _mm_loadu_si128 (reinterpret_cast<__m128i const *>(p));}
+DYSTRUCT_TARGET_AVX2 inline void StoreI (Byte * p, __m256i v) {_mm256_storeu_si256 (reinterpret_cast<__m256i *>(p), v);}
+
+DYSTRUCT_TARGET_AVX2 size_t Widen8To16 (Byte const * src, Byte * dst, size_t count, bool is_signed)
+{
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		auto x = LoadI (src + i);
+		StoreI (dst + 2 * i, is_signed ? _mm256_cvtepi8_epi16 (x) : _mm256_cvtepu8_epi16 (x));
+	}
+	return i;
+}
+
+DYSTRUCT_TARGET_AVX2 size_t Widen8To32 (Byte const * src, Byte * dst, size_t count, bool is_signed)
+{
+	size_t i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		auto x = LoadI (src + i);
+		auto y = _mm_srli_si128 (x, 8);
+		StoreI (dst + 4 * i, is_signed ? _mm256_cvtepi8_epi32 (x) : _mm256_cvtepu8_epi32 (x));
+		StoreI (dst + 4 * i + 32, is_signed ? _mm256_cvtepi8_epi32 (y) : _mm256_cvtepu8_epi32 (y));
+	}
+	return i;
+}
+
+DYSTRUCT_TARGET_AVX2 size_t Widen16To32 (Byte const * src, Byte * dst, size_t count, bool is_signed)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		auto x = LoadI (src + 2 * i);
+		StoreI (dst + 4 * i, is_signed ? _mm256_cvtepi16_epi32 (x) : _mm256_cvtepu16_epi32 (x));
+	}
+	return i;
+}
+
+DYSTRUCT_TARGET_AVX2 size_t Widen32To64 (Byte const * src, Byte * dst, size_t count, bool is_signed)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		auto x = LoadI (src + 4 * i);
+		StoreI (dst + 8 * i, is_signed ? _mm256_cvtepi32_epi64 (x) : _mm256_cvtepu32_epi64 (x));
+	}
+	return i;
+}
+
+DYSTRUCT_TARGET_AVX2 size_t I32ToF32 (int32_t const * src, float * dst, size_t count)
+{
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+		_mm256_storeu_ps (dst + i, _mm256_cvtepi32_ps (_mm256_loadu_si256 (reinterpret_cast<__m256i const *>(src + i))));
+	return i;
+}
+
+DYSTRUCT_TARGET_AVX2 size_t I32ToF64 (int32_t const * src, double * dst, size_t count)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+		_mm256_storeu_pd (dst + i, _mm256_cvtepi32_pd (_mm_loadu_si128 (reinterpret_cast<__m128i const *>(src + i))));
+	return i;
+}
+
+DYSTRUCT_TARGET_AVX2 size_t F32ToF64 (float const * src, double * dst, size_t count)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+		_mm256_storeu_pd (dst + i, _mm256_cvtps_pd (_mm_loadu_ps (src + i)));
+	return i;
+}
+
+DYSTRUCT_TARGET_AVX2 size_t F64ToF32 (double const * src, float * dst, size_t count)
+{
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+		_mm_storeu_ps (dst + i, _mm256_cvtpd_ps (_mm256_loadu_pd (src + i)));
+	return i;
+}
+
+// Same tricks as the SSE2 versions.
+DYSTRUCT_TARGET_AVX2 size_t F32ToI32 (float const * src, int32_t * dst, size_t count)
+{
+	auto lo = _mm256_set1_ps (-2147483648.0f);
+	auto hi = _mm256_set1_ps (2147483648.0f);
+	size_t i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		auto x = _mm256_loadu_ps (src + i);
+		x = _mm256_max_ps (_mm256_and_ps (x, _mm256_cmp_ps (x, x, _CMP_ORD_Q)), lo);
+		auto r = _mm256_xor_si256 (_mm256_cvttps_epi32 (x), _mm256_castps_si256 (_mm256_cmp_ps (x, hi, _CMP_GE_OQ)));
+		_mm256_storeu_si256 (reinterpret_cast<__m256i *>(dst + i), r);
+	}
+	return i;
+}
+
+DYSTRUCT_TARGET_AVX2 size_t F64ToI32 (double const * src, int32_t * dst, size_t count)
+{
+	auto lo = _mm256_set1_pd (-2147483648.0);
+	auto hi = _mm256_set1_pd (2147483647.0);
+	size_t i = 0;
+	for (; i + 4 <= count; i += 4)
+	{
+		auto x = _mm256_loadu_pd (src + i);
+		x = _mm256_min_pd (_mm256_max_pd (_mm256_and_pd (x, _mm256_cmp_pd (x, x, _CMP_ORD_Q)), lo), hi);
+		_mm_storeu_si128 (reinterpret_cast<__m128i *>(dst + i), _mm256_cvttpd_epi32 (x));
+	}
+	return i;
+}
+
+//----------------------------------------------------------------------
+
+// Widening and floats; the narrowing pack instructions work within 128-bit
+// halves in AVX2, so for those the SSE2 versions are as good as it gets.
+size_t ConvertPrefix (Lane s, Lane d, Byte const * src, Byte * dst, size_t count, bool saturate)
+{
+	if (LaneIsInt (s) && LaneIsInt (d))
+	{
+		auto sb = LaneBytes (s), db = LaneBytes (d);
+		bool ss = LaneIsSigned (s), ds = LaneIsSigned (d);
+
+		if (sb < db && !(saturate && ss && !ds))
+		{
+			if (1 == sb && 2 == db) return Widen8To16 (src, dst, count, ss);
+			if (1 == sb && 4 == db) return Widen8To32 (src, dst, count, ss);
+			if (2 == sb && 4 == db) return Widen16To32 (src, dst, count, ss);
+			if (4 == sb && 8 == db) return Widen32To64 (src, dst, count, ss);
+		}
+		return Sse2::ConvertPrefix (s, d, src, dst, count, saturate);
+	}
+
+	if (Lane::I32 == s && Lane::F32 == d) return I32ToF32 (reinterpret_cast<int32_t const *>(src), reinterpret_cast<float *>(dst), count);
+	if (Lane::I32 == s && Lane::F64 == d) return I32ToF64 (reinterpret_cast<int32_t const *>(src), reinterpret_cast<double *>(dst), count);
+	if (Lane::F32 == s && Lane::F64 == d) return F32ToF64 (reinterpret_cast<float const *>(src), reinterpret_cast<double *>(dst), count);
+	if (Lane::F64 == s && Lane::F32 == d) return F64ToF32 (reinterpret_cast<double const *>(src), reinterpret_cast<float *>(dst), count);
+	if (Lane::F32 == s && Lane::I32 == d) return F32ToI32 (reinterpret_cast<float const *>(src), reinterpret_cast<int32_t *>(dst), count);
+	if (Lane::F64 == s && Lane::I32 == d) return F64ToI32 (reinterpret_cast<double const *>(src), reinterpret_cast<int32_t *>(dst), count);
+	return Sse2::ConvertPrefix (s, d, src, dst, count, saturate);
+}
+
+	}	// namespace Avx2
+
+#endif	// DYSTRUCT_X86
+
+//----------------------------------------------------------------------
+
+size_t SimdConvertPrefix (Lane s, Lane d, Byte const * src, Byte * dst, size_t count, bool saturate)
+{
+#if DYSTRUCT_X86
+	switch (CurrentLevel())
+	{
+	case SimdLevel::AVX2: return Avx2::ConvertPrefix (s, d, src, dst, count, saturate);
+	case SimdLevel::SSE2: return Sse2::ConvertPrefix (s, d, src, dst, count, saturate);
+	default: return 0;
+	}
+#else
+	(void)s; (void)d; (void)src; (void)dst; (void)count; (void)saturate;
+	return 0;
+#endif
+}
+
+//----------------------------------------------------------------------
+
+// Small integers to floats go through I32, a block at a time.
+size_t StagedConvertPrefix (Lane s, Lane d, Byte const * src, Byte * dst, size_t count)
+{
+	size_t const Block = 256;
+	int32_t staging [Block];
+
+	size_t i = 0;
+	for (; i + Block <= count; i += Block)
+	{
+		auto w = SimdConvertPrefix (s, Lane::I32, src + i * LaneBytes (s), reinterpret_cast<Byte *>(staging), Block, false);
+		auto c = (w == Block) ? SimdConvertPrefix (Lane::I32, d, reinterpret_cast<Byte const *>(staging), dst + i * LaneBytes (d), Block, false) : 0;
+		if (c != Block)		// No SIMD at this level; the caller does it all
+			break;
+	}
+	return i;
+}
+
+//----------------------------------------------------------------------
+
+template <typename S, typename D>
+void ConvertEntry (void const * src, void * dst, size_t count, bool saturate)
+{
+	auto s = static_cast<S const *>(src);
+	auto d = static_cast<D *>(dst);
+	auto sl = LaneOf<S>();
+	auto dl = LaneOf<D>();
+
+	// Same bits, and the values don't change (or we don't care, when wrapping around)
+	if (Lane::Other != sl && (sl == dl || (LaneIsInt (sl) && LaneIsInt (dl) && LaneBytes (sl) == LaneBytes (dl) && !saturate)))
+	{
+		std::memcpy (dst, src, count * sizeof(S));
+		return;
+	}
+
+	size_t done = 0;
+	if (Lane::Other != sl && Lane::Other != dl)
+	{
+		done = SimdConvertPrefix (sl, dl, static_cast<Byte const *>(src), static_cast<Byte *>(dst), count, saturate);
+		if (0 == done && LaneIsInt (sl) && LaneBytes (sl) < 4 && !LaneIsInt (dl))
+			done = StagedConvertPrefix (sl, dl, static_cast<Byte const *>(src), static_cast<Byte *>(dst), count);
+	}
+
+	ScalarConvert (s + done, d + done, count - done, saturate);
+}
+
+//----------------------------------------------------------------------
+
+#define DYSTRUCT_CONVERT_ROW(S)	\
+	{	\
+		&ConvertEntry<S, int8_t>, &ConvertEntry<S, uint8_t>, &ConvertEntry<S, int16_t>, &ConvertEntry<S, uint16_t>,	\
+		&ConvertEntry<S, int32_t>, &ConvertEntry<S, uint32_t>, &ConvertEntry<S, int64_t>, &ConvertEntry<S, uint64_t>,	\
+		&ConvertEntry<S, float>, &ConvertEntry<S, double>,	\
+		&ConvertEntry<S, bool>, &ConvertEntry<S, uint8_t>, &ConvertEntry<S, char>, &ConvertEntry<S, wchar_t>,	\
+	}
+
+// [src][dst], in the order of Basic; the types are what details::BasicTypeMap says.
+Kernels::ConvertFn const gc_Converters [int(Basic::_count)][int(Basic::_count)] =
+{
+	DYSTRUCT_CONVERT_ROW(int8_t),
+	DYSTRUCT_CONVERT_ROW(uint8_t),
+	DYSTRUCT_CONVERT_ROW(int16_t),
+	DYSTRUCT_CONVERT_ROW(uint16_t),
+	DYSTRUCT_CONVERT_ROW(int32_t),
+	DYSTRUCT_CONVERT_ROW(uint32_t),
+	DYSTRUCT_CONVERT_ROW(int64_t),
+	DYSTRUCT_CONVERT_ROW(uint64_t),
+	DYSTRUCT_CONVERT_ROW(float),
+	DYSTRUCT_CONVERT_ROW(double),
+	DYSTRUCT_CONVERT_ROW(bool),
+	DYSTRUCT_CONVERT_ROW(uint8_t),
+	DYSTRUCT_CONVERT_ROW(char),
+	DYSTRUCT_CONVERT_ROW(wchar_t),
+};
+static_assert (int(Basic::_count) == 14, "Did you forget something?!");
+
+#undef DYSTRUCT_CONVERT_ROW
+
+//======================================================================
+
+	}	// namespace
+
+//======================================================================
+//======================================================================
+
+SimdLevel Kernels::DetectedSimdLevel ()
+{
+	static SimdLevel const s_detected = DetectSimdLevel ();
+	return s_detected;
+}
+
+//----------------------------------------------------------------------
+
+SimdLevel Kernels::ActiveSimdLevel ()
+{
+	return CurrentLevel ();
+}
+
+//----------------------------------------------------------------------
+
+void Kernels::SetSimdLevel (SimdLevel level)
+{
+	LevelSetting().store (std::min (level, DetectedSimdLevel()), std::memory_order_relaxed);
+}
+
+//----------------------------------------------------------------------
+
+template <Basic basic_type>
+typename Kernels::KernelTraits<basic_type>::SumType Kernels::Sum (typename KernelTraits<basic_type>::ElemType const * data, size_t count)
+{
+	return Dispatch<typename KernelTraits<basic_type>::ElemType, typename KernelTraits<basic_type>::SumType>::sum (data, count);
+}
+
+//----------------------------------------------------------------------
+
+template <Basic basic_type>
+bool Kernels::Min (typename KernelTraits<basic_type>::ElemType const * data, size_t count, typename KernelTraits<basic_type>::ElemType & out)
+{
+	if (0 == count)
+		return false;
+
+	out = Dispatch<typename KernelTraits<basic_type>::ElemType, typename KernelTraits<basic_type>::SumType>::min (data, count);
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+template <Basic basic_type>
+bool Kernels::Max (typename KernelTraits<basic_type>::ElemType const * data, size_t count, typename KernelTraits<basic_type>::ElemType & out)
+{
+	if (0 == count)
+		return false;
+
+	out = Dispatch<typename KernelTraits<basic_type>::ElemType, typename KernelTraits<basic_type>::SumType>::max (data, count);
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+template <Basic basic_type>
+size_t Kernels::Count (typename KernelTraits<basic_type>::ElemType const * data, size_t count, CompareOp op, typename KernelTraits<basic_type>::ElemType value)
+{
+	return Dispatch<typename KernelTraits<basic_type>::ElemType, typename KernelTraits<basic_type>::SumType>::count (data, count, op, value);
+}
+
+//----------------------------------------------------------------------
+
+template <Basic basic_type>
+void Kernels::Filter (typename KernelTraits<basic_type>::ElemType const * data, size_t count, CompareOp op, typename KernelTraits<basic_type>::ElemType value, uint64_t * bitmap)
+{
+	Dispatch<typename KernelTraits<basic_type>::ElemType, typename KernelTraits<basic_type>::SumType>::filter (data, count, op, value, bitmap);
+}
+
+//----------------------------------------------------------------------
+
+size_t Kernels::BitmapCount (uint64_t const * bitmap, size_t count)
+{
+	size_t ret = 0;
+	for (size_t i = 0, e = BitmapWords(count); i < e; ++i)
+		ret += PopCount64 (bitmap[i]);
+	return ret;
+}
+
+//----------------------------------------------------------------------
+
+void Kernels::BitmapAnd (uint64_t * dst, uint64_t const * src, size_t count)
+{
+	for (size_t i = 0, e = BitmapWords(count); i < e; ++i)
+		dst[i] &= src[i];
+}
+
+//----------------------------------------------------------------------
+
+void Kernels::BitmapOr (uint64_t * dst, uint64_t const * src, size_t count)
+{
+	for (size_t i = 0, e = BitmapWords(count); i < e; ++i)
+		dst[i] |= src[i];
+}
+
+//----------------------------------------------------------------------
+
+Kernels::ConvertFn Kernels::Converter (Basic src_type, Basic dst_type)
+{
+	assert (int(src_type) >= 0 && src_type < Basic::_count);
+	assert (int(dst_type) >= 0 && dst_type < Basic::_count);
+
+	return gc_Converters[int(src_type)][int(dst_type)];
+}
+
+//======================================================================
+
+void details::GatherStrided (void const * src, size_t src_stride, size_t count, size_t elem_size, void * dst)
+{
+	auto s = static_cast<Byte const *>(src);
+	auto d = static_cast<Byte *>(dst);
+
+#if DYSTRUCT_X86
+	if (SimdLevel::AVX2 == CurrentLevel() && Avx2::CanGather (src_stride))
+	{
+		size_t done = 0;
+		if (4 == elem_size)
+			done = Avx2::Gather32 (s, src_stride, count, d);
+		else if (8 == elem_size)
+			done = Avx2::Gather64 (s, src_stride, count, d);
+
+		s += done * src_stride;
+		d += done * elem_size;
+		count -= done;
+	}
+#endif
+
+	switch (elem_size)
+	{
+	case 1: ScalarGather<1> (s, src_stride, count, d); break;
+	case 2: ScalarGather<2> (s, src_stride, count, d); break;
+	case 4: ScalarGather<4> (s, src_stride, count, d); break;
+	case 8: ScalarGather<8> (s, src_stride, count, d); break;
+	default:
+		for (size_t i = 0; i < count; ++i)
+			std::memcpy (d + i * elem_size, s + i * src_stride, elem_size);
+		break;
+	}
+}
+
+//----------------------------------------------------------------------
+
+void details::ScatterStrided (void const * src, size_t count, size_t elem_size, void * dst, size_t dst_stride)
+{
+	auto s = static_cast<Byte const *>(src);
+	auto d = static_cast<Byte *>(dst);
+
+	switch (elem_size)
+	{
+	case 1: ScalarScatter<1> (s, count, d, dst_stride); break;
+	case 2: ScalarScatter<2> (s, count, d, dst_stride); break;
+	case 4: ScalarScatter<4> (s, count, d, dst_stride); break;
+	case 8: ScalarScatter<8> (s, count, d, dst_stride); break;
+	default:
+		for (size_t i = 0; i < count; ++i)
+			std::memcpy (d + i * dst_stride, s + i * elem_size, elem_size);
+		break;
+	}
+}
+
+//----------------------------------------------------------------------
+
+#define DYSTRUCT_INSTANTIATE_KERNELS(B)																						\
+	template Kernels::KernelTraits<Basic::B>::SumType Kernels::Sum<Basic::B> (KernelTraits<Basic::B>::ElemType const *, size_t);	\
+	template bool Kernels::Min<Basic::B> (KernelTraits<Basic::B>::ElemType const *, size_t, KernelTraits<Basic::B>::ElemType &);	\
+	template bool Kernels::Max<Basic::B> (KernelTraits<Basic::B>::ElemType const *, size_t, KernelTraits<Basic::B>::ElemType &);	\
+	template size_t Kernels::Count<Basic::B> (KernelTraits<Basic::B>::ElemType const *, size_t, CompareOp, KernelTraits<Basic::B>::ElemType);	\
+	template void Kernels::Filter<Basic::B> (KernelTraits<Basic::B>::ElemType const *, size_t, CompareOp, KernelTraits<Basic::B>::ElemType, uint64_t *);
+
+DYSTRUCT_INSTANTIATE_KERNELS (I8)
+DYSTRUCT_INSTANTIATE_KERNELS (U8)
+DYSTRUCT_INSTANTIATE_KERNELS (I16)
+DYSTRUCT_INSTANTIATE_KERNELS (U16)
+DYSTRUCT_INSTANTIATE_KERNELS (I32)
+DYSTRUCT_INSTANTIATE_KERNELS (U32)
+DYSTRUCT_INSTANTIATE_KERNELS (I64)
+DYSTRUCT_INSTANTIATE_KERNELS (U64)
+DYSTRUCT_INSTANTIATE_KERNELS (F32)
+DYSTRUCT_INSTANTIATE_KERNELS (F64)
+DYSTRUCT_INSTANTIATE_KERNELS (Bool)
+DYSTRUCT_INSTANTIATE_KERNELS (Byte)
+DYSTRUCT_INSTANTIATE_KERNELS (Char)
+DYSTRUCT_INSTANTIATE_KERNELS (WChar)
+static_assert (int(Basic::_count) == 14, "Did you forget something?!");
+
+#undef DYSTRUCT_INSTANTIATE_KERNELS
+
+//----------------------------------------------------------------------
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================
@@ -0,0 +1,339 @@
+//======================================================================
+
+#include <dystruct/Morph.h>
+#include <dystruct/InstanceArray.h>
+#include <dystruct/Kernels.h>
+
+#include <algorithm>
+#include <cstring>
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+	namespace {
+
+//======================================================================
+
+// Same layout and same meaning, i.e. the bytes can just be copied over.
+bool SameLayout (Type const * a, Type const * b)
+{
+	if (a == b && a->isTriviallyCopyable())
+		return true;
+	if (a->getFamily() != b->getFamily() || a->getSizeOf() != b->getSizeOf())
+		return false;
+
+	switch (a->getFamily())
+	{
+	case Family::Basic:
+		return a->asBasic()->getType() == b->asBasic()->getType();
+
+	case Family::Enum:		// Enums are just their values
+		return true;
+
+	case Family::String:	// Same slot format, and long chars and interned ids must come from the same pool
+		return a->asString()->isInterned() == b->asString()->isInterned()
+			&& &a->asString()->getPool() == &b->asString()->getPool();
+
+	case Family::Array:
+		return a->getElemCount() == b->getElemCount() && SameLayout (a->asArray()->getElemType(), b->asArray()->getElemType());
+
+	case Family::DyStruct: {
+		auto sa = a->asDyStruct();
+		auto sb = b->asDyStruct();
+		if (sa->getFieldCount() != sb->getFieldCount())
+			return false;
+		for (SizeType i = 0, e = sa->getFieldCount(); i < e; ++i)
+		{
+			auto const & fa = sa->getField(i);
+			auto const & fb = sb->getField(i);
+			if (fa.offset != fb.offset || fa.name != fb.name || !SameLayout (fa.type, fb.type))
+				return false;
+		}
+		return true;
+	}
+
+	default:
+		return false;
+	}
+}
+
+//----------------------------------------------------------------------
+
+// Basics are themselves; Enums are their unsigned underlying type.
+bool LeafBasic (Type const * type, Basic & out)
+{
+	if (type->isBasic())
+	{
+		out = type->asBasic()->getType();
+		return true;
+	}
+	if (type->isEnum())
+	{
+		out = type->asEnum()->getUnderlyingType();
+		return true;
+	}
+	return false;
+}
+
+//----------------------------------------------------------------------
+
+inline void RunOp (MorphOp const & op, Byte const * src, Byte * dst, bool saturate)
+{
+	switch (op.kind)
+	{
+	case MorphOp::Kind::Copy:
+		std::memcpy (dst + op.dst_offset, src + op.src_offset, op.size);
+		break;
+	case MorphOp::Kind::Convert:
+		Kernels::Convert (op.src_basic, src + op.src_offset, op.dst_basic, dst + op.dst_offset, op.count, saturate);
+		break;
+	case MorphOp::Kind::Default:
+		std::memset (dst + op.dst_offset, 0, op.size);
+		break;
+	default:
+		assert (false);
+		break;
+	}
+}
+
+//======================================================================
+
+	}	// namespace
+
+//======================================================================
+//======================================================================
+
+MorphPlan TypeManager::buildMorph (CompiledType const & src, CompiledType const & dst, bool saturate) const
+{
+	MorphPlan ret;
+	ret.m_src = &src;
+	ret.m_dst = &dst;
+	ret.m_saturate = saturate;
+	ret.build (src.rawType(), 0, dst.rawType(), 0);
+	return ret;
+}
+
+//======================================================================
+
+bool MorphPlan::isPlainCopy () const
+{
+	return m_ops.size() == 1
+		&& m_ops[0].kind == MorphOp::Kind::Copy
+		&& m_ops[0].src_offset == 0
+		&& m_ops[0].dst_offset == 0
+		&& m_ops[0].size == m_dst->sizeOf();
+}
+
+//----------------------------------------------------------------------
+
+void MorphPlan::apply (InstancePtr src, InstancePtr dst) const
+{
+	assert (src.typePtr() == m_src && !src.isNull());
+	assert (dst.typePtr() == m_dst && !dst.isNull());
+
+	for (auto const & op : m_ops)
+		RunOp (op, src.data(), dst.data(), m_saturate);
+}
+
+//----------------------------------------------------------------------
+
+void MorphPlan::apply (Byte const * src, SizeType src_stride, Byte * dst, SizeType dst_stride, size_t count) const
+{
+	if (isPlainCopy() && src_stride == m_src->sizeOf() && dst_stride == m_dst->sizeOf())
+	{
+		std::memcpy (dst, src, count * dst_stride);
+		return;
+	}
+
+	bool has_convert = std::any_of (m_ops.begin(), m_ops.end(), [] (MorphOp const & op) {return op.kind == MorphOp::Kind::Convert;});
+	if (!has_convert)
+	{
+		for (size_t i = 0; i < count; ++i, src += src_stride, dst += dst_stride)
+			for (auto const & op : m_ops)
+				RunOp (op, src, dst, m_saturate);
+		return;
+	}
+
+	// Conversions go one element at a time over a batch of instances: gather
+	// it into a dense buffer, convert that in one go, and scatter it back.
+	size_t const Batch = 256;
+	uint64_t src_buffer [Batch], dst_buffer [Batch];
+
+	for (size_t first = 0; first < count; first += Batch)
+	{
+		auto n = std::min (Batch, count - first);
+		auto s = src + first * src_stride;
+		auto d = dst + first * dst_stride;
+
+		for (size_t i = 0; i < n; ++i)
+			for (auto const & op : m_ops)
+				if (op.kind != MorphOp::Kind::Convert)
+					RunOp (op, s + i * src_stride, d + i * dst_stride, m_saturate);
+
+		for (auto const & op : m_ops)
+			if (op.kind == MorphOp::Kind::Convert)
+				for (CountType j = 0; j < op.count; ++j)
+				{
+					details::GatherStrided (s + op.src_offset + j * op.src_elem_size, src_stride, n, op.src_elem_size, src_buffer);
+					Kernels::Convert (op.src_basic, src_buffer, op.dst_basic, dst_buffer, n, m_saturate);
+					details::ScatterStrided (dst_buffer, n, op.dst_elem_size, d + op.dst_offset + j * op.dst_elem_size, dst_stride);
+				}
+	}
+}
+
+//----------------------------------------------------------------------
+
+bool MorphPlan::apply (InstanceArray const & src, InstanceArray & dst) const
+{
+	assert (src.typePtr() == m_src);
+	assert (dst.typePtr() == m_dst);
+
+	// No point constructing the new instances just to overwrite them: the ops
+	// write every byte but padding, and a Default op's zeros are what
+	// construct() would have left there, for every family
+	if (!dst.resizeUninitialized (src.size()))
+		return false;
+
+	apply (src.data(), src.stride(), dst.data(), dst.stride(), src.size());
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+void MorphPlan::build (Type const * src, OffsetType src_offset, Type const * dst, OffsetType dst_offset)
+{
+	MorphOp op;
+	op.src_offset = src_offset;
+	op.dst_offset = dst_offset;
+	op.size = dst->getSizeOf();
+	op.src_basic = op.dst_basic = Basic::Byte;
+	op.count = 1;
+	op.src_elem_size = src->getSizeOf();
+	op.dst_elem_size = dst->getSizeOf();
+
+	if (SameLayout (src, dst))
+	{
+		op.kind = MorphOp::Kind::Copy;
+		addOp (op);
+		return;
+	}
+
+	if (LeafBasic (src, op.src_basic) && LeafBasic (dst, op.dst_basic))
+	{
+		op.kind = MorphOp::Kind::Convert;
+		addOp (op);
+		return;
+	}
+
+	if (src->isArray() && dst->isArray())
+	{
+		auto src_elem = src->asArray()->getElemType();
+		auto dst_elem = dst->asArray()->getElemType();
+		auto src_elem_size = src_elem->getSizeOf();
+		auto dst_elem_size = dst_elem->getSizeOf();
+		auto common = std::min (src->getElemCount(), dst->getElemCount());
+
+		if (common > 0 && LeafBasic (src_elem, op.src_basic) && LeafBasic (dst_elem, op.dst_basic) && !SameLayout (src_elem, dst_elem))
+		{
+			op.kind = MorphOp::Kind::Convert;
+			op.size = common * dst_elem_size;
+			op.count = common;
+			op.src_elem_size = src_elem_size;
+			op.dst_elem_size = dst_elem_size;
+			addOp (op);
+		}
+		else
+			for (CountType i = 0; i < common; ++i)
+				build (src_elem, src_offset + i * src_elem_size, dst_elem, dst_offset + i * dst_elem_size);
+
+		if (dst->getElemCount() > common)
+		{
+			op.kind = MorphOp::Kind::Default;
+			op.dst_offset = dst_offset + common * dst_elem_size;
+			op.size = (dst->getElemCount() - common) * dst_elem_size;
+			addOp (op);
+		}
+		return;
+	}
+
+	if (src->isDyStruct() && dst->isDyStruct())
+	{
+		auto src_struct = src->asDyStruct();
+		auto dst_struct = dst->asDyStruct();
+		for (SizeType i = 0, e = dst_struct->getFieldCount(); i < e; ++i)
+		{
+			auto const & df = dst_struct->getField(i);
+			auto sf = src_struct->findField (df.name);
+			if (sf)
+				build (sf->type, src_offset + sf->offset, df.type, dst_offset + df.offset);
+			else
+			{
+				op.kind = MorphOp::Kind::Default;
+				op.dst_offset = dst_offset + df.offset;
+				op.size = df.type->getSizeOf();
+				addOp (op);
+			}
+		}
+		return;
+	}
+
+	op.kind = MorphOp::Kind::Default;
+	addOp (op);
+}
+
+//----------------------------------------------------------------------
+
+// Ops arrive in destination order, and together they cover every byte of
+// the destination except padding; so bridging a gap between two ops only
+// ever writes to padding.
+void MorphPlan::addOp (MorphOp const & op)
+{
+	if (0 == op.size)
+		return;
+
+	if (!m_ops.empty())
+	{
+		auto & last = m_ops.back();
+		assert (op.dst_offset >= last.dst_offset + last.size);
+
+		if (last.kind == op.kind)
+			switch (op.kind)
+			{
+			case MorphOp::Kind::Copy:
+				if (op.src_offset >= last.src_offset && op.src_offset - last.src_offset == op.dst_offset - last.dst_offset)
+				{
+					last.size = op.dst_offset + op.size - last.dst_offset;
+					return;
+				}
+				break;
+			case MorphOp::Kind::Convert:
+				if (op.src_basic == last.src_basic && op.dst_basic == last.dst_basic
+					&& op.src_elem_size == last.src_elem_size && op.dst_elem_size == last.dst_elem_size
+					&& op.src_offset == last.src_offset + last.count * last.src_elem_size
+					&& op.dst_offset == last.dst_offset + last.count * last.dst_elem_size)
+				{
+					last.count += op.count;
+					last.size += op.size;
+					return;
+				}
+				break;
+			case MorphOp::Kind::Default:
+				last.size = op.dst_offset + op.size - last.dst_offset;
+				return;
+			default:
+				break;
+			}
+	}
+
+	m_ops.push_back (op);
+}
+
+//----------------------------------------------------------------------
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================
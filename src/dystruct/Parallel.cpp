@@ -0,0 +1,241 @@
+//======================================================================
+
+#include <dystruct/Parallel.h>
+
+#include <deque>
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+	namespace {
+
+size_t const gc_ChunkBytes = 32 * 1024;		// Enough work per chunk to not notice the stealing
+unsigned const gc_ChunksPerThread = 4;		// Enough chunks to even out uneven work
+
+// Which pool (if any) the current thread works for, and its deque there
+thread_local ThreadPool const * t_pool = nullptr;
+thread_local unsigned t_queue = 0;
+
+size_t Gcd (size_t a, size_t b)
+{
+	while (0 != b)
+	{
+		auto t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
+
+	}	// namespace
+
+//======================================================================
+
+size_t details::RowsPerChunk (size_t count, SizeType stride, unsigned threads)
+{
+	// Row k starts at k * stride, which is on a line boundary every granule rows
+	size_t granule = (0 == stride) ? 1 : gc_CacheLineSize / Gcd (stride, gc_CacheLineSize);
+	size_t by_size = gc_ChunkBytes / std::max<size_t> (1, stride);
+	size_t chunks = size_t(std::max (1U, threads)) * gc_ChunksPerThread;
+	size_t by_balance = (count + chunks - 1) / chunks;
+
+	size_t rows = std::max<size_t> (1, std::min (by_size, by_balance));
+	return (rows + granule - 1) / granule * granule;
+}
+
+//======================================================================
+
+struct ThreadPool::Queue
+{
+	std::mutex lock;
+	std::deque<Range> ranges;	// Pushed and popped at the back; stolen from the front
+};
+
+//----------------------------------------------------------------------
+
+unsigned ThreadPool::DefaultWorkerCount ()
+{
+	auto hw = std::thread::hardware_concurrency ();
+	return (hw > 1) ? hw - 1 : 0;
+}
+
+//----------------------------------------------------------------------
+
+ThreadPool & ThreadPool::Default ()
+{
+	static ThreadPool s_pool;
+	return s_pool;
+}
+
+//----------------------------------------------------------------------
+
+ThreadPool::ThreadPool (unsigned worker_count)
+	: m_queues {}
+	, m_workers {}
+	, m_queued {0}
+	, m_sleeping {0}
+	, m_sleep_lock {}
+	, m_wake {}
+	, m_stop {false}
+{
+	for (unsigned i = 0; i <= worker_count; ++i)
+		m_queues.emplace_back (new Queue);
+
+	m_workers.reserve (worker_count);
+	for (unsigned i = 0; i < worker_count; ++i)
+		m_workers.emplace_back (&ThreadPool::workerMain, this, i);
+}
+
+//----------------------------------------------------------------------
+
+ThreadPool::~ThreadPool ()
+{
+	{
+		std::lock_guard<std::mutex> guard {m_sleep_lock};
+		m_stop = true;
+	}
+	m_wake.notify_all ();
+
+	for (auto & w : m_workers)
+		w.join ();
+}
+
+//----------------------------------------------------------------------
+
+void ThreadPool::runTasks (size_t count, TaskFunc func, void * context)
+{
+	if (m_workers.empty() || count <= 1)
+	{
+		for (size_t i = 0; i < count; ++i)
+			func (context, i);
+		return;
+	}
+
+	Job job;
+	job.func = func;
+	job.context = context;
+	job.remaining.store (count);
+
+	// Help out (with this batch or any other) until the last task is done
+	auto home = homeQueue ();
+	push (home, Range {&job, 0, count});
+	while (0 != job.remaining.load (std::memory_order_acquire))
+	{
+		Range range;
+		if (popOrSteal (home, range))
+			execute (home, range);
+		else
+			std::this_thread::yield ();
+	}
+}
+
+//----------------------------------------------------------------------
+
+void ThreadPool::workerMain (unsigned index)
+{
+	t_pool = this;
+	t_queue = index;
+
+	for (;;)
+	{
+		Range range;
+		if (popOrSteal (index, range))
+		{
+			execute (index, range);
+			continue;
+		}
+
+		// push() only notifies if it sees someone sleeping, and we only
+		// sleep if we see nothing queued; both are seq_cst, so one of us
+		// sees the other.
+		std::unique_lock<std::mutex> lock {m_sleep_lock};
+		m_sleeping.fetch_add (1);
+		m_wake.wait (lock, [this] {return m_stop || 0 != m_queued.load ();});
+		m_sleeping.fetch_sub (1);
+		if (m_stop)
+			return;
+	}
+}
+
+//----------------------------------------------------------------------
+
+unsigned ThreadPool::homeQueue () const
+{
+	return (this == t_pool) ? t_queue : workerCount();
+}
+
+//----------------------------------------------------------------------
+
+void ThreadPool::push (unsigned queue, Range range)
+{
+	{
+		std::lock_guard<std::mutex> guard {m_queues[queue]->lock};
+		m_queues[queue]->ranges.push_back (range);
+	}
+	m_queued.fetch_add (1);
+
+	if (0 != m_sleeping.load ())
+	{
+		std::lock_guard<std::mutex> guard {m_sleep_lock};
+		m_wake.notify_one ();
+	}
+}
+
+//----------------------------------------------------------------------
+
+bool ThreadPool::popOrSteal (unsigned home, Range & out)
+{
+	if (0 == m_queued.load ())
+		return false;
+
+	auto n = unsigned(m_queues.size());
+	for (unsigned k = 0; k < n; ++k)
+	{
+		auto & q = *m_queues[(home + k) % n];
+		std::lock_guard<std::mutex> guard {q.lock};
+		if (q.ranges.empty())
+			continue;
+
+		if (0 == k)
+		{
+			out = q.ranges.back();
+			q.ranges.pop_back ();
+		}
+		else
+		{
+			out = q.ranges.front();
+			q.ranges.pop_front ();
+		}
+		m_queued.fetch_sub (1);
+		return true;
+	}
+	return false;
+}
+
+//----------------------------------------------------------------------
+
+void ThreadPool::execute (unsigned home, Range range)
+{
+	while (range.last - range.first > 1)
+	{
+		auto mid = range.first + (range.last - range.first) / 2;
+		push (home, Range {range.job, mid, range.last});
+		range.last = mid;
+	}
+
+	// The job lives on the stack of whoever started it, and it may be gone
+	// as soon as this task is counted
+	auto job = range.job;
+	job->func (job->context, range.first);
+	job->remaining.fetch_sub (1, std::memory_order_acq_rel);
+}
+
+//----------------------------------------------------------------------
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================
@@ -0,0 +1,524 @@
+//======================================================================
+
+#include <dystruct/InstanceFile.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+	namespace {
+
+//======================================================================
+
+char const gc_RegistryMagic [8] = {'D', 'y', 'S', 't', 'r', 'R', 'e', 'g'};
+uint32_t const gc_RegistryVersion = 1;
+uint32_t const gc_EndianMarker = 0x01020304;
+
+struct RegistryHeader
+{
+	char magic [8];
+	uint32_t version;
+	uint32_t endian_marker;
+	uint32_t id_size;			// sizeof(ID) of the writer; IDs of different sizes never match
+	uint32_t type_count;
+	uint32_t compiled_count;
+	uint32_t alias_count;		// Extra names of CompiledTypes; see CompileOptions::share_interned
+};
+
+//----------------------------------------------------------------------
+
+// Gives every type an index, such that the types a type refers to come before it.
+bool NumberTypes (Type const * type, std::unordered_map<Type const *, uint32_t> & index, std::vector<Type const *> & order)
+{
+	if (index.end() != index.find (type))
+		return true;
+
+	switch (type->getFamily())
+	{
+	case Family::Basic:
+	case Family::Enum:
+	case Family::String:
+		break;
+
+	case Family::Array:
+		if (!NumberTypes (type->asArray()->getElemType(), index, order))
+			return false;
+		break;
+
+	case Family::Vector:
+		if (!NumberTypes (type->asVector()->getElemType(), index, order))
+			return false;
+		break;
+
+	case Family::Set:
+	case Family::Map:
+		if (!NumberTypes (type->asHashTable()->getKeyType(), index, order))
+			return false;
+		if (type->isMap() && !NumberTypes (type->asMap()->getValueType(), index, order))
+			return false;
+		break;
+
+	case Family::DyStruct:
+		for (SizeType i = 0, e = type->asDyStruct()->getFieldCount(); i < e; ++i)
+			if (!NumberTypes (type->asDyStruct()->getField(i).type, index, order))
+				return false;
+		break;
+
+	default:
+		return false;
+	}
+
+	index[type] = uint32_t(order.size());
+	order.push_back (type);
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+template <typename T>
+void PutVector (std::vector<Byte> & out, std::vector<T> const & v)
+{
+	details::BlobPut (out, uint32_t(v.size()));
+	for (auto x : v)
+		details::BlobPut (out, x);
+}
+
+template <typename T>
+bool GetVector (Byte const * & cur, Byte const * end, std::vector<T> & v)
+{
+	uint32_t count = 0;
+	if (!details::BlobGet (cur, end, count) || size_t(end - cur) / sizeof(T) < count)
+		return false;
+
+	v.resize (count);
+	for (auto & x : v)
+		details::BlobGet (cur, end, x);
+	return true;
+}
+
+//======================================================================
+
+	}	// namespace
+
+//======================================================================
+//======================================================================
+
+bool TypeManager::saveRegistry (std::vector<Byte> & out) const
+{
+	std::lock_guard<std::mutex> guard {m_lock};
+
+	std::unordered_map<Type const *, uint32_t> index;
+	std::vector<Type const *> order;
+	for (auto t : m_raw_types)
+		if (!NumberTypes (t, index, order))
+			return false;
+	for (auto c : m_compiled_types)
+		if (!NumberTypes (c->rawType(), index, order))
+			return false;
+
+	RegistryHeader header;
+	std::memset (&header, 0, sizeof(header));
+	std::memcpy (header.magic, gc_RegistryMagic, sizeof(header.magic));
+	header.version = gc_RegistryVersion;
+	header.endian_marker = gc_EndianMarker;
+	header.id_size = sizeof(ID);
+	header.type_count = uint32_t(order.size());
+	header.compiled_count = uint32_t(m_compiled_types.size());
+	for (auto const & n : m_names)
+		if (n.second->m_name != n.first)
+			++header.alias_count;
+
+	out.clear ();
+	details::BlobPut (out, header);
+
+	for (auto t : order)
+	{
+		details::BlobPut (out, uint8_t(t->getFamily()));
+		switch (t->getFamily())
+		{
+		case Family::Basic:
+			details::BlobPut (out, uint8_t(t->asBasic()->m_basic_type));
+			break;
+
+		case Family::Enum: {
+			auto e = t->asEnum();
+			details::BlobPut (out, uint8_t(e->m_underlying_type));
+			details::BlobPut (out, e->m_max_value);
+			details::BlobPut (out, uint32_t(e->m_name_values.size()));
+			for (auto const & nv : e->m_name_values)
+			{
+				details::BlobPutString (out, nv.first);
+				details::BlobPut (out, nv.second);
+			}
+		}	break;
+
+		case Family::String:
+			details::BlobPut (out, t->asString()->m_inline_capacity);
+			details::BlobPut (out, uint8_t(t->asString()->m_interned));
+			break;
+
+		case Family::Vector:
+			details::BlobPut (out, index[t->asVector()->m_element_type]);
+			break;
+
+		case Family::Set:
+			details::BlobPut (out, index[t->asSet()->m_key_type]);
+			break;
+
+		case Family::Map:
+			details::BlobPut (out, index[t->asMap()->m_key_type]);
+			details::BlobPut (out, index[t->asMap()->m_value_type]);
+			break;
+
+		case Family::Array:
+			details::BlobPut (out, uint32_t(t->asArray()->m_count));
+			details::BlobPut (out, index[t->asArray()->m_element_type]);
+			break;
+
+		case Family::DyStruct: {
+			auto st = t->asDyStruct();
+			details::BlobPut (out, st->m_cur_size);
+			details::BlobPut (out, st->m_cur_end);
+			details::BlobPut (out, st->m_cur_align);
+			details::BlobPut (out, uint32_t(st->m_fields.size()));
+			for (auto const & f : st->m_fields)
+			{
+				details::BlobPutString (out, f.name);
+				details::BlobPut (out, index[f.type]);
+				details::BlobPut (out, f.offset);
+			}
+		}	break;
+
+		default:
+			return false;
+		}
+	}
+
+	std::unordered_map<CompiledType const *, uint32_t> compiled_index;
+	for (auto c : m_compiled_types)
+	{
+		compiled_index.emplace (c, uint32_t(compiled_index.size()));
+		details::BlobPutString (out, c->m_name);
+		details::BlobPut (out, index[c->m_type]);
+		details::BlobPut (out, uint64_t(c->m_id));
+		details::BlobPut (out, c->m_reorder_savings);
+		details::BlobPut (out, uint8_t(c->m_bytewise));
+		details::BlobPut (out, uint8_t(c->m_options.reorder_fields));
+		details::BlobPut (out, uint8_t(c->m_options.pool_cache_line_slots));
+		details::BlobPut (out, uint8_t(c->m_options.pool_thread_cache));
+		details::BlobPut (out, uint8_t(c->m_field_index.m_fallback));
+		PutVector (out, c->m_field_index.m_seeds);
+		PutVector (out, c->m_field_index.m_slots);
+	}
+
+	for (auto const & n : m_names)
+		if (n.second->m_name != n.first)
+		{
+			details::BlobPutString (out, n.first);
+			details::BlobPut (out, compiled_index[n.second]);
+		}
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+bool TypeManager::saveRegistry (std::string const & path) const
+{
+	std::vector<Byte> blob;
+	if (!saveRegistry (blob))
+		return false;
+
+	auto f = std::fopen (path.c_str(), "wb");
+	if (nullptr == f)
+		return false;
+
+	bool ok = 1 == std::fwrite (blob.data(), blob.size(), 1, f);
+	ok = (0 == std::fclose (f)) && ok;
+	if (!ok)
+		std::remove (path.c_str());
+
+	return ok;
+}
+
+//----------------------------------------------------------------------
+
+bool TypeManager::loadRegistry (Byte const * data, size_t size, bool verify_ids)
+{
+	std::lock_guard<std::mutex> guard {m_lock};
+
+	// Owns everything until the whole blob has checked out
+	struct Pending
+	{
+		std::vector<Type *> types;
+		std::vector<CompiledType *> compiled;
+		bool keep = false;
+
+		~Pending ()
+		{
+			if (keep)
+				return;
+			for (auto c : compiled)
+				delete c;
+			for (auto t : types)
+				delete t;
+		}
+	} pending;
+
+	Byte const * cur = data;
+	Byte const * end = data + size;
+
+	RegistryHeader header;
+	if (!details::BlobGet (cur, end, header)
+		|| 0 != std::memcmp (header.magic, gc_RegistryMagic, sizeof(header.magic))
+		|| gc_RegistryVersion != header.version
+		|| gc_EndianMarker != header.endian_marker
+		|| sizeof(ID) != header.id_size
+		|| header.type_count > size)		// Every type takes at least a byte
+		return false;
+
+	auto & types = pending.types;
+	types.reserve (header.type_count);
+
+	for (uint32_t i = 0; i < header.type_count; ++i)
+	{
+		uint8_t family = 0;
+		if (!details::BlobGet (cur, end, family))
+			return false;
+
+		switch (Family(family))
+		{
+		case Family::Basic: {
+			uint8_t basic = 0;
+			if (!details::BlobGet (cur, end, basic) || basic >= uint8_t(Basic::_count))
+				return false;
+			types.push_back (new BasicType {Basic(basic)});
+		}	break;
+
+		case Family::Enum: {
+			auto e = new EnumType {Basic::U32};
+			types.push_back (e);
+
+			uint8_t underlying = 0;
+			int64_t max_value = 0;
+			uint32_t count = 0;
+			if (!details::BlobGet (cur, end, underlying) || !details::BlobGet (cur, end, max_value) || !details::BlobGet (cur, end, count)
+				|| count > size_t(end - cur) / 8)	// An entry takes at least 8 bytes
+				return false;
+
+			// The size of the Enum comes from its entries, not from what the blob says
+			e->m_name_values.reserve (count);
+			for (uint32_t j = 0; j < count; ++j)
+			{
+				std::string name;
+				uint32_t value = 0;
+				if (!details::BlobGetString (cur, end, name) || !details::BlobGet (cur, end, value) || !e->addEntry (std::move(name), value))
+					return false;
+			}
+			if (e->getMaxValue() != max_value || uint8_t(e->getUnderlyingType()) != underlying)
+				return false;
+		}	break;
+
+		case Family::String: {
+			SizeType inline_capacity = 0;
+			uint8_t interned = 0;
+			if (!details::BlobGet (cur, end, inline_capacity) || !details::BlobGet (cur, end, interned) || inline_capacity > StringType::MaxInlineCapacity)
+				return false;
+			types.push_back (new StringType {*m_string_pool, inline_capacity, 0 != interned});
+		}	break;
+
+		case Family::Vector: {
+			uint32_t elem = 0;
+			if (!details::BlobGet (cur, end, elem) || elem >= i)
+				return false;
+			if (!types[elem]->isTriviallyCopyable() || !types[elem]->isTriviallyDestructible())
+				return false;
+			types.push_back (new VectorType {types[elem]});
+		}	break;
+
+		case Family::Set:
+		case Family::Map: {
+			uint32_t key = 0, value = 0;
+			if (!details::BlobGet (cur, end, key) || key >= i)
+				return false;
+			if (!types[key]->isBasic() && !types[key]->isEnum() && !types[key]->isString())
+				return false;
+			if (Family::Set == Family(family))
+			{
+				types.push_back (new SetType {types[key]});
+				break;
+			}
+
+			if (!details::BlobGet (cur, end, value) || value >= i)
+				return false;
+			if (!types[value]->isTriviallyCopyable() || !types[value]->isTriviallyDestructible())
+				return false;
+			types.push_back (new MapType {types[key], types[value]});
+		}	break;
+
+		case Family::Array: {
+			uint32_t count = 0, elem = 0;
+			if (!details::BlobGet (cur, end, count) || !details::BlobGet (cur, end, elem) || elem >= i)
+				return false;
+			if (count > 0 && types[elem]->getSizeOf() > std::numeric_limits<SizeType>::max() / count)
+				return false;
+			types.push_back (new ArrayType {count, types[elem]});
+		}	break;
+
+		case Family::DyStruct: {
+			auto st = new DyStructType {};
+			types.push_back (st);
+
+			uint32_t count = 0;
+			if (!details::BlobGet (cur, end, st->m_cur_size) || !details::BlobGet (cur, end, st->m_cur_end)
+				|| !details::BlobGet (cur, end, st->m_cur_align) || !details::BlobGet (cur, end, count)
+				|| count > size_t(end - cur) / 12)	// A field takes at least 12 bytes
+				return false;
+			auto align = st->m_cur_align;
+			if (0 == align || 0 != (align & (align - 1)) || align > details::gc_CacheLineSize)
+				return false;
+
+			// Fields are laid out in order, so each one must start at or after the end of the last
+			SizeType prev_end = 0;
+			st->m_fields.reserve (count);
+			for (uint32_t j = 0; j < count; ++j)
+			{
+				std::string name;
+				uint32_t type = 0, offset = 0;
+				if (!details::BlobGetString (cur, end, name) || !details::BlobGet (cur, end, type) || !details::BlobGet (cur, end, offset))
+					return false;
+				if (name.empty() || type >= i || offset < prev_end || offset > st->m_cur_end || types[type]->getSizeOf() > st->m_cur_end - offset)
+					return false;
+				prev_end = offset + types[type]->getSizeOf();
+				auto field_align = types[type]->getAlignment();
+				if (field_align > align || 0 != offset % field_align)
+					return false;
+
+				st->m_fields.emplace_back (types[type], std::move(name));
+				st->m_fields.back().offset = offset;
+			}
+			if (st->m_cur_end > st->m_cur_size || st->m_cur_size != details::AlignUp (st->m_cur_end, align))
+				return false;
+			st->rebuildFieldMap ();
+		}	break;
+
+		default:
+			return false;
+		}
+	}
+
+	auto & compiled = pending.compiled;
+	compiled.reserve (std::min<size_t> (header.compiled_count, size));
+	std::unordered_set<Name> names;
+
+	for (uint32_t i = 0; i < header.compiled_count; ++i)
+	{
+		Name name;
+		uint32_t type = 0;
+		uint64_t id = 0;
+		SizeType reorder_savings = 0;
+		uint8_t bytewise = 0, fallback = 0;
+		uint8_t reorder_fields = 0, pool_cache_line_slots = 0, pool_thread_cache = 0;
+		std::vector<uint32_t> seeds;
+		std::vector<SizeType> slots;
+
+		if (!details::BlobGetString (cur, end, name) || !details::BlobGet (cur, end, type) || !details::BlobGet (cur, end, id)
+			|| !details::BlobGet (cur, end, reorder_savings) || !details::BlobGet (cur, end, bytewise)
+			|| !details::BlobGet (cur, end, reorder_fields) || !details::BlobGet (cur, end, pool_cache_line_slots)
+			|| !details::BlobGet (cur, end, pool_thread_cache) || !details::BlobGet (cur, end, fallback)
+			|| !GetVector (cur, end, seeds) || !GetVector (cur, end, slots))
+			return false;
+
+		if (type >= header.type_count || !names.insert (name).second || m_names.end() != m_names.find (name))
+			return false;
+
+		// The index must at least not send lookups out of bounds
+		auto t = types[type];
+		DyStructType const * st = t->isDyStruct() ? t->asDyStruct() : nullptr;
+		SizeType field_count = st ? st->getFieldCount() : 0;
+		if (!st && (fallback || !seeds.empty() || !slots.empty()))
+			return false;
+		if (!fallback && (slots.size() != field_count || (field_count > 0 && seeds.empty())))
+			return false;
+		for (auto s : slots)
+			if (s >= field_count)
+				return false;
+
+		CompileOptions options;
+		options.reorder_fields = (0 != reorder_fields);
+		options.pool_cache_line_slots = (0 != pool_cache_line_slots);
+		options.pool_thread_cache = (0 != pool_thread_cache);
+
+		// A saved index that doesn't find every field is rebuilt from scratch
+		FieldIndex field_index = st ? FieldIndex {st, std::move(seeds), std::move(slots), 0 != fallback} : FieldIndex {};
+		for (SizeType j = 0; j < field_count; ++j)
+			if (field_index.find (st->getField(j).name) != &st->getField(j))
+			{
+				field_index = FieldIndex {st};
+				break;
+			}
+
+		compiled.push_back (new CompiledType {t, name, ID(id), reorder_savings, options, std::move(field_index)});
+
+		if (compiled.back()->isBytewiseComparable() != (0 != bytewise))
+			return false;
+
+		if (verify_ids && CompiledType::CalculateID (t) != compiled.back()->id())
+			return false;
+	}
+
+	std::vector<std::pair<Name, uint32_t>> aliases;
+	aliases.reserve (std::min<size_t> (header.alias_count, size));
+	for (uint32_t i = 0; i < header.alias_count; ++i)
+	{
+		Name name;
+		uint32_t index = 0;
+		if (!details::BlobGetString (cur, end, name) || !details::BlobGet (cur, end, index))
+			return false;
+		if (index >= compiled.size() || !names.insert (name).second || m_names.end() != m_names.find (name))
+			return false;
+		aliases.emplace_back (std::move(name), index);
+	}
+
+	if (cur != end)
+		return false;
+
+	for (auto t : types)
+		m_raw_types.insert (t);
+	for (auto c : compiled)
+	{
+		m_compiled_types.insert (c);
+		m_names[c->name()] = c;
+	}
+	for (auto const & a : aliases)
+		m_names[a.first] = compiled[a.second];
+	pending.keep = true;
+	publishNames ();
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+bool TypeManager::loadRegistry (std::string const & path, bool verify_ids)
+{
+	MappedFile file;
+	if (!file.open (path))
+		return false;
+
+	return loadRegistry (file.data(), file.size(), verify_ids);
+}
+
+//----------------------------------------------------------------------
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================
@@ -0,0 +1,560 @@
+//======================================================================
+
+#include <dystruct/Schema.h>
+
+#include <cstring>
+#include <limits>
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+	namespace {
+
+//======================================================================
+
+struct Token
+{
+	enum class Kind
+	{
+		End,
+		Ident,
+		Number,
+		Punct,
+	};
+
+	Kind kind;
+	char const * begin;
+	size_t len;
+	uint64_t number;
+	unsigned line;
+	unsigned column;
+};
+
+//----------------------------------------------------------------------
+
+// A recursive descent parser straight over the text; tokens are just
+// pointers into it, and the only strings made are the names that end up
+// in the Types.
+class Parser
+{
+public:
+	Parser (TypeManager & tm, char const * text, size_t length, SchemaResult & result)
+		: m_tm (tm)
+		, m_cur (text)
+		, m_end (text + length)
+		, m_line_start (text)
+		, m_line (1)
+		, m_tok ()
+		, m_result (result)
+		, m_basics {}
+		, m_decls ()
+		, m_table ()
+	{
+		m_table.resize (64, 0);
+	}
+
+	bool run (CompileOptions const & options);
+
+private:
+	struct Decl
+	{
+		std::string name;
+		FieldIndex::HashType hash;
+		Type * type;
+		unsigned line;
+		unsigned column;
+	};
+
+	bool next ();
+	bool skipSpace ();
+	bool fail (Token const & at, std::string message);
+
+	bool isPunct (char c) const {return Token::Kind::Punct == m_tok.kind && c == *m_tok.begin;}
+	bool isWord (char const * word) const {return Token::Kind::Ident == m_tok.kind && std::strlen(word) == m_tok.len && 0 == std::memcmp (m_tok.begin, word, m_tok.len);}
+	bool expectPunct (char c);
+	bool expectIdent (Token & out);
+	bool expectNumber (uint32_t & out);
+	std::string tokenText (Token const & tok) const {return std::string (tok.begin, tok.len);}
+
+	DyStructType * parseStructBody ();
+	EnumType * parseEnumBody ();
+	Type * parseFieldType ();
+
+	Type * lookup (char const * name, size_t len);
+	Decl const * findDecl (char const * name, size_t len, FieldIndex::HashType hash) const;
+	bool declare (Token const & name, Type * type);
+
+private:
+	TypeManager & m_tm;
+	char const * m_cur;
+	char const * const m_end;
+	char const * m_line_start;
+	unsigned m_line;
+	Token m_tok;
+	SchemaResult & m_result;
+
+	BasicType * m_basics [int(Basic::_count)];	// Made on first use, then shared
+	std::vector<Decl> m_decls;
+	std::vector<uint32_t> m_table;				// Open addressing over m_decls; index + 1, or 0 if empty
+};
+
+//----------------------------------------------------------------------
+
+bool Parser::run (CompileOptions const & options)
+{
+	if (!next ())
+		return false;
+
+	while (Token::Kind::End != m_tok.kind)
+	{
+		bool is_struct = isWord ("struct");
+		if (!is_struct && !isWord ("enum"))
+			return fail (m_tok, "expected 'struct' or 'enum'");
+		if (!next ())
+			return false;
+
+		Token name;
+		if (!expectIdent (name))
+			return false;
+
+		Type * type = is_struct ? static_cast<Type *>(parseStructBody ()) : static_cast<Type *>(parseEnumBody ());
+		if (nullptr == type || !declare (name, type))
+			return false;
+
+		if (isPunct (';') && !next ())
+			return false;
+	}
+
+	// Check all the names before compiling anything, so it's all or nothing
+	for (auto const & d : m_decls)
+		if (nullptr != m_tm.getCompiledType (d.name))
+		{
+			Token at {Token::Kind::Ident, nullptr, 0, 0, d.line, d.column};
+			return fail (at, "type '" + d.name + "' is already compiled");
+		}
+
+	auto first_new = m_result.types.size();
+	m_result.types.reserve (first_new + m_decls.size());
+	for (auto const & d : m_decls)
+	{
+		auto ctype = m_tm.compile (d.type, d.name, options);
+		if (nullptr == ctype)
+		{
+			// Take back the ones that did compile, so nothing is left half loaded
+			for (auto i = first_new; i < m_result.types.size(); ++i)
+				m_tm.destroyCompiledType (m_result.types[i]);
+			m_result.types.resize (first_new);
+
+			Token at {Token::Kind::Ident, nullptr, 0, 0, d.line, d.column};
+			return fail (at, "couldn't compile type '" + d.name + "'");
+		}
+		m_result.types.push_back (ctype);
+	}
+
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+bool Parser::skipSpace ()
+{
+	while (m_cur < m_end)
+	{
+		char c = *m_cur;
+		if ('\n' == c)
+		{
+			++m_cur;
+			++m_line;
+			m_line_start = m_cur;
+		}
+		else if (' ' == c || '\t' == c || '\r' == c)
+			++m_cur;
+		else if ('/' == c && m_cur + 1 < m_end && '/' == m_cur[1])
+		{
+			while (m_cur < m_end && '\n' != *m_cur)
+				++m_cur;
+		}
+		else if ('/' == c && m_cur + 1 < m_end && '*' == m_cur[1])
+		{
+			Token at {Token::Kind::Punct, m_cur, 2, 0, m_line, unsigned(m_cur - m_line_start) + 1};
+			m_cur += 2;
+			while (m_cur + 1 < m_end && !('*' == m_cur[0] && '/' == m_cur[1]))
+			{
+				if ('\n' == *m_cur)
+				{
+					++m_line;
+					m_line_start = m_cur + 1;
+				}
+				++m_cur;
+			}
+			if (m_cur + 1 >= m_end)
+				return fail (at, "unterminated comment");
+			m_cur += 2;
+		}
+		else
+			break;
+	}
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+bool Parser::next ()
+{
+	if (!skipSpace ())
+		return false;
+
+	m_tok.begin = m_cur;
+	m_tok.len = 0;
+	m_tok.number = 0;
+	m_tok.line = m_line;
+	m_tok.column = unsigned(m_cur - m_line_start) + 1;
+
+	if (m_cur >= m_end)
+	{
+		m_tok.kind = Token::Kind::End;
+		return true;
+	}
+
+	char c = *m_cur;
+	if (('a' <= c && c <= 'z') || ('A' <= c && c <= 'Z') || '_' == c)
+	{
+		while (m_cur < m_end && (('a' <= *m_cur && *m_cur <= 'z') || ('A' <= *m_cur && *m_cur <= 'Z') || ('0' <= *m_cur && *m_cur <= '9') || '_' == *m_cur))
+			++m_cur;
+		m_tok.kind = Token::Kind::Ident;
+	}
+	else if ('0' <= c && c <= '9')
+	{
+		unsigned base = 10;
+		if ('0' == c && m_cur + 1 < m_end && ('x' == m_cur[1] || 'X' == m_cur[1]))
+		{
+			base = 16;
+			m_cur += 2;
+		}
+
+		uint64_t value = 0;
+		bool any = false;
+		for (; m_cur < m_end; ++m_cur, any = true)
+		{
+			char d = *m_cur;
+			unsigned digit;
+			if ('0' <= d && d <= '9')
+				digit = unsigned(d - '0');
+			else if (16 == base && 'a' <= (d | 0x20) && (d | 0x20) <= 'f')
+				digit = unsigned((d | 0x20) - 'a' + 10);
+			else
+				break;
+
+			value = value * base + digit;
+			if (value > std::numeric_limits<uint32_t>::max())
+				return fail (m_tok, "number too large");
+		}
+		if (!any)
+			return fail (m_tok, "malformed number");
+
+		m_tok.kind = Token::Kind::Number;
+		m_tok.number = value;
+	}
+	else if (nullptr != std::strchr ("{}:;,=[]", c) && '\0' != c)
+	{
+		++m_cur;
+		m_tok.kind = Token::Kind::Punct;
+	}
+	else
+		return fail (m_tok, std::string ("unexpected character '") + c + "'");
+
+	m_tok.len = size_t(m_cur - m_tok.begin);
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+bool Parser::fail (Token const & at, std::string message)
+{
+	if (m_result.error.empty())
+	{
+		m_result.error = std::move(message);
+		m_result.error_line = at.line;
+		m_result.error_column = at.column;
+	}
+	return false;
+}
+
+//----------------------------------------------------------------------
+
+bool Parser::expectPunct (char c)
+{
+	if (!isPunct (c))
+		return fail (m_tok, std::string ("expected '") + c + "'");
+	return next ();
+}
+
+//----------------------------------------------------------------------
+
+bool Parser::expectIdent (Token & out)
+{
+	if (Token::Kind::Ident != m_tok.kind)
+		return fail (m_tok, "expected a name");
+	out = m_tok;
+	return next ();
+}
+
+//----------------------------------------------------------------------
+
+bool Parser::expectNumber (uint32_t & out)
+{
+	if (Token::Kind::Number != m_tok.kind)
+		return fail (m_tok, "expected a number");
+	out = uint32_t(m_tok.number);
+	return next ();
+}
+
+//----------------------------------------------------------------------
+
+// '{' (name ':' type ';')* '}'
+DyStructType * Parser::parseStructBody ()
+{
+	if (!expectPunct ('{'))
+		return nullptr;
+
+	auto ret = m_tm.createType<Family::DyStruct> ();
+	while (!isPunct ('}'))
+	{
+		Token name;
+		if (!expectIdent (name) || !expectPunct (':'))
+			return nullptr;
+
+		auto type = parseFieldType ();
+		if (nullptr == type)
+			return nullptr;
+
+		if (!ret->addField ({type, tokenText (name)}))
+		{
+			fail (name, "duplicate field '" + tokenText (name) + "'");
+			return nullptr;
+		}
+
+		if (isPunct (';'))
+		{
+			if (!next ())
+				return nullptr;
+		}
+		else if (!isPunct ('}'))
+		{
+			fail (m_tok, "expected ';'");
+			return nullptr;
+		}
+	}
+
+	if (!next ())
+		return nullptr;
+	return ret;
+}
+
+//----------------------------------------------------------------------
+
+// '{' name ['=' number] (',' name ['=' number])* [','] '}'
+EnumType * Parser::parseEnumBody ()
+{
+	if (!expectPunct ('{'))
+		return nullptr;
+
+	auto ret = m_tm.createType<Family::Enum> (Basic::U32);
+	while (!isPunct ('}'))
+	{
+		Token name;
+		if (!expectIdent (name))
+			return nullptr;
+
+		bool ok;
+		if (isPunct ('='))
+		{
+			uint32_t value;
+			if (!next () || !expectNumber (value))
+				return nullptr;
+			ok = ret->addEntry (tokenText (name), value);
+		}
+		else
+			ok = ret->addEntry (tokenText (name));
+
+		if (!ok)
+		{
+			fail (name, "duplicate name or value for '" + tokenText (name) + "'");
+			return nullptr;
+		}
+
+		if (isPunct (','))
+		{
+			if (!next ())
+				return nullptr;
+		}
+		else if (!isPunct ('}'))
+		{
+			fail (m_tok, "expected ',' or '}'");
+			return nullptr;
+		}
+	}
+
+	if (!next ())
+		return nullptr;
+	return ret;
+}
+
+//----------------------------------------------------------------------
+
+// ('struct' body | 'enum' body | name) ('[' number ']')*
+Type * Parser::parseFieldType ()
+{
+	Type * type = nullptr;
+	Token at = m_tok;
+
+	if (isWord ("struct"))
+		type = next () ? parseStructBody () : nullptr;
+	else if (isWord ("enum"))
+		type = next () ? parseEnumBody () : nullptr;
+	else
+	{
+		Token name;
+		if (!expectIdent (name))
+			return nullptr;
+		type = lookup (name.begin, name.len);
+		if (nullptr == type)
+		{
+			fail (name, "unknown type '" + tokenText (name) + "'");
+			return nullptr;
+		}
+	}
+
+	if (nullptr == type)
+		return nullptr;
+
+	// C order: the first dimension is the outermost one
+	uint32_t dims [16];
+	unsigned dim_count = 0;
+	while (isPunct ('['))
+	{
+		at = m_tok;
+		if (!next () || !expectNumber (dims[dim_count]))
+			return nullptr;
+		if (0 == dims[dim_count])
+		{
+			fail (at, "arrays can't be empty");
+			return nullptr;
+		}
+		if (++dim_count > sizeof(dims) / sizeof(dims[0]) - 1)
+		{
+			fail (at, "too many array dimensions");
+			return nullptr;
+		}
+		if (!expectPunct (']'))
+			return nullptr;
+	}
+
+	while (dim_count > 0)
+		type = m_tm.createType<Family::Array> (dims[--dim_count], type);
+
+	return type;
+}
+
+//----------------------------------------------------------------------
+
+Type * Parser::lookup (char const * name, size_t len)
+{
+	for (int i = 0; i < int(Basic::_count); ++i)
+	{
+		auto basic_name = details::gc_BasicTraits[i].name;
+		if (std::strlen(basic_name) == len && 0 == std::memcmp (basic_name, name, len))
+		{
+			if (nullptr == m_basics[i])
+				m_basics[i] = m_tm.createType<Family::Basic> (Basic(i));
+			return m_basics[i];
+		}
+	}
+
+	auto decl = findDecl (name, len, FieldIndex::Hash (name, len));
+	if (decl)
+		return decl->type;
+
+	// Fields never change the types they refer to, so handing out an
+	// already compiled type here is fine.
+	return const_cast<Type *>(m_tm.getType (std::string (name, len)));
+}
+
+//----------------------------------------------------------------------
+
+Parser::Decl const * Parser::findDecl (char const * name, size_t len, FieldIndex::HashType hash) const
+{
+	size_t mask = m_table.size() - 1;
+	for (size_t i = hash & mask; 0 != m_table[i]; i = (i + 1) & mask)
+	{
+		auto const & d = m_decls[m_table[i] - 1];
+		if (d.hash == hash && d.name.size() == len && 0 == std::memcmp (d.name.data(), name, len))
+			return &d;
+	}
+	return nullptr;
+}
+
+//----------------------------------------------------------------------
+
+bool Parser::declare (Token const & name, Type * type)
+{
+	auto hash = FieldIndex::Hash (name.begin, name.len);
+	if (findDecl (name.begin, name.len, hash))
+		return fail (name, "duplicate type name '" + tokenText (name) + "'");
+	for (auto const & bt : details::gc_BasicTraits)
+		if (std::strlen(bt.name) == name.len && 0 == std::memcmp (bt.name, name.begin, name.len))
+			return fail (name, "'" + tokenText (name) + "' is a Basic type");
+
+	m_decls.push_back ({tokenText (name), hash, type, name.line, name.column});
+
+	// Keep the table at most half full
+	if (m_decls.size() * 2 > m_table.size())
+	{
+		m_table.assign (m_table.size() * 2, 0);
+		for (size_t i = 0; i < m_decls.size(); ++i)
+		{
+			size_t mask = m_table.size() - 1;
+			size_t j = m_decls[i].hash & mask;
+			while (0 != m_table[j])
+				j = (j + 1) & mask;
+			m_table[j] = uint32_t(i + 1);
+		}
+	}
+	else
+	{
+		size_t mask = m_table.size() - 1;
+		size_t j = hash & mask;
+		while (0 != m_table[j])
+			j = (j + 1) & mask;
+		m_table[j] = uint32_t(m_decls.size());
+	}
+
+	return true;
+}
+
+//======================================================================
+
+	}	// namespace
+
+//======================================================================
+//======================================================================
+
+bool LoadSchema (TypeManager & tm, char const * text, size_t length, SchemaResult & result, CompileOptions const & options)
+{
+	result.types.clear ();
+	result.error.clear ();
+	result.error_line = result.error_column = 0;
+
+	Parser parser (tm, text, length, result);
+	return parser.run (options);
+}
+
+//----------------------------------------------------------------------
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================
@@ -0,0 +1,257 @@
+//======================================================================
+
+#include <dystruct/String.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <new>
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+	namespace {
+
+//======================================================================
+
+uint64_t HashString (char const * str, size_t length)
+{
+	Hasher h;
+	h.update (str, length);
+	return h.finalize64AndReset ();
+}
+
+//======================================================================
+
+	}	// namespace
+
+//======================================================================
+//======================================================================
+
+StringPool::StringPool ()
+	: m_lock {}
+	, m_chunks {}
+	, m_bump {nullptr}
+	, m_bump_end {nullptr}
+	, m_bytes {0}
+	, m_count {0}
+	, m_hashes {}
+	, m_table {}
+{
+	for (auto & b : m_blocks)
+		b.store (nullptr, std::memory_order_relaxed);
+
+	// Id 0 is the empty string
+	auto first = new StringRef [gc_BlockSize];
+	m_blocks[0].store (first, std::memory_order_release);
+	m_hashes.push_back (HashString ("", 0));
+	m_count.store (1, std::memory_order_release);
+}
+
+//----------------------------------------------------------------------
+
+StringPool::~StringPool ()
+{
+	for (auto & b : m_blocks)
+		delete [] b.load (std::memory_order_relaxed);
+	for (auto c : m_chunks)
+		std::free (c);
+}
+
+//----------------------------------------------------------------------
+
+char const * StringPool::store (char const * str, size_t length)
+{
+	std::lock_guard<std::mutex> guard {m_lock};
+
+	auto ret = allocate (length);
+	if (ret && length > 0)
+		std::memcpy (ret, str, length);
+	return ret;
+}
+
+//----------------------------------------------------------------------
+
+uint32_t StringPool::intern (char const * str, size_t length)
+{
+	if (0 == length)
+		return 0;
+
+	auto hash = HashString (str, length);
+
+	std::lock_guard<std::mutex> guard {m_lock};
+
+	auto count = m_count.load (std::memory_order_relaxed);
+	if (2 * (count + 1) > m_table.size() && !growTable ())
+		return 0;
+
+	auto mask = m_table.size() - 1;
+	auto i = size_t(hash) & mask;
+	for (; 0 != m_table[i]; i = (i + 1) & mask)
+	{
+		auto id = m_table[i];
+		if (m_hashes[id] == hash && lookup (id) == StringRef {str, length})
+			return id;
+	}
+
+	// A new one
+	if (count >= gc_BlockSize * gc_MaxBlocks)
+		return 0;
+
+	auto block = count >> gc_BlockBits;
+	if (nullptr == m_blocks[block].load (std::memory_order_relaxed))
+		m_blocks[block].store (new StringRef [gc_BlockSize], std::memory_order_release);
+
+	auto chars = allocate (length);
+	if (nullptr == chars)
+		return 0;
+	std::memcpy (chars, str, length);
+
+	m_blocks[block].load (std::memory_order_relaxed)[count & (gc_BlockSize - 1)] = StringRef {chars, length};
+	m_hashes.push_back (hash);
+	m_table[i] = count;
+	m_count.store (count + 1, std::memory_order_release);
+	return count;
+}
+
+//----------------------------------------------------------------------
+
+size_t StringPool::bytesStored () const
+{
+	std::lock_guard<std::mutex> guard {m_lock};
+	return m_bytes;
+}
+
+//----------------------------------------------------------------------
+
+char * StringPool::allocate (size_t length)
+{
+	if (length > size_t(m_bump_end - m_bump))
+	{
+		// Big strings get a chunk of their own, so the current one isn't wasted
+		bool own = length > gc_ChunkSize / 4;
+		auto chunk = static_cast<char *>(std::malloc (own ? std::max<size_t> (length, 1) : gc_ChunkSize));
+		if (nullptr == chunk)
+			return nullptr;
+		m_chunks.push_back (chunk);
+
+		if (own)
+		{
+			m_bytes += length;
+			return chunk;
+		}
+		m_bump = chunk;
+		m_bump_end = chunk + gc_ChunkSize;
+	}
+
+	auto ret = m_bump;
+	m_bump += length;
+	m_bytes += length;
+	return ret;
+}
+
+//----------------------------------------------------------------------
+
+bool StringPool::growTable ()
+{
+	std::vector<uint32_t> table;
+	try {
+		table.resize (std::max<size_t> (64, 2 * m_table.size()), 0);
+	} catch (std::bad_alloc const &) {
+		return false;
+	}
+
+	auto mask = table.size() - 1;
+	for (auto id : m_table)
+		if (0 != id)
+		{
+			auto i = size_t(m_hashes[id]) & mask;
+			while (0 != table[i])
+				i = (i + 1) & mask;
+			table[i] = id;
+		}
+
+	m_table.swap (table);
+	return true;
+}
+
+//======================================================================
+//======================================================================
+
+StringType::StringType (StringPool & pool, SizeType inline_capacity, bool interned)
+	: Type {Family::String}
+	, m_pool {&pool}
+	, m_inline_capacity {interned ? 0 : inline_capacity}
+	, m_slot_size {interned ? SizeType(sizeof(uint32_t))
+		: details::AlignUp (std::max<SizeType> (inline_capacity + 1, SizeType(sizeof(char const *) + sizeof(uint32_t) + 1)), SizeType(alignof(char const *)))}
+	, m_interned {interned}
+{
+	assert (inline_capacity <= MaxInlineCapacity);
+}
+
+//----------------------------------------------------------------------
+
+StringRef StringType::read (Byte const * slot) const
+{
+	if (!m_interned)
+		return ReadSlot (slot, m_slot_size);
+
+	uint32_t id;
+	std::memcpy (&id, slot, sizeof(id));
+	return m_pool->lookup (id);
+}
+
+//----------------------------------------------------------------------
+
+bool StringType::write (Byte * slot, char const * str, size_t length) const
+{
+	if (m_interned)
+	{
+		auto id = m_pool->intern (str, length);
+		if (0 == id && 0 != length)
+			return false;
+		std::memcpy (slot, &id, sizeof(id));
+		return true;
+	}
+
+	if (length <= m_inline_capacity)
+	{
+		if (length > 0)
+			std::memmove (slot, str, length);
+		slot[m_slot_size - 1] = Byte(length);
+		return true;
+	}
+
+	if (length > std::numeric_limits<uint32_t>::max())
+		return false;
+	auto chars = m_pool->store (str, length);
+	if (nullptr == chars)
+		return false;
+
+	auto length32 = uint32_t(length);
+	std::memcpy (slot, &chars, sizeof(chars));
+	std::memcpy (slot + sizeof(chars), &length32, sizeof(length32));
+	slot[m_slot_size - 1] = LongTag;
+	return true;
+}
+
+//======================================================================
+
+StringAccessor CompiledType::accessorString (std::string const & path) const
+{
+	auto rp = resolvePath (path);
+	if (!rp.type || 0 != rp.stride || !rp.type->isString())
+		return StringAccessor {InvalidOffset, nullptr};
+
+	return StringAccessor {rp.offset, rp.type->asString()};
+}
+
+//----------------------------------------------------------------------
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================
@@ -0,0 +1,95 @@
+//======================================================================
+
+#include <dystruct/Vector.h>
+
+#include <algorithm>
+#include <limits>
+
+//======================================================================
+
+namespace DyStruct {
+
+//======================================================================
+
+VectorType::VectorType (Type * element_type)
+	: Type {Family::Vector}
+	, m_element_type {element_type}
+	, m_elem_layout {}
+	, m_elem_bytewise {false}
+{
+	assert (m_element_type);
+	refreshLayout ();
+}
+
+//----------------------------------------------------------------------
+
+bool VectorType::refreshLayout ()
+{
+	auto layout = details::FlattenLayout (m_element_type);
+	auto bytewise = details::IsBytewise (layout, m_element_type->getSizeOf());
+
+	// Only write if something changed; other threads may be reading these
+	if (layout != m_elem_layout)
+		m_elem_layout = std::move(layout);
+	if (bytewise != m_elem_bytewise)
+		m_elem_bytewise = bytewise;
+
+	return m_element_type->isTriviallyCopyable() && m_element_type->isTriviallyDestructible();
+}
+
+//----------------------------------------------------------------------
+
+bool VectorType::reserve (Byte * slot, size_t capacity, Arena & arena) const
+{
+	auto h = HeaderOf (slot);
+	if (capacity <= h->capacity)
+		return true;
+	if (capacity > std::numeric_limits<uint32_t>::max())
+		return false;
+
+	size_t elem_size = m_element_type->getSizeOf();
+	if (0 != elem_size && capacity > std::numeric_limits<size_t>::max() / elem_size)
+		return false;
+
+	auto data = static_cast<Byte *>(arena.allocate (capacity * elem_size, m_element_type->getAlignment()));
+	if (nullptr == data)
+		return false;
+
+	// The old block stays with the arena
+	if (h->size > 0)
+		std::memcpy (data, h->data, h->size * elem_size);
+	h->data = data;
+	h->capacity = uint32_t(capacity);
+	return true;
+}
+
+//----------------------------------------------------------------------
+
+bool VectorType::resize (Byte * slot, size_t count, Arena & arena) const
+{
+	auto h = HeaderOf (slot);
+	if (count <= h->size)
+	{
+		h->size = uint32_t(count);		// Elements are trivially destructible
+		return true;
+	}
+
+	if (count > h->capacity && !reserve (slot, std::max<size_t> (count, 2 * size_t(h->capacity)), arena))
+		return false;
+
+	auto elem_size = m_element_type->getSizeOf();
+	std::memset (h->data + h->size * elem_size, 0, (count - h->size) * elem_size);
+	if (!m_element_type->isTriviallyConstructible())
+		for (auto i = h->size; i < count; ++i)
+			m_element_type->construct (h->data + i * elem_size, elem_size);
+
+	h->size = uint32_t(count);
+	return true;
+}
+
+//----------------------------------------------------------------------
+//======================================================================
+
+}	// namespace DyStruct
+
+//======================================================================